@@ -4,6 +4,7 @@
 * File   : CLI.c
 */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <unistd.h>
@@ -17,6 +18,7 @@
 #include "argtable3/argtable3.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "sdkconfig.h"
 #include "esp_vfs_dev.h"
 #include "linenoise/linenoise.h"
@@ -34,11 +36,35 @@
 #include "CLI.h"
 #include "CLIUart.h"
 #include "CLISocket.h"
+#include "CLISession.h"
+#include "CLIFrame.h"
+#include "CLICapture.h"
+#include "CLISched.h"
+#include "CLIUdp.h"
+#include "CLIJob.h"
+#include "CLIBoard.h"
+#include "CLIGpio.h"
+#include "CLIJson.h"
+#include "CLITop.h"
+#include "CLIConfig.h"
+#include "CLIBoot.h"
+#include "CLIAdc.h"
+#include "CLIBus.h"
+#include "CLIPwm.h"
+#include "CLIWave.h"
+#include "CLIRecord.h"
 
 // TAG for ESP32 log functions
 static const char *TAGESP32 = "ESP32";
 // TAG for ESP TCP log functions
 static const char *TAGTCP = "TCP Application";
+// Console commands keep their arguments in static tables, so command runs of all tasks are serialized
+static SemaphoreHandle_t s_command_lock;
+// Levels of the recursive command lock which its holder took, only the holder changes it
+static int s_command_depth = 0;
+// Prompt of serial console and whether linenoise edits a line, output of other tasks must go around it
+static const char *s_prompt = "";
+static volatile bool s_editing = false;
 
 // All register function must be declared before
 static void register_read_gpio(void);
@@ -47,6 +73,24 @@ static void register_write_gpio(void);
 static void register_restart(void);
 static void register_help(void);
 static void register_close_socket(void);
+static void register_session(void);
+static void register_baud(void);
+static void register_framed(void);
+static void register_capture(void);
+static void register_adc_stream(void);
+static void register_bus(void);
+static void register_pwm(void);
+static void register_waveform(void);
+static void register_every(void);
+static void register_udp(void);
+static void register_jobs(void);
+static void register_wait(void);
+static void register_kill(void);
+static void register_format(void);
+static void register_top(void);
+static void register_config(void);
+static void register_boot_profile(void);
+static void register_record(void);
 
 // Register function for all commands:
 void cliRegisterCommands(void){
@@ -54,9 +98,31 @@ void cliRegisterCommands(void){
     register_write_gpio();
     register_version();
     register_restart();
+    register_session();
+    register_format();
+    register_capture();
+    register_adc_stream();
+    register_bus();
+    register_pwm();
+    register_waveform();
+    register_every();
+    register_jobs();
+    register_wait();
+    register_kill();
+    register_top();
+    register_config();
+    register_boot_profile();
+    register_record();
 #if ENABLE_TCP
     register_help();
     register_close_socket();
+#if ENABLE_UDP
+    register_udp();
+#endif
+#endif
+#if ENABLE_UART
+    register_baud();
+    register_framed();
 #endif
 }
 
@@ -64,9 +130,57 @@ void cliRegisterCommands(void){
 static struct{
     struct arg_lit *pin_param;
     struct arg_int *pin_number;
+    struct arg_int *window;
     struct arg_end *end;
 }read_gpio_args;
 
+// JSON response of 'read_gpio' command, pins are streamed from the same snapshot as the table
+static int read_gpio_json(void){
+    uint64_t levels = cliGpioReadAll();
+    if(read_gpio_args.pin_number->count && !cliBoardReportPin(read_gpio_args.pin_number->ival[0], CLI_BOARD_USE_READ))
+        return 1;
+    cliJson_t json;
+    cliJsonBegin(&json, cliSessionGetCurrent());
+    if(read_gpio_args.pin_param->count){
+        uint64_t valid = cliBoardAllowed(CLI_BOARD_USE_READ);
+        cliJsonArray(&json, "pins");
+        for(uint8_t i = 0; i <= CLI_BOARD_MAX_PIN; i++){
+            if(!(valid & (1ULL << i)))
+                continue;
+            cliJsonObject(&json, NULL);
+            cliJsonInt(&json, "gpio", i);
+            cliJsonInt(&json, "level", (levels >> i) & 1);
+            if(cliGpioGetOwner(i) != CLI_GPIO_OWNER_NONE)
+                cliJsonString(&json, "owner", cliGpioOwnerName(cliGpioGetOwner(i)));
+            cliJsonClose(&json);
+        }
+        cliJsonClose(&json);
+    }
+    if(read_gpio_args.pin_number->count){
+        uint8_t pin = read_gpio_args.pin_number->ival[0];
+        cliJsonObject(&json, "pin");
+        cliJsonInt(&json, "gpio", pin);
+        cliJsonInt(&json, "level", (levels >> pin) & 1);
+        if(cliGpioGetOwner(pin) != CLI_GPIO_OWNER_NONE)
+            cliJsonString(&json, "owner", cliGpioOwnerName(cliGpioGetOwner(pin)));
+        cliJsonClose(&json);
+    }
+    if(read_gpio_args.window->count){
+        const cliGpioStats_t *stats = cliGpioGetStats();
+        cliJsonObject(&json, "snapshot");
+        cliJsonUint(&json, "window_us", cliGpioGetCacheWindow());
+        cliJsonUint(&json, "hits", stats->hits);
+        cliJsonUint(&json, "refreshes", stats->refreshes);
+        cliJsonUint(&json, "retries", stats->retries);
+        cliJsonUint(&json, "direct", stats->direct);
+        cliJsonUint(&json, "invalidations", stats->invalidations);
+        cliJsonClose(&json);
+    }
+    cliJsonEnd(&json);
+
+    return 0;
+}
+
 // Command function for 'read_gpio' command:
 static int read_gpio(int argc, char **argv){
     int err = arg_parse(argc, argv, (void **)&read_gpio_args);
@@ -74,415 +188,1822 @@ static int read_gpio(int argc, char **argv){
         //...
         return 1;
     }
-    // If uart is enable:
-    if(ENABLE_UART){
-        // For -a argument
-        if(read_gpio_args.pin_param->count){
-            printf("\n -------------------- \n");
-            printf("| GPIO_PIN  |  STATUS |");
-            printf("\n -------------------- \n");
-            for(uint8_t i = 0; i <= 39; i++){
-                  //These pins not available for ESP-WROOM-32 Board
-                if(i == 20 || i == 24 || i == 28 || i == 29 || i == 30 || i == 31 || i == 37 || i == 38)
-                    continue;
-                printf("| Pin-%d     |  %s", i, GPIO_PIN_HIGH == gpio_get_level(i) ? "HIGH   |" : "LOW    |");
-                printf("\n -------------------- \n");
+    // For -w argument
+    if(read_gpio_args.window->count){
+        if(read_gpio_args.window->ival[0] < 0){
+            cliSessionPrintf("Snapshot window can not be negative!\n");
+            return 1;
+        }
+        cliGpioSetCacheWindow(read_gpio_args.window->ival[0]);
+    }
+    if(cliJsonEnabled())
+        return read_gpio_json();
+    // For -a argument, polling clients share one snapshot and its formatted table
+    if(read_gpio_args.pin_param->count)
+        cliGpioPrintTable();
+    // For -p argument
+    if(read_gpio_args.pin_number->count){
+        int pin = read_gpio_args.pin_number->ival[0];
+        if(!cliBoardReportPin(pin, CLI_BOARD_USE_READ))
+            return 1;
+        const char *level = (cliGpioReadAll() & (1ULL << pin)) ? "HIGH" : "LOW";
+        // Pins of pwm, waveform and buses change by themselves, owner tells why
+        if(cliGpioGetOwner(pin) != CLI_GPIO_OWNER_NONE)
+            cliSessionPrintf("GPIO Pin-%d Status: %s (%s)\n", pin, level, cliGpioOwnerName(cliGpioGetOwner(pin)));
+        else
+            cliSessionPrintf("GPIO Pin-%d Status: %s\n", pin, level);
+    }
+    // Statistics for -w argument
+    if(read_gpio_args.window->count){
+        const cliGpioStats_t *stats = cliGpioGetStats();
+        cliSessionPrintf("Snapshot Window: %u us\nHits: %u\nRefreshes: %u\nRetries: %u\nDirect Reads: %u\n"
+                         "Invalidations: %u\n", cliGpioGetCacheWindow(), stats->hits, stats->refreshes,
+                         stats->retries, stats->direct, stats->invalidations);
+    }
+
+    return 0;
+}
+
+// Register function for 'read_gpio' command:
+static void register_read_gpio(void){
+    int num_args = 3;
+
+    read_gpio_args.pin_param = arg_lit0("a", "allpins", "All Pins Status");
+    read_gpio_args.pin_number = arg_int0("p", "pin", "<gpio>", "Pin number");
+    read_gpio_args.window = arg_int0("w", "window", "<us>", "Snapshot window, readers in it share one read");
+    read_gpio_args.end = arg_end(num_args);
+
+    const esp_console_cmd_t cmd = {
+        .command = "read_gpio",
+        .help = "Get GPIO Pin Status",
+        .hint = NULL,
+        .func = &read_gpio,
+        .argtable = &read_gpio_args
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+// Command function for 'version' command:
+static int get_version(int argc, char **argv){
+    esp_chip_info_t info;
+    esp_chip_info(&info);
+    if(cliJsonEnabled()){
+        cliJson_t json;
+        cliJsonBegin(&json, cliSessionGetCurrent());
+        cliJsonString(&json, "idf", esp_get_idf_version());
+        cliJsonString(&json, "model", info.model == CHIP_ESP32 ? "ESP32" : "Unknown");
+        cliJsonInt(&json, "cores", info.cores);
+        cliJsonArray(&json, "features");
+        if(info.features & CHIP_FEATURE_WIFI_BGN)
+            cliJsonString(&json, NULL, "802.11bgn");
+        if(info.features & CHIP_FEATURE_BLE)
+            cliJsonString(&json, NULL, "BLE");
+        if(info.features & CHIP_FEATURE_BT)
+            cliJsonString(&json, NULL, "BT");
+        cliJsonClose(&json);
+        cliJsonObject(&json, "flash");
+        cliJsonBool(&json, "embedded", info.features & CHIP_FEATURE_EMB_FLASH);
+        cliJsonUint(&json, "size_mb", spi_flash_get_chip_size() / (1024 * 1024));
+        cliJsonClose(&json);
+        cliJsonInt(&json, "revision", info.revision);
+        const cliBoardProfile_t *board = cliBoardGet();
+        cliJsonObject(&json, "board");
+        cliJsonString(&json, "name", board->name);
+        cliJsonUint(&json, "valid", board->valid);
+        cliJsonUint(&json, "input_only", board->inputOnly);
+        cliJsonUint(&json, "strapping", board->strapping);
+        cliJsonUint(&json, "flash", board->flash);
+        cliJsonUint(&json, "adc", board->adc);
+        cliJsonClose(&json);
+        cliJsonEnd(&json);
+        return 0;
+    }
+    cliSessionPrintf("IDF Version:%s\r\n", esp_get_idf_version());
+    cliSessionPrintf("Chip info:\r\n");
+    cliSessionPrintf("\tmodel:%s\r\n", info.model == CHIP_ESP32 ? "ESP32" : "Unknown");
+    cliSessionPrintf("\tcores:%d\r\n", info.cores);
+    cliSessionPrintf("\tfeature:%s%s%s%s%d%s\r\n",
+       info.features & CHIP_FEATURE_WIFI_BGN ? "/802.11bgn" : "",
+       info.features & CHIP_FEATURE_BLE ? "/BLE" : "",
+       info.features & CHIP_FEATURE_BT ? "/BT" : "",
+       info.features & CHIP_FEATURE_EMB_FLASH ? "/Embedded-Flash:" : "/External-Flash:",
+       spi_flash_get_chip_size() / (1024 * 1024), " MB");
+    cliSessionPrintf("\trevision number:%d\r\n", info.revision);
+    const cliBoardProfile_t *board = cliBoardGet();
+    cliSessionPrintf("Board: %s\r\n", board->name);
+    cliSessionPrintf("\tvalid:0x%010llx\r\n\tinput only:0x%010llx\r\n\tstrapping:0x%010llx\r\n"
+                     "\tflash:0x%010llx\r\n\tadc:0x%010llx\r\n",
+                     board->valid, board->inputOnly, board->strapping, board->flash, board->adc);
+
+    return 0;
+}
+
+// Register function for 'version' command:
+static void register_version(void){
+    const esp_console_cmd_t cmd = {
+        .command = "version",
+        .help = "Get version of chip and SDK",
+        .hint = NULL,
+        .func = &get_version,
+        .argtable = NULL,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+// Arguments table for 'write_gpio' command:
+static struct{
+    struct arg_int *pin_number;
+    struct arg_int *pin_state;
+    struct arg_end *end;
+}write_gpio_args;
+
+// Command function for 'write_gpio' command:
+static int write_gpio(int argc, char **argv){
+    int err = arg_parse(argc, argv, (void **)&write_gpio_args);
+    if(err != 0){
+        //...
+        return 1;
+    }
+    int pin_number = 0;
+    uint32_t pin_state = 0;
+    // For -p and -d arguments
+    if(write_gpio_args.pin_number->count && write_gpio_args.pin_state->count){
+        pin_number = write_gpio_args.pin_number->ival[0];
+        pin_state = write_gpio_args.pin_state->ival[0];
+    }
+    else{
+        cliSessionPrintf("-p (pin) and -d (data) argument must be entering at the same time!\n");
+        return 1;
+    }
+    if(pin_state > 1){
+        cliSessionPrintf("Pin data must be 1 or 0!\n");
+        return 1;
+    }
+    // Flash and input-only pins are rejected, strapping pins are written with a warning
+    if(!cliBoardReportPin(pin_number, CLI_BOARD_USE_WRITE))
+        return 1;
+    // Setting direction would take the pin away from a peripheral
+    if(!cliGpioReportOwner(pin_number, CLI_GPIO_OWNER_NONE))
+        return 1;
+    gpio_set_direction(pin_number, GPIO_MODE_INPUT_OUTPUT);
+    err = gpio_set_level(pin_number, pin_state);
+    // Next read must see the new level
+    cliGpioInvalidate();
+    if(cliJsonEnabled()){
+        if(err != ESP_OK)
+            return err;
+        cliJson_t json;
+        cliJsonBegin(&json, cliSessionGetCurrent());
+        cliJsonInt(&json, "gpio", pin_number);
+        cliJsonInt(&json, "level", pin_state);
+        cliJsonEnd(&json);
+    }
+    else if(err == ESP_OK)
+        cliSessionPrintf("Write operation successful! GPIO Pin: %d, Pin Data: %d\n", pin_number, pin_state);
+    else
+        cliSessionPrintf("Fail during Writing!\n");
+
+    return 0;
+}
+
+// Register function for 'write_gpio' command:
+static void register_write_gpio(void){
+    int num_args = 2;
+
+    write_gpio_args.pin_number = arg_int0("p", "pin", "<gpio>", "Pin number");
+    write_gpio_args.pin_state = arg_int0("d", "data", "<1|0>", "Write data");
+    write_gpio_args.end = arg_end(num_args);
+
+    const esp_console_cmd_t cmd = {
+        .command = "write_gpio",
+        .help = "Write Data Specified GPIO Pin",
+        .hint = NULL,
+        .func = &write_gpio,
+        .argtable = &write_gpio_args
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+// Command function for 'restart' command:
+static int restart(int argc, char **argv){
+    cliSessionPrintf("Restarting ESP32!\n");
+    // Restart does not return, so response must be sent here
+    cliSessionFlush(cliSessionGetCurrent(), CLI_SESSION_FLUSH_END);
+    esp_restart();
+
+    return 0;
+}
+
+// Register function for 'restart' command:
+static void register_restart(void){
+    const esp_console_cmd_t cmd = {
+        .command = "restart",
+        .help = "Software reset of the chip",
+        .hint = NULL,
+        .func = &restart,
+        .argtable = NULL,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+// Command function for 'help' command:
+static int help(int argc, char **argv){
+    // This help function just for tcp:
+    if(ENABLE_TCP){
+        cliSessionPrintf("\n-----------------------\n"
+                         "All Registered Commands"
+                         "\n-----------------------\n");
+        cliSessionPrintf("Command: help\nHints: List All Registered Commands\n"
+                         "Arguments:\n\tNo\n\n");
+        cliSessionPrintf("Command: read_gpio\nHints: Prints GPIO Status\n"
+                         "Arguments:\n\t-a : All Pins Status\n\t-p <gpio> : Specified Pin Status\n"
+                         "\t-w <us> : Snapshot Window Shared by Readers and Cache Statistics\n\n");
+        cliSessionPrintf("Command: write_gpio\nHints: Write Desired Data in Specified Pin\n"
+                         "Arguments:\n\t-p <gpio> -d <1|0> : Pin and Data Values\n\n");
+        cliSessionPrintf("Command: version\nHints: Print ESP32 Version\n"
+                         "Arguments:\n\tNo\n\n");
+        cliSessionPrintf("Command: restart\nHints: Restart ESP32\n"
+                         "Arguments:\n\tNo\n\n");
+        cliSessionPrintf("Command: close_socket\nHints: Close Socket Connection\n"
+                         "Arguments:\n\tNo\n\n");
+        cliSessionPrintf("Command: session\nHints: Print or Change Session Flush Policy and Statistics\n"
+                         "Arguments:\n\t-p <default|latency|throughput> : Flush Policy\n"
+                         "\t-t <ms> : Flush Timer for Throughput Policy\n\t-s : Statistics\n\n");
+        cliSessionPrintf("Command: capture\nHints: Sample GPIO Pins and Stream Binary Run Length Encoded Data\n"
+                         "Arguments:\n\t-m <mask> : Pin Mask\n\t-r <us> : Sample Period\n\t-n <count> : Sample Count\n"
+                         "\t-t <gpio> -e <rising|falling> : Trigger Pin and Edge\n\n");
+        cliSessionPrintf("Command: adc_stream\nHints: Sample ADC Pins Continuously and Stream Binary Reduced Blocks\n"
+                         "Arguments:\n\t-m <mask> : Pin Mask\n\t-r <hz> : Sample Rate of Every Pin\n\t-n <count> : Record Count\n"
+                         "\t-d <count> : Conversions Reduced into One Record\n\t-f <mean,min,max> : Reduced Values\n"
+                         "\t-s <hw|synth> : Source\n\tAny input stops the stream\n\n");
+        cliSessionPrintf("Command: i2c / spi\nHints: Run a Transaction List on I2C or SPI Bus and Print All Read Bytes\n"
+                         "Arguments:\n\topen <sda> <scl> [hz] : Open I2C Bus\n"
+                         "\topen <mosi> <miso> <sclk> <cs> [hz] [mode] : Open SPI Bus\n\topen mock : Open Mock Bus\n"
+                         "\tclose : Close Bus\n\t[-b] <list> : Run List, -b Prints Binary Response\n"
+                         "\tList Items: a<addr> w<hex>[*n] r<n> b<reg>:<n> x<hex>[*n] d<us>, e.g. a68,b75:1\n\n");
+        cliSessionPrintf("Command: pwm\nHints: Generate PWM with LEDC, Updates Take Effect at End of Period\n"
+                         "Arguments:\n\tNo : List Outputs\n\tstart <gpio> <hz> <duty%%> : Start Output\n"
+                         "\tupdate <gpio> <hz> <duty%%> : Change Running Output\n\tstop <gpio> [0|1] : Stop and Hold Level\n\n");
+        cliSessionPrintf("Command: waveform\nHints: Play a Pulse Sequence with RMT, Updates Take Effect at End of Sequence\n"
+                         "Arguments:\n\tNo : List Outputs\n\tstart <gpio> <list> [repeat] : Start, Repeat 0 Loops Until Stop\n"
+                         "\tupdate <gpio> <list> : Replace Sequence\n\tstop <gpio> : Stop at End of Sequence\n"
+                         "\tList: First Level and Phase Lengths in us, e.g. 1:10,20,2.5,2.5\n\n");
+        cliSessionPrintf("Command: every\nHints: Run a Command Periodically and Push Changed Results\n"
+                         "Arguments:\n\t<ms> <command> : Add Job\n\t-l : List Jobs\n\t-c <id> : Cancel Job\n"
+                         "\t-u <percent> : Scheduler CPU Cap\n\n");
+        cliSessionPrintf("Command: jobs\nHints: List Background Jobs, a Command Ending with '&' or '&<ms>' Runs as a Job\n"
+                         "Arguments:\n\tNo\n\n");
+        cliSessionPrintf("Command: wait\nHints: Wait for a Job and Print its Output\n"
+                         "Arguments:\n\t<id> [ms] : Job and Longest Wait Time\n\n");
+        cliSessionPrintf("Command: kill\nHints: Cancel a Running Job or Discard a Finished One\n"
+                         "Arguments:\n\t<id> : Job\n\n");
+        cliSessionPrintf("Command: format\nHints: Print or Change Output Format of Session\n"
+                         "Arguments:\n\t<json|text> : JSON Responses or Text\n\n");
+        cliSessionPrintf("Command: udp\nHints: Print UDP Datagram Transport Statistics\n"
+                         "Arguments:\n\tNo\n\n");
+        cliSessionPrintf("Command: record\nHints: Record Lines, Responses and Execution Times for tools/cli_replay.py\n"
+                         "Arguments:\n\tNo : Recorder Status\n\tstart [kb] : Start with a New Log\n\tstop : Stop Recording\n"
+                         "\tclear : Free Log\n\tdump : Download Binary Log\n\n");
+    }
+    else{
+        return 1;
+    }
+
+    return 0;
+}
+
+// Register function for 'help' command:
+static void register_help(void){
+    const esp_console_cmd_t cmd = {
+        .command = "help",
+        .help = "List All Registered Commands",
+        .hint = NULL,
+        .func = &help,
+        .argtable = NULL,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+// Command function for 'close_socket' command
+static int close_socket(int argc, char **argv){
+    // This command just for tcp
+    if(ENABLE_TCP){
+        // Shutdown socket of current client, server drops closed sessions
+        cliSession_t *current = cliSessionGetCurrent();
+        if(current == NULL || current->transport != CLI_SESSION_TCP)
+            return 1;
+        int fd = current->fd;
+        cliSessionClose(current);
+        shutdown(fd, 0);
+        close(fd);
+    }
+    else{
+        return 1;
+    }
+
+    return 0;
+}
+
+// Register function for 'close_socket' command
+static void register_close_socket(void){
+    const esp_console_cmd_t cmd = {
+        .command = "close_socket",
+        .help = "Close Socket Connection",
+        .hint = NULL,
+        .func = &close_socket,
+        .argtable = NULL,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+// Arguments table for 'session' command:
+static struct{
+    struct arg_str *policy;
+    struct arg_int *flush_timer;
+    struct arg_lit *stats;
+    struct arg_lit *list;
+    struct arg_int *rate;
+    struct arg_int *bytes;
+    struct arg_int *id;
+    struct arg_end *end;
+}session_args;
+
+// Prints one line of 'session -l' table
+static void session_list_line(cliSession_t *session){
+    cliSessionPrintf("%-4u %-7s %-16s %-11s %-5s %-9u %-8u %u/%u\n", session->id,
+                     cliSessionTransportName(session->transport), session->peer[0] ? session->peer : "-",
+                     cliSessionPolicyName(session->policy), cliSessionFormatName(session->format),
+                     session->stats.commands, session->stats.limited,
+                     session->rate.commandsPerSec, session->rate.bytesPerSec);
+}
+
+// Lists all open sessions
+static void session_list(void){
+    if(cliJsonEnabled()){
+        cliJson_t json;
+        cliJsonBegin(&json, cliSessionGetCurrent());
+        cliJsonArray(&json, "sessions");
+        for(int i = 0; i < CLI_SESSION_MAX; i++){
+            cliSession_t *session = cliSessionAt(i);
+            if(!session->used)
+                continue;
+            cliJsonObject(&json, NULL);
+            cliJsonUint(&json, "id", session->id);
+            cliJsonString(&json, "transport", cliSessionTransportName(session->transport));
+            cliJsonString(&json, "peer", session->peer);
+            cliJsonString(&json, "policy", cliSessionPolicyName(session->policy));
+            cliJsonString(&json, "format", cliSessionFormatName(session->format));
+            cliJsonUint(&json, "commands", session->stats.commands);
+            cliJsonUint(&json, "limited", session->stats.limited);
+            cliJsonUint(&json, "out_bytes", session->stats.outBytes);
+            cliJsonUint(&json, "rate_commands", session->rate.commandsPerSec);
+            cliJsonUint(&json, "rate_bytes", session->rate.bytesPerSec);
+            cliJsonClose(&json);
+        }
+        cliJsonEnd(&json);
+        return;
+    }
+    cliSessionPrintf("ID   Type    Peer             Policy      Fmt   Commands  Limited  Rate (cmd/s / B/s)\n");
+    for(int i = 0; i < CLI_SESSION_MAX; i++){
+        if(cliSessionAt(i)->used)
+            session_list_line(cliSessionAt(i));
+    }
+}
+
+// Returns true if a rate limit is not raised, 0 is unlimited
+static bool session_rate_tightens(uint32_t limit, uint32_t current){
+    if(current == 0)
+        return true;
+    return limit != 0 && limit <= current;
+}
+
+// Command function for 'session' command:
+static int session(int argc, char **argv){
+    int err = arg_parse(argc, argv, (void **)&session_args);
+    if(err != 0){
+        //...
+        return 1;
+    }
+    cliSession_t *current = cliSessionGetCurrent();
+    // For -l argument
+    if(session_args.list->count){
+        session_list();
+        return 0;
+    }
+    // Serial console is the operator, network clients can only lower their own limits. Defaults are
+    // raised by 'config'
+    bool operator = current->transport == CLI_SESSION_UART || current->transport == CLI_SESSION_FRAME;
+    // For -i argument, rate of another session can be changed by the operator
+    cliSession_t *target = current;
+    if(session_args.id->count){
+        target = NULL;
+        for(int i = 0; i < CLI_SESSION_MAX; i++){
+            if(cliSessionAt(i)->used && cliSessionAt(i)->id == (uint32_t)session_args.id->ival[0])
+                target = cliSessionAt(i);
+        }
+        if(target == NULL){
+            cliSessionPrintf("There is no session with this id ( %d )!\n", session_args.id->ival[0]);
+            return 1;
+        }
+    }
+    // For -r and -b arguments, 0 is unlimited
+    if(session_args.rate->count || session_args.bytes->count){
+        int commands = session_args.rate->count ? session_args.rate->ival[0] : (int)target->rate.commandsPerSec;
+        int bytes = session_args.bytes->count ? session_args.bytes->ival[0] : (int)target->rate.bytesPerSec;
+        if(commands < 0 || bytes < 0){
+            cliSessionPrintf("Rate can not be negative!\n");
+            return 1;
+        }
+        if(!operator && (target != current || !session_rate_tightens(commands, target->rate.commandsPerSec) ||
+                         !session_rate_tightens(bytes, target->rate.bytesPerSec))){
+            cliSessionPrintf("Only serial console can raise rate limits or change other sessions!\n");
+            return 1;
+        }
+        cliSessionSetRate(target, commands, bytes);
+    }
+    if(target != current){
+        cliSessionPrintf("Session %u Rate: %u cmd/s, %u B/s\n", target->id, target->rate.commandsPerSec, target->rate.bytesPerSec);
+        return 0;
+    }
+    // For -p argument
+    if(session_args.policy->count){
+        const char *name = session_args.policy->sval[0];
+        cliSessionPolicy_t policy;
+        if(strcmp(name, "default") == 0)
+            policy = CLI_SESSION_POLICY_DEFAULT;
+        else if(strcmp(name, "latency") == 0)
+            policy = CLI_SESSION_POLICY_LOW_LATENCY;
+        else if(strcmp(name, "throughput") == 0)
+            policy = CLI_SESSION_POLICY_THROUGHPUT;
+        else{
+            cliSessionPrintf("Unknown policy ( %s )! Use default, latency or throughput\n", name);
+            return 1;
+        }
+        if(cliSessionSetPolicy(current, policy) != 0){
+            cliSessionPrintf("Fail during Setting Policy!\n");
+            return 1;
+        }
+    }
+    // For -t argument
+    if(session_args.flush_timer->count){
+        int timer = session_args.flush_timer->ival[0];
+        if(timer < 1 || timer > 1000){
+            cliSessionPrintf("Flush timer must be between 1 and 1000 ms!\n");
+            return 1;
+        }
+        current->flushTimerMs = timer;
+    }
+    if(cliJsonEnabled()){
+        cliSessionStats_t *stats = &current->stats;
+        cliJson_t json;
+        cliJsonBegin(&json, current);
+        cliJsonUint(&json, "id", current->id);
+        cliJsonString(&json, "policy", cliSessionPolicyName(current->policy));
+        cliJsonUint(&json, "flush_timer_ms", current->flushTimerMs);
+        cliJsonString(&json, "format", cliSessionFormatName(current->format));
+        cliJsonUint(&json, "rate_commands", current->rate.commandsPerSec);
+        cliJsonUint(&json, "rate_bytes", current->rate.bytesPerSec);
+        if(session_args.stats->count){
+            cliJsonObject(&json, "stats");
+            cliJsonUint(&json, "commands", stats->commands);
+            cliJsonUint(&json, "rx_bytes", stats->rxBytes);
+            cliJsonUint(&json, "tx_bytes", stats->txBytes);
+            cliJsonUint(&json, "tx_calls", stats->txCalls);
+            cliJsonUint(&json, "tx_errors", stats->txErrors);
+            cliJsonUint(&json, "out_bytes", stats->outBytes);
+            cliJsonUint(&json, "limited", stats->limited);
+            cliJsonUint(&json, "events_dropped", stats->eventsDropped);
+            cliJsonArray(&json, "flushes");
+            for(int i = 0; i < CLI_SESSION_FLUSH_REASON_COUNT; i++)
+                cliJsonUint(&json, NULL, stats->flushes[i]);
+            cliJsonClose(&json);
+            cliJsonClose(&json);
+        }
+        cliJsonEnd(&json);
+        return 0;
+    }
+    cliSessionPrintf("Session Policy: %s, Flush Timer: %u ms\n", cliSessionPolicyName(current->policy), current->flushTimerMs);
+    cliSessionPrintf("Session Rate: %u cmd/s, %u B/s\n", current->rate.commandsPerSec, current->rate.bytesPerSec);
+    // For -s argument
+    if(session_args.stats->count){
+        cliSessionStats_t *stats = &current->stats;
+        cliSessionPrintf("Commands: %u\nRX Bytes: %u\nTX Bytes: %u\nTX Calls: %u\nTX Errors: %u\n"
+                         "Out Bytes: %u\nRate Limited: %u\nEvents Dropped: %u\nFlushes (end/full/timer): %u/%u/%u\n",
+                         stats->commands, stats->rxBytes, stats->txBytes, stats->txCalls, stats->txErrors,
+                         stats->outBytes, stats->limited, stats->eventsDropped,
+                         stats->flushes[CLI_SESSION_FLUSH_END], stats->flushes[CLI_SESSION_FLUSH_FULL],
+                         stats->flushes[CLI_SESSION_FLUSH_TIMER]);
+    }
+
+    return 0;
+}
+
+// Register function for 'session' command:
+static void register_session(void){
+    int num_args = 7;
+
+    session_args.policy = arg_str0("p", "policy", "<default|latency|throughput>", "Flush policy");
+    session_args.flush_timer = arg_int0("t", "timer", "<ms>", "Flush timer for throughput policy");
+    session_args.stats = arg_lit0("s", "stats", "Session statistics");
+    session_args.list = arg_lit0("l", "list", "List all sessions");
+    session_args.rate = arg_int0("r", "rate", "<cmd/s>", "Command rate limit, 0 is unlimited. Network sessions can only lower it");
+    session_args.bytes = arg_int0("b", "bytes", "<B/s>", "Output rate limit, 0 is unlimited");
+    session_args.id = arg_int0("i", "id", "<id>", "Session whose rate is changed");
+    session_args.end = arg_end(num_args);
+
+    const esp_console_cmd_t cmd = {
+        .command = "session",
+        .help = "Print or Change Session Flush Policy, Rate Limits and Statistics",
+        .hint = NULL,
+        .func = &session,
+        .argtable = &session_args
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+// Command function for 'format' command:
+static int format(int argc, char **argv){
+    cliSession_t *current = cliSessionGetCurrent();
+    if(argc > 2 || current == NULL){
+        cliSessionPrintf("Usage: format [json|text]\n");
+        return 1;
+    }
+    if(argc == 2){
+        if(strcmp(argv[1], "json") == 0){
+            // Response of this command is already a JSON one
+            if(current->format != CLI_SESSION_FORMAT_JSON)
+                current->jsonState = CLI_SESSION_JSON_PENDING;
+            current->format = CLI_SESSION_FORMAT_JSON;
+        }
+        else if(strcmp(argv[1], "text") == 0){
+            current->format = CLI_SESSION_FORMAT_TEXT;
+            current->jsonState = CLI_SESSION_JSON_IDLE;
+        }
+        else{
+            cliSessionPrintf("Unknown format ( %s )! Use json or text\n", argv[1]);
+            return 1;
+        }
+    }
+    if(cliJsonEnabled()){
+        cliJson_t json;
+        cliJsonBegin(&json, current);
+        cliJsonString(&json, "format", cliSessionFormatName(current->format));
+        cliJsonEnd(&json);
+    }
+    else
+        cliSessionPrintf("Output Format: %s\n", cliSessionFormatName(current->format));
+
+    return 0;
+}
+
+// Register function for 'format' command:
+static void register_format(void){
+    const esp_console_cmd_t cmd = {
+        .command = "format",
+        .help = "Print or Change Output Format of Session. Usage: format [json|text]",
+        .hint = NULL,
+        .func = &format,
+        .argtable = NULL,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+// Arguments table for 'baud' command:
+static struct{
+    struct arg_int *baud_rate;
+    struct arg_int *flow_ctrl;
+    struct arg_end *end;
+}baud_args;
+
+// Command function for 'baud' command:
+static int baud(int argc, char **argv){
+    int err = arg_parse(argc, argv, (void **)&baud_args);
+    if(err != 0){
+        //...
+        return 1;
+    }
+    // For -f argument
+    if(baud_args.flow_ctrl->count){
+        err = cliUartSetFlowControl(baud_args.flow_ctrl->ival[0] != 0);
+        if(err > 0){
+            // RTS and CTS pins may be driven by pwm, waveform or a bus
+            if(cliGpioReportOwner(UART_RTS_PIN, CLI_GPIO_OWNER_UART))
+                cliGpioReportOwner(UART_CTS_PIN, CLI_GPIO_OWNER_UART);
+            return 1;
+        }
+        if(err < 0){
+            cliSessionPrintf("Fail during Setting Flow Control!\n");
+            return 1;
+        }
+    }
+    // For -b argument
+    if(baud_args.baud_rate->count){
+        int rate = baud_args.baud_rate->ival[0];
+        if(rate < UART_BAUD_MIN || rate > UART_BAUD_MAX){
+            cliSessionPrintf("Baud rate must be between %d and %d!\n", UART_BAUD_MIN, UART_BAUD_MAX);
+            return 1;
+        }
+        cliSessionPrintf("Switching to %d baud, press Enter at new rate in %d ms to confirm\n", rate, UART_BAUD_CONFIRM_MS);
+        err = cliUartNegotiateBaudRate(rate);
+        if(err > 0)
+            cliSessionPrintf("Baud rate not confirmed, restored!\n");
+        else if(err < 0)
+            cliSessionPrintf("Fail during Setting Baud Rate!\n");
+    }
+    const cliUartStats_t *stats = cliUartGetStats();
+    cliSessionPrintf("Baud Rate: %u, Flow Control: %s\n", cliUartGetBaudRate(), cliUartGetFlowControl() ? "RTS/CTS" : "OFF");
+    cliSessionPrintf("RX Events: %u, RX Bytes: %u, FIFO Overflows: %u, Buffer Full: %u\n"
+                     "Frame Errors: %u, Parity Errors: %u, Breaks: %u\n",
+                     stats->dataEvents, stats->rxBytes, stats->fifoOverflows, stats->bufferFull,
+                     stats->frameErrors, stats->parityErrors, stats->breaks);
+
+    return 0;
+}
+
+// Register function for 'baud' command:
+static void register_baud(void){
+    int num_args = 2;
+
+    baud_args.baud_rate = arg_int0("b", "baud", "<rate>", "New baud rate, must be confirmed at new rate");
+    baud_args.flow_ctrl = arg_int0("f", "flow", "<1|0>", "RTS/CTS hardware flow control");
+    baud_args.end = arg_end(num_args);
+
+    const esp_console_cmd_t cmd = {
+        .command = "baud",
+        .help = "Print or Change UART Baud Rate and Flow Control",
+        .hint = NULL,
+        .func = &baud,
+        .argtable = &baud_args
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+// Arguments table for 'framed' command:
+static struct{
+    struct arg_lit *stats;
+    struct arg_end *end;
+}framed_args;
+
+// Command function for 'framed' command:
+static int framed(int argc, char **argv){
+    int err = arg_parse(argc, argv, (void **)&framed_args);
+    if(err != 0){
+        //...
+        return 1;
+    }
+    // For -s argument
+    if(framed_args.stats->count){
+        const cliFrameStats_t *stats = cliFrameGetStats();
+        cliSessionPrintf("RX Frames: %u, TX Frames: %u, CRC Errors: %u, Length Errors: %u\n",
+                         stats->rxFrames, stats->txFrames, stats->crcErrors, stats->lengthErrors);
+        return 0;
+    }
+    // Framed loop is started by cli_task after this command returns
+    cliSessionPrintf("Entering COBS framed mode, send EXIT frame to return\n");
+    cliFrameRequest();
+
+    return 0;
+}
+
+// Register function for 'framed' command:
+static void register_framed(void){
+    int num_args = 1;
+
+    framed_args.stats = arg_lit0("s", "stats", "Framed mode statistics");
+    framed_args.end = arg_end(num_args);
+
+    const esp_console_cmd_t cmd = {
+        .command = "framed",
+        .help = "Switch UART to COBS Framed Machine Mode",
+        .hint = NULL,
+        .func = &framed,
+        .argtable = &framed_args
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+// Arguments table for 'capture' command:
+static struct{
+    struct arg_str *pin_mask;
+    struct arg_int *period;
+    struct arg_int *samples;
+    struct arg_int *trigger_pin;
+    struct arg_str *trigger_edge;
+    struct arg_end *end;
+}capture_args;
+
+// Command function for 'capture' command:
+static int capture(int argc, char **argv){
+    int err = arg_parse(argc, argv, (void **)&capture_args);
+    if(err != 0){
+        //...
+        return 1;
+    }
+    // Capture stream is binary, it would be changed or cut by other sessions
+    if(!cliSessionIsBinary(cliSessionGetCurrent())){
+        cliSessionPrintf("Capture needs a TCP or framed session in text format!\n");
+        return 1;
+    }
+    if(cliCaptureIsBusy()){
+        cliSessionPrintf("Capture is already running!\n");
+        return 1;
+    }
+    if(!capture_args.pin_mask->count || !capture_args.period->count || !capture_args.samples->count){
+        cliSessionPrintf("-m (mask), -r (period) and -n (samples) argument must be entering at the same time!\n");
+        return 1;
+    }
+    cliCaptureConfig_t config = {
+        .mask = strtoull(capture_args.pin_mask->sval[0], NULL, 0),
+        .periodUs = capture_args.period->ival[0],
+        .samples = capture_args.samples->ival[0],
+        .trigger = CLI_CAPTURE_TRIGGER_NONE
+    };
+    int badPin;
+    if(config.mask == 0){
+        cliSessionPrintf("Pin mask must select at least one pin!\n");
+        return 1;
+    }
+    if(cliBoardCheckMask(config.mask, CLI_BOARD_USE_READ, &badPin) != CLI_BOARD_PIN_OK){
+        cliBoardReportPin(badPin, CLI_BOARD_USE_READ);
+        return 1;
+    }
+    if(capture_args.period->ival[0] < CLI_CAPTURE_MIN_PERIOD_US || capture_args.samples->ival[0] <= 0){
+        cliSessionPrintf("Sample period must be at least %d us and sample count positive!\n", CLI_CAPTURE_MIN_PERIOD_US);
+        return 1;
+    }
+    // For -t and -e arguments
+    if(capture_args.trigger_pin->count){
+        int pin = capture_args.trigger_pin->ival[0];
+        if(pin < 0 || pin > CLI_BOARD_MAX_PIN || !(config.mask & (1ULL << pin))){
+            cliSessionPrintf("Trigger pin must be in pin mask!\n");
+            return 1;
+        }
+        config.triggerPin = pin;
+        config.trigger = CLI_CAPTURE_TRIGGER_RISING;
+        if(capture_args.trigger_edge->count && strcmp(capture_args.trigger_edge->sval[0], "falling") == 0)
+            config.trigger = CLI_CAPTURE_TRIGGER_FALLING;
+    }
+
+    return cliCaptureRun(&config) == CLI_CAPTURE_STATUS_OK ? 0 : 1;
+}
+
+// Register function for 'capture' command:
+static void register_capture(void){
+    int num_args = 5;
+
+    capture_args.pin_mask = arg_str0("m", "mask", "<mask>", "Pin mask, bit n is GPIOn");
+    capture_args.period = arg_int0("r", "period", "<us>", "Sample period in microseconds");
+    capture_args.samples = arg_int0("n", "samples", "<count>", "Sample count");
+    capture_args.trigger_pin = arg_int0("t", "trigger", "<gpio>", "Trigger pin");
+    capture_args.trigger_edge = arg_str0("e", "edge", "<rising|falling>", "Trigger edge");
+    capture_args.end = arg_end(num_args);
+
+    const esp_console_cmd_t cmd = {
+        .command = "capture",
+        .help = "Sample GPIO Pins and Stream Binary Run Length Encoded Data",
+        .hint = NULL,
+        .func = &capture,
+        .argtable = &capture_args
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+// Arguments table for 'adc_stream' command:
+static struct{
+    struct arg_str *pin_mask;
+    struct arg_int *rate;
+    struct arg_int *records;
+    struct arg_int *decimation;
+    struct arg_str *fields;
+    struct arg_str *source;
+    struct arg_end *end;
+}adc_stream_args;
+
+// Command function for 'adc_stream' command:
+static int adc_stream(int argc, char **argv){
+    int err = arg_parse(argc, argv, (void **)&adc_stream_args);
+    if(err != 0){
+        //...
+        return 1;
+    }
+    // Stream is binary like capture
+    if(!cliSessionIsBinary(cliSessionGetCurrent())){
+        cliSessionPrintf("ADC stream needs a TCP or framed session in text format!\n");
+        return 1;
+    }
+    if(cliAdcIsBusy()){
+        cliSessionPrintf("ADC stream is already running!\n");
+        return 1;
+    }
+    if(!adc_stream_args.pin_mask->count || !adc_stream_args.rate->count || !adc_stream_args.records->count){
+        cliSessionPrintf("-m (mask), -r (rate) and -n (records) argument must be entering at the same time!\n");
+        return 1;
+    }
+    cliAdcConfig_t config = {
+        .mask = strtoull(adc_stream_args.pin_mask->sval[0], NULL, 0),
+        .rate = adc_stream_args.rate->ival[0],
+        .records = adc_stream_args.records->ival[0],
+        .decimation = 1,
+        .fields = CLI_ADC_FIELD_MEAN,
+        .source = CLI_ADC_SOURCE_HARDWARE
+    };
+    int badPin;
+    int channels = __builtin_popcountll(config.mask);
+    if(channels == 0 || channels > CLI_ADC_MAX_CHANNELS){
+        cliSessionPrintf("Pin mask must select 1 to %d pins!\n", CLI_ADC_MAX_CHANNELS);
+        return 1;
+    }
+    if(cliBoardCheckMask(config.mask, CLI_BOARD_USE_ADC, &badPin) != CLI_BOARD_PIN_OK){
+        cliBoardReportPin(badPin, CLI_BOARD_USE_ADC);
+        return 1;
+    }
+    if(adc_stream_args.rate->ival[0] <= 0 || adc_stream_args.records->ival[0] <= 0){
+        cliSessionPrintf("Sample rate and record count must be positive!\n");
+        return 1;
+    }
+    // For -d, -f and -s arguments
+    if(adc_stream_args.decimation->count){
+        int decimation = adc_stream_args.decimation->ival[0];
+        if(decimation < 1 || decimation > CLI_ADC_MAX_DECIMATION){
+            cliSessionPrintf("Decimation must be between 1 and %d!\n", CLI_ADC_MAX_DECIMATION);
+            return 1;
+        }
+        config.decimation = decimation;
+    }
+    if(adc_stream_args.fields->count){
+        char fields[32];
+        strlcpy(fields, adc_stream_args.fields->sval[0], sizeof(fields));
+        config.fields = 0;
+        for(char *field = strtok(fields, ","); field != NULL; field = strtok(NULL, ",")){
+            if(strcmp(field, "mean") == 0)
+                config.fields |= CLI_ADC_FIELD_MEAN;
+            else if(strcmp(field, "min") == 0)
+                config.fields |= CLI_ADC_FIELD_MIN;
+            else if(strcmp(field, "max") == 0)
+                config.fields |= CLI_ADC_FIELD_MAX;
+            else{
+                cliSessionPrintf("Unknown field ( %s ), fields are mean, min and max!\n", field);
+                return 1;
             }
         }
-        // For -p argument
-        if(read_gpio_args.pin_number->count){
-            uint8_t pin = read_gpio_args.pin_number->ival[0];
-            if(pin != 20 && pin != 24 && pin != 28 && pin != 29 && pin != 30 && pin != 31 && pin != 37 && pin != 38 )
-                printf("GPIO Pin-%d Status: %s\n", pin, GPIO_PIN_HIGH == gpio_get_level(pin) ? "HIGH" : "LOW");
-            else
-                printf("This pin ( %d ) is not available in ESP-WROOM-32 Board!\n", pin); 
+        if(config.fields == 0){
+            cliSessionPrintf("At least one field must be selected!\n");
+            return 1;
+        }
+    }
+    if(adc_stream_args.source->count){
+        config.source = cliAdcFindSource(adc_stream_args.source->sval[0]);
+        if(config.source == CLI_ADC_SOURCE_COUNT){
+            cliSessionPrintf("Unknown source ( %s ), sources are hw and synth!\n", adc_stream_args.source->sval[0]);
+            return 1;
+        }
+    }
+    // Source converts every pin at the rate, so its limits are for the sum
+    const cliAdcSource_t *source = cliAdcGetSource(config.source);
+    uint64_t total = (uint64_t)config.rate * channels;
+    if(total < source->minRate || total > source->maxRate){
+        cliSessionPrintf("Rate of all pins must be between %u and %u Hz for %s source!\n",
+                         source->minRate, source->maxRate, source->name);
+        return 1;
+    }
+
+    switch(cliAdcStream(&config)){
+        case CLI_ADC_STATUS_OK:
+        case CLI_ADC_STATUS_ABORTED:
+            return 0;
+        case CLI_ADC_STATUS_BUSY:
+            cliSessionPrintf("ADC stream is already running!\n");
+            return 1;
+        case CLI_ADC_STATUS_NO_SOURCE:
+            cliSessionPrintf("%s source can not start, continuous mode only converts ADC1 pins (GPIO32-39)!\n", source->name);
+            return 1;
+        default:
+            return 1;
+    }
+}
+
+// Register function for 'adc_stream' command:
+static void register_adc_stream(void){
+    int num_args = 6;
+
+    adc_stream_args.pin_mask = arg_str0("m", "mask", "<mask>", "Pin mask, bit n is GPIOn");
+    adc_stream_args.rate = arg_int0("r", "rate", "<hz>", "Sample rate of every pin");
+    adc_stream_args.records = arg_int0("n", "records", "<count>", "Record count");
+    adc_stream_args.decimation = arg_int0("d", "decimation", "<count>", "Conversions reduced into one record");
+    adc_stream_args.fields = arg_str0("f", "fields", "<mean,min,max>", "Reduced values of a record");
+    adc_stream_args.source = arg_str0("s", "source", "<hw|synth>", "Conversion source");
+    adc_stream_args.end = arg_end(num_args);
+
+    const esp_console_cmd_t cmd = {
+        .command = "adc_stream",
+        .help = "Sample ADC Pins in Continuous Mode and Stream Binary Min/Max/Mean Blocks, Any Input Stops It",
+        .hint = NULL,
+        .func = &adc_stream,
+        .argtable = &adc_stream_args
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+// Prints state of a bus
+static void bus_status(cliBusType_t bus){
+    const cliBusDriver_t *driver = cliBusGetDriver(bus);
+    const cliBusConfig_t *config = cliBusGetConfig(bus);
+    int pins = bus == CLI_BUS_I2C ? 2 : 4;
+    if(cliJsonEnabled()){
+        cliJson_t json;
+        cliJsonBegin(&json, cliSessionGetCurrent());
+        cliJsonString(&json, "bus", cliBusName(bus));
+        cliJsonBool(&json, "open", driver != NULL);
+        if(driver != NULL){
+            cliJsonString(&json, "driver", driver->name);
+            cliJsonArray(&json, "pins");
+            for(int i = 0; i < pins; i++)
+                cliJsonInt(&json, NULL, config->pins[i]);
+            cliJsonClose(&json);
+            cliJsonUint(&json, "hz", config->hz);
+        }
+        cliJsonEnd(&json);
+        return;
+    }
+    if(driver == NULL){
+        cliSessionPrintf("%s is closed\n", cliBusName(bus));
+        return;
+    }
+    cliSessionPrintf("%s: %s driver, %u Hz, pins", cliBusName(bus), driver->name, config->hz);
+    for(int i = 0; i < pins; i++)
+        cliSessionPrintf(" %d", config->pins[i]);
+    if(bus == CLI_BUS_SPI)
+        cliSessionPrintf(", mode %d", config->mode);
+    cliSessionPrintf("\n");
+}
+
+// Opens a bus, pins are checked against board profile
+static int bus_open(cliBusType_t bus, int argc, char **argv){
+    cliBusConfig_t config = {
+        .pins = { -1, -1, -1, -1 },
+        .hz = bus == CLI_BUS_I2C ? CLI_BUS_I2C_HZ : CLI_BUS_SPI_HZ,
+        .mode = 0
+    };
+    const cliBusDriver_t *driver = cliBusHardwareDriver();
+    if(argc == 3 && strcmp(argv[2], "mock") == 0)
+        driver = cliBusMockDriver();
+    else{
+        int pins = bus == CLI_BUS_I2C ? 2 : 4;
+        if(argc < 2 + pins || argc > 2 + pins + (bus == CLI_BUS_I2C ? 1 : 2)){
+            cliSessionPrintf(bus == CLI_BUS_I2C ? "Usage: i2c open <sda> <scl> [hz] | i2c open mock\n"
+                                                : "Usage: spi open <mosi> <miso> <sclk> <cs> [hz] [mode] | spi open mock\n");
+            return 1;
+        }
+        for(int i = 0; i < pins; i++){
+            config.pins[i] = atoi(argv[2 + i]);
+            // Only SPI MISO is an input, I2C lines are open drain outputs
+            cliBoardUse_t use = bus == CLI_BUS_SPI && i == 1 ? CLI_BOARD_USE_READ : CLI_BOARD_USE_WRITE;
+            if(!cliBoardReportPin(config.pins[i], use))
+                return 1;
+            if(!cliGpioReportOwner(config.pins[i], bus == CLI_BUS_I2C ? CLI_GPIO_OWNER_I2C : CLI_GPIO_OWNER_SPI))
+                return 1;
+        }
+        if(argc > 2 + pins)
+            config.hz = atoi(argv[2 + pins]);
+        if(argc > 3 + pins)
+            config.mode = atoi(argv[3 + pins]);
+        if(config.hz == 0 || config.mode > 3){
+            cliSessionPrintf("Clock must be positive and SPI mode between 0 and 3!\n");
+            return 1;
+        }
+    }
+    esp_err_t err = cliBusOpen(bus, driver, &config);
+    if(err != ESP_OK){
+        cliSessionPrintf("Unable to open %s ( %s )!\n", cliBusName(bus), esp_err_to_name(err));
+        return 1;
+    }
+    bus_status(bus);
+    return 0;
+}
+
+// Command function for 'i2c' and 'spi' commands, arguments are parsed by hand because list is free form
+static int bus_command(int argc, char **argv){
+    cliBusType_t bus = strcmp(argv[0], "i2c") == 0 ? CLI_BUS_I2C : CLI_BUS_SPI;
+    if(argc == 1){
+        bus_status(bus);
+        return 0;
+    }
+    if(strcmp(argv[1], "open") == 0)
+        return bus_open(bus, argc, argv);
+    if(argc == 2 && strcmp(argv[1], "close") == 0){
+        cliBusClose(bus);
+        return 0;
+    }
+    bool binary = strcmp(argv[1], "-b") == 0;
+    if(argc != (binary ? 3 : 2)){
+        cliSessionPrintf("Usage: %s [open ...|close] | %s [-b] <list>\n", argv[0], argv[0]);
+        return 1;
+    }
+    // Binary response is like capture stream
+    if(binary && !cliSessionIsBinary(cliSessionGetCurrent())){
+        cliSessionPrintf("Binary response needs a TCP or framed session in text format!\n");
+        return 1;
+    }
+    cliBusReport_t report;
+    cliBusResult_t result = cliBusRun(bus, argv[binary ? 2 : 1], &report);
+    if(binary){
+        cliBusWriteResponse(result, &report, true);
+        return result == CLI_BUS_OK ? 0 : 1;
+    }
+    switch(result){
+        case CLI_BUS_OK:
+            cliBusWriteResponse(result, &report, false);
+            return 0;
+        case CLI_BUS_NOT_OPEN:
+            cliSessionPrintf("%s is not open! Type '%s open'\n", cliBusName(bus), cliBusName(bus));
+            break;
+        case CLI_BUS_SYNTAX:
+            cliSessionPrintf("Syntax error in item %d!\n", report.item + 1);
+            break;
+        case CLI_BUS_TOO_LONG:
+            cliSessionPrintf("List is too long at item %d, limits are %d transfers and %d bytes!\n",
+                             report.item + 1, CLI_BUS_MAX_OPS, CLI_BUS_DATA_SIZE);
+            break;
+        case CLI_BUS_NO_ADDRESS:
+            cliSessionPrintf("Item %d needs a device address, start the list with a<addr>!\n", report.item + 1);
+            break;
+        case CLI_BUS_WRONG_BUS:
+            cliSessionPrintf("Item %d is not supported on %s!\n", report.item + 1, cliBusName(bus));
+            break;
+        case CLI_BUS_DELAY_TOO_LONG:
+            cliSessionPrintf("Delay is too long at item %d, limits are %d us per item and %d us per list!\n",
+                             report.item + 1, CLI_BUS_MAX_DELAY_US, CLI_BUS_MAX_LIST_DELAY_US);
+            break;
+        default:
+            cliSessionPrintf("Transfer failed in segment starting at item %d ( %s )!\n", report.item + 1, esp_err_to_name(report.err));
+            break;
+    }
+    return 1;
+}
+
+// Register function for 'i2c' and 'spi' commands:
+static void register_bus(void){
+    const esp_console_cmd_t i2c = {
+        .command = "i2c",
+        .help = "Run a Transaction List on I2C Bus. Usage: i2c open <sda> <scl> [hz] | i2c [-b] a<addr>,w<hex>,r<n>,b<reg>:<n>,d<us>",
+        .hint = NULL,
+        .func = &bus_command,
+        .argtable = NULL
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&i2c));
+    const esp_console_cmd_t spi = {
+        .command = "spi",
+        .help = "Run a Transaction List on SPI Bus. Usage: spi open <mosi> <miso> <sclk> <cs> [hz] [mode] | spi [-b] w<hex>,r<n>,x<hex>,b<reg>:<n>,d<us>",
+        .hint = NULL,
+        .func = &bus_command,
+        .argtable = NULL
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&spi));
+}
+
+// Prints outputs of all PWM channels
+static void pwm_status(void){
+    if(cliJsonEnabled()){
+        cliJson_t json;
+        cliJsonBegin(&json, cliSessionGetCurrent());
+        cliJsonArray(&json, "pwm");
+        for(int i = 0; i < CLI_PWM_CHANNELS; i++){
+            const cliPwm_t *pwm = cliPwmGet(i);
+            if(pwm->pin < 0)
+                continue;
+            cliJsonObject(&json, NULL);
+            cliJsonInt(&json, "gpio", pwm->pin);
+            cliJsonUint(&json, "hz", pwm->hz);
+            cliJsonUint(&json, "duty", pwm->duty);
+            cliJsonUint(&json, "bits", pwm->bits);
+            cliJsonClose(&json);
+        }
+        cliJsonClose(&json);
+        cliJsonEnd(&json);
+        return;
+    }
+    int count = 0;
+    for(int i = 0; i < CLI_PWM_CHANNELS; i++){
+        const cliPwm_t *pwm = cliPwmGet(i);
+        if(pwm->pin < 0)
+            continue;
+        cliSessionPrintf("GPIO %d: %u Hz, duty %u.%02u %%, %u bit\n", pwm->pin, pwm->hz,
+                         pwm->duty / 100, pwm->duty % 100, pwm->bits);
+        count++;
+    }
+    if(count == 0)
+        cliSessionPrintf("No PWM output\n");
+}
+
+// Parses duty percent with up to two decimals into 1/100 percent, returns -1 for a wrong value
+static int pwm_duty(const char *text){
+    char *end;
+    float percent = strtof(text, &end);
+    if(end == text || *end != 0 || percent < 0 || percent > 100)
+        return -1;
+    return (int)(percent * 100 + 0.5f);
+}
+
+// Command function for 'pwm' command, arguments are parsed by hand because of subcommands
+static int pwm_command(int argc, char **argv){
+    if(argc == 1){
+        pwm_status();
+        return 0;
+    }
+    bool start = strcmp(argv[1], "start") == 0;
+    bool update = strcmp(argv[1], "update") == 0;
+    bool stop = strcmp(argv[1], "stop") == 0;
+    if(!((start || update) && argc == 5) && !(stop && (argc == 3 || argc == 4))){
+        cliSessionPrintf("Usage: pwm [start|update <gpio> <hz> <duty%%>] | pwm stop <gpio> [0|1]\n");
+        return 1;
+    }
+    int pin = atoi(argv[2]);
+    esp_err_t err;
+    if(stop){
+        uint32_t level = argc == 4 ? atoi(argv[3]) : 0;
+        if(level > 1){
+            cliSessionPrintf("Pin data must be 1 or 0!\n");
+            return 1;
+        }
+        err = cliPwmStop(pin, level);
+    }
+    else{
+        uint32_t hz = strtoul(argv[3], NULL, 10);
+        int duty = pwm_duty(argv[4]);
+        if(hz < CLI_PWM_MIN_HZ || hz > CLI_PWM_MAX_HZ || duty < 0){
+            cliSessionPrintf("Frequency must be between %u and %u Hz, duty between 0 and 100 %%!\n",
+                             CLI_PWM_MIN_HZ, CLI_PWM_MAX_HZ);
+            return 1;
+        }
+        if(start && (!cliBoardReportPin(pin, CLI_BOARD_USE_WRITE) || !cliGpioReportOwner(pin, CLI_GPIO_OWNER_PWM)))
+            return 1;
+        err = start ? cliPwmStart(pin, hz, duty) : cliPwmUpdate(pin, hz, duty);
+    }
+    switch(err){
+        case ESP_OK:
+            pwm_status();
+            return 0;
+        case ESP_ERR_NOT_FOUND:
+            cliSessionPrintf("No PWM output on GPIO %d!\n", pin);
+            break;
+        case ESP_ERR_NO_MEM:
+            cliSessionPrintf("All %d PWM channels are in use!\n", CLI_PWM_CHANNELS);
+            break;
+        case ESP_ERR_INVALID_SIZE:
+            cliSessionPrintf("Frequency does not fit duty resolution of start, use 'pwm start'!\n");
+            break;
+        default:
+            cliSessionPrintf("PWM failed ( %s )!\n", esp_err_to_name(err));
+            break;
+    }
+    return 1;
+}
+
+// Register function for 'pwm' command:
+static void register_pwm(void){
+    const esp_console_cmd_t cmd = {
+        .command = "pwm",
+        .help = "Generate PWM with LEDC. Usage: pwm start <gpio> <hz> <duty%> | pwm update <gpio> <hz> <duty%> | pwm stop <gpio> [0|1]",
+        .hint = NULL,
+        .func = &pwm_command,
+        .argtable = NULL
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+// Prints sequences of all waveform channels
+static void waveform_status(void){
+    if(cliJsonEnabled()){
+        cliJson_t json;
+        cliJsonBegin(&json, cliSessionGetCurrent());
+        cliJsonArray(&json, "waveforms");
+        for(int i = 0; i < CLI_WAVE_CHANNELS; i++){
+            const cliWave_t *wave = cliWaveGet(i);
+            if(wave->pin < 0)
+                continue;
+            cliJsonObject(&json, NULL);
+            cliJsonInt(&json, "gpio", wave->pin);
+            cliJsonUint(&json, "phases", wave->phases);
+            cliJsonUint(&json, "items", wave->items);
+            cliJsonUint(&json, "period_us", wave->passUs);
+            cliJsonUint(&json, "repeat", wave->repeat);
+            cliJsonBool(&json, "running", cliWaveIsRunning(wave));
+            cliJsonClose(&json);
+        }
+        cliJsonClose(&json);
+        cliJsonEnd(&json);
+        return;
+    }
+    int count = 0;
+    for(int i = 0; i < CLI_WAVE_CHANNELS; i++){
+        const cliWave_t *wave = cliWaveGet(i);
+        if(wave->pin < 0)
+            continue;
+        cliSessionPrintf("GPIO %d: %u phases in %u items, period %u us, ", wave->pin, wave->phases, wave->items, wave->passUs);
+        if(wave->repeat == 0)
+            cliSessionPrintf("loop\n");
+        else
+            cliSessionPrintf("%u times, %s\n", wave->repeat, cliWaveIsRunning(wave) ? "running" : "done");
+        count++;
+    }
+    if(count == 0)
+        cliSessionPrintf("No waveform output\n");
+}
+
+// Command function for 'waveform' command, arguments are parsed by hand because list is free form
+static int waveform_command(int argc, char **argv){
+    if(argc == 1){
+        waveform_status();
+        return 0;
+    }
+    bool start = strcmp(argv[1], "start") == 0;
+    bool update = strcmp(argv[1], "update") == 0;
+    bool stop = strcmp(argv[1], "stop") == 0;
+    if(!(start && (argc == 4 || argc == 5)) && !(update && argc == 4) && !(stop && argc == 3)){
+        cliSessionPrintf("Usage: waveform [start <gpio> <level>:<us>,<us>,... [repeat]] | waveform update <gpio> <list> | waveform stop <gpio>\n");
+        return 1;
+    }
+    int pin = atoi(argv[2]);
+    esp_err_t err;
+    if(stop)
+        err = cliWaveStop(pin);
+    else if(update)
+        err = cliWaveUpdate(pin, argv[3]);
+    else{
+        if(!cliBoardReportPin(pin, CLI_BOARD_USE_WRITE) || !cliGpioReportOwner(pin, CLI_GPIO_OWNER_WAVEFORM))
+            return 1;
+        // Repeat 0 loops until stop
+        err = cliWaveStart(pin, argv[3], argc == 5 ? strtoul(argv[4], NULL, 10) : 1);
+    }
+    switch(err){
+        case ESP_OK:
+            if(stop)
+                cliSessionPrintf("Waveform on GPIO %d is stopped\n", pin);
+            else
+                waveform_status();
+            return 0;
+        case ESP_ERR_NOT_FOUND:
+            cliSessionPrintf("No waveform output on GPIO %d!\n", pin);
+            break;
+        case ESP_ERR_NO_MEM:
+            cliSessionPrintf("All %d waveform channels are in use!\n", CLI_WAVE_CHANNELS);
+            break;
+        case ESP_ERR_INVALID_ARG:
+            cliSessionPrintf("Wrong list, it is the first level and phase lengths in us, e.g. 1:10,20,2.5!\n");
+            break;
+        case ESP_ERR_INVALID_SIZE:
+            cliSessionPrintf("Sequence is too long, limit is %d items of %d us after repeats!\n",
+                             CLI_WAVE_MAX_ITEMS, 2 * CLI_WAVE_MAX_TICKS / CLI_WAVE_TICKS_PER_US);
+            break;
+        default:
+            cliSessionPrintf("Waveform failed ( %s )!\n", esp_err_to_name(err));
+            break;
+    }
+    return 1;
+}
+
+// Register function for 'waveform' command:
+static void register_waveform(void){
+    const esp_console_cmd_t cmd = {
+        .command = "waveform",
+        .help = "Play a Pulse Sequence with RMT. Usage: waveform start <gpio> <level>:<us>,<us>,... [repeat, 0 loops] | waveform update <gpio> <list> | waveform stop <gpio>",
+        .hint = NULL,
+        .func = &waveform_command,
+        .argtable = NULL
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+// Command function for 'every' command, arguments are parsed by hand because rest of line is a command
+static int every(int argc, char **argv){
+    // List jobs
+    if(argc == 1 || (argc == 2 && strcmp(argv[1], "-l") == 0)){
+        cliSchedList();
+        return 0;
+    }
+    // Cancel job
+    if(argc == 3 && strcmp(argv[1], "-c") == 0){
+        if(cliSchedCancel(atoi(argv[2])) != 0){
+            cliSessionPrintf("There is no job ( %s )!\n", argv[2]);
+            return 1;
+        }
+        return 0;
+    }
+    // Set CPU cap
+    if(argc == 3 && strcmp(argv[1], "-u") == 0){
+        int percent = atoi(argv[2]);
+        if(percent < 1 || percent > 100){
+            cliSessionPrintf("CPU cap must be between 1 and 100!\n");
+            return 1;
         }
+        cliSchedSetCap(percent);
+        return 0;
     }
-    // If tcp is enable:
-    else if(ENABLE_TCP){
-        // For -a argument
-        if(read_gpio_args.pin_param->count){
-            strcpy(transmittedBuffer, "\n------------------\n"
-                                      "|GPIO_PIN | STATUS|"
-                                      "\n------------------\n");
-            size_t size = 0;
-            for(uint8_t i = 0; i <= 39; i++){
-                size = strlen(transmittedBuffer);
-                //These pins not available for ESP-WRROM-32 board
-                if(i == 20 || i == 24 || i == 28 || i == 29 || i == 30 || i == 31 || i == 37 || i == 38)
-                    continue;
-                sprintf(transmittedBuffer + size, "Pin-%d :  %s\n", i, GPIO_PIN_HIGH == gpio_get_level(i) ? "HIGH" : "LOW");
-                size = strlen(transmittedBuffer);
-            }
-            sprintf(transmittedBuffer + size, "----------------------\n");
-            int err = send(sock, transmittedBuffer, strlen(transmittedBuffer), 0);
-            if(err < 0)
-                ESP_LOGE(TAGTCP, "Error occurred during sending!");
-            ESP_LOGI(TAGTCP, "Sending %d bytes with TCP Protocol", strlen(transmittedBuffer));
-        }
-        // For -p argument
-        if(read_gpio_args.pin_number->count){
-            uint8_t pin = read_gpio_args.pin_number->ival[0];
-            //These pins not available for ESP-WRROM-32 board
-            if(pin != 20 && pin != 24 && pin != 28 && pin != 29 && pin != 30 && pin != 31 && pin != 37 && pin != 38 ){
-                sprintf(transmittedBuffer, "GPIO Pin-%d Status: %s\n", pin, GPIO_PIN_HIGH == gpio_get_level(pin) ? "HIGH" : "LOW");
-                int err = send(sock, transmittedBuffer, strlen(transmittedBuffer), 0);
-                if(err < 0)
-                    ESP_LOGE(TAGTCP, "Error occurred during sending!");
-            }
-            else{
-                sprintf(transmittedBuffer, "This pin ( %d ) is not available in ESP-WROOM-32 Board!\n", pin);
-                int err = send(sock, transmittedBuffer, strlen(transmittedBuffer), 0);
-                if(err < 0)
-                    ESP_LOGE(TAGTCP, "Error occurred during sending!");
-            }
+
+    int period = atoi(argv[1]);
+    if(argc < 3 || period < CLI_SCHED_MIN_PERIOD_MS){
+        cliSessionPrintf("Usage: every <ms> <command>, period must be at least %d ms!\n", CLI_SCHED_MIN_PERIOD_MS);
+        return 1;
+    }
+    cliSession_t *owner = cliSessionGetCurrent();
+    if(owner == NULL || (owner->transport != CLI_SESSION_TCP && owner->transport != CLI_SESSION_UART)){
+        cliSessionPrintf("Periodic jobs need a TCP or UART session!\n");
+        return 1;
+    }
+    // Join rest of arguments, quotes are restored for arguments which have spaces
+    char line[CLI_SCHED_LINE_LEN];
+    size_t len = 0;
+    for(int i = 2; i < argc; i++){
+        bool quote = strchr(argv[i], ' ') != NULL;
+        int n = snprintf(line + len, sizeof(line) - len, quote ? "%s\"%s\"" : "%s%s", i > 2 ? " " : "", argv[i]);
+        if(n < 0 || (size_t)n >= sizeof(line) - len){
+            cliSessionPrintf("Command is too long!\n");
+            return 1;
         }
+        len += n;
     }
-    // If both are disable (uart and tcp): 
-    else{
-        ESP_LOGE(TAGESP32, "No Connection!");
+    int id = cliSchedAdd(owner, period, line);
+    if(id < 0){
+        cliSessionPrintf("No free job slot!\n");
+        return 1;
     }
+    cliSessionPrintf("Job %d: every %d ms '%s'\n", id, period, line);
 
-    return 0;    
+    return 0;
 }
 
-// Register function for 'read_gpio' command:
-static void register_read_gpio(void){
-    int num_args = 2;
+// Register function for 'every' command:
+static void register_every(void){
+    const esp_console_cmd_t cmd = {
+        .command = "every",
+        .help = "Run a Command Periodically and Push Changed Results. Usage: every <ms> <command> | -l | -c <id> | -u <percent>",
+        .hint = NULL,
+        .func = &every,
+        .argtable = NULL
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
 
-    read_gpio_args.pin_param = arg_lit0("a", "allpins", "All Pins Status");
-    read_gpio_args.pin_number = arg_int0("p", "pin", "<gpio>", "Pin number");
-    read_gpio_args.end = arg_end(num_args);
+// Command function for 'udp' command:
+static int udp(int argc, char **argv){
+    const cliUdpStats_t *stats = cliUdpGetStats();
+    if(cliJsonEnabled()){
+        cliJson_t json;
+        cliJsonBegin(&json, cliSessionGetCurrent());
+        cliJsonInt(&json, "port", stats->port);
+        cliJsonUint(&json, "datagrams", stats->datagrams);
+        cliJsonUint(&json, "commands", stats->commands);
+        cliJsonUint(&json, "duplicates", stats->duplicates);
+        cliJsonUint(&json, "stale", stats->stale);
+        cliJsonUint(&json, "acks", stats->acks);
+        cliJsonUint(&json, "errors", stats->errors);
+        cliJsonEnd(&json);
+        return 0;
+    }
+    cliSessionPrintf("UDP Port: %u\nDatagrams: %u\nCommands: %u\nDuplicates: %u\nStale: %u\nAcks: %u\nErrors: %u\n",
+                     stats->port, stats->datagrams, stats->commands, stats->duplicates, stats->stale,
+                     stats->acks, stats->errors);
+
+    return 0;
+}
 
+// Register function for 'udp' command:
+static void register_udp(void){
     const esp_console_cmd_t cmd = {
-        .command = "read_gpio",
-        .help = "Get GPIO Pin Status",
+        .command = "udp",
+        .help = "Print UDP Datagram Transport Statistics",
         .hint = NULL,
-        .func = &read_gpio,
-        .argtable = &read_gpio_args
+        .func = &udp,
+        .argtable = NULL,
     };
     ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
 }
 
-// Command function for 'version' command:
-static int get_version(int argc, char **argv){
-    // If uart is enable:
-    if(ENABLE_UART){
-        esp_chip_info_t info;
-        esp_chip_info(&info);
-        printf("IDF Version:%s\r\n", esp_get_idf_version());
-        printf("Chip info:\r\n");
-        printf("\tmodel:%s\r\n", info.model == CHIP_ESP32 ? "ESP32" : "Unknown");
-        printf("\tcores:%d\r\n", info.cores);
-        printf("\tfeature:%s%s%s%s%d%s\r\n",
-           info.features & CHIP_FEATURE_WIFI_BGN ? "/802.11bgn" : "",
-           info.features & CHIP_FEATURE_BLE ? "/BLE" : "",
-           info.features & CHIP_FEATURE_BT ? "/BT" : "",
-           info.features & CHIP_FEATURE_EMB_FLASH ? "/Embedded-Flash:" : "/External-Flash:",
-           spi_flash_get_chip_size() / (1024 * 1024), " MB");
-        printf("\trevision number:%d\r\n", info.revision);
-    }
-    // If tcp is enable:
-    else if(ENABLE_TCP){
-        size_t size = 0;
-        esp_chip_info_t info;
-        esp_chip_info(&info);
-        sprintf(transmittedBuffer + size, "IDF Version:%s\r\n", esp_get_idf_version());
-        strcat(transmittedBuffer, "Chip info:\r\n");
-        size = strlen(transmittedBuffer);
-        sprintf(transmittedBuffer + size, "\tmodel:%s\r\n", info.model == CHIP_ESP32 ? "ESP32" : "Unknown");
-        size = strlen(transmittedBuffer);
-        sprintf(transmittedBuffer + size, "\tcores:%d\r\n", info.cores);
-        size = strlen(transmittedBuffer);
-        sprintf(transmittedBuffer + size, "\tfeature:%s%s%s%s%d%s\r\n",
-           info.features & CHIP_FEATURE_WIFI_BGN ? "/802.11bgn" : "",
-           info.features & CHIP_FEATURE_BLE ? "/BLE" : "",
-           info.features & CHIP_FEATURE_BT ? "/BT" : "",
-           info.features & CHIP_FEATURE_EMB_FLASH ? "/Embedded-Flash:" : "/External-Flash:",
-           spi_flash_get_chip_size() / (1024 * 1024), " MB");
-        size = strlen(transmittedBuffer);
-        sprintf(transmittedBuffer + size, "\trevision number: %d\r\n", info.revision);
-        int err = send(sock, transmittedBuffer, strlen(transmittedBuffer), 0);
-        if(err < 0)
-            ESP_LOGE(TAGTCP, "Error occurred during sending!");
-        ESP_LOGI(TAGTCP, "Sending %d bytes with TCP Protocol", strlen(transmittedBuffer));
-    }
-    // If both are disable (uart and tcp): 
-    else{
-        ESP_LOGE(TAGESP32, "No Connection!\n");
+// Command function for 'jobs' command:
+static int list_jobs(int argc, char **argv){
+    cliJobList();
+
+    return 0;
+}
+
+// Register function for 'jobs' command:
+static void register_jobs(void){
+    const esp_console_cmd_t cmd = {
+        .command = "jobs",
+        .help = "List Background Jobs, a Command Ending with '&' or '&<ms>' Runs as a Job",
+        .hint = NULL,
+        .func = &list_jobs,
+        .argtable = NULL,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+// Command function for 'wait' command, arguments are copied since command lock is released while waiting
+static int wait_job(int argc, char **argv){
+    if(argc < 2 || argc > 3){
+        cliSessionPrintf("Usage: wait <id> [ms]\n");
+        return 1;
+    }
+    int id = atoi(argv[1]);
+    uint32_t timeout = argc == 3 ? strtoul(argv[2], NULL, 10) : CLI_JOB_WAIT_MS;
+    int err = cliJobWait(id, timeout);
+    if(err < 0){
+        cliSessionPrintf("There is no job ( %d )!\n", id);
+        return 1;
+    }
+    if(err > 0){
+        cliSessionPrintf("Job %d is still running!\n", id);
+        return 1;
     }
 
     return 0;
 }
 
-// Register function for 'version' command:
-static void register_version(void){
+// Register function for 'wait' command:
+static void register_wait(void){
     const esp_console_cmd_t cmd = {
-        .command = "version",
-        .help = "Get version of chip and SDK",
+        .command = "wait",
+        .help = "Wait for a Job and Print its Output. Usage: wait <id> [ms]",
         .hint = NULL,
-        .func = &get_version,
+        .func = &wait_job,
         .argtable = NULL,
     };
     ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
 }
 
-// Arguments table for 'write_gpio' command:
+// Command function for 'kill' command:
+static int kill_job(int argc, char **argv){
+    if(argc != 2){
+        cliSessionPrintf("Usage: kill <id>\n");
+        return 1;
+    }
+    if(cliJobKill(atoi(argv[1])) != 0){
+        cliSessionPrintf("There is no job ( %s )!\n", argv[1]);
+        return 1;
+    }
+
+    return 0;
+}
+
+// Register function for 'kill' command:
+static void register_kill(void){
+    const esp_console_cmd_t cmd = {
+        .command = "kill",
+        .help = "Cancel a Running Job or Discard a Finished One. Usage: kill <id>",
+        .hint = NULL,
+        .func = &kill_job,
+        .argtable = NULL,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+// Arguments table for 'top' command:
 static struct{
-    struct arg_int *pin_number;
-    struct arg_int *pin_state;
+    struct arg_int *interval;
+    struct arg_int *count;
     struct arg_end *end;
-}write_gpio_args;
+}top_args;
 
-// Command function for 'write_gpio' command:
-static int write_gpio(int argc, char **argv){
-    int err = arg_parse(argc, argv, (void **)&write_gpio_args);
+// Command function for 'top' command:
+static int top(int argc, char **argv){
+    int err = arg_parse(argc, argv, (void **)&top_args);
     if(err != 0){
         //...
         return 1;
     }
-    // If uart is enable:
-    if(ENABLE_UART){
-        int pin_number = 0;
-        uint32_t pin_state = 0;
-        // For -p and -d arguments
-        if(write_gpio_args.pin_number->count && write_gpio_args.pin_state->count){
-            pin_number = write_gpio_args.pin_number->ival[0];
-            pin_state = write_gpio_args.pin_state->ival[0];
-        }
-        else{
-            printf("-p (pin) and -d (data) argument must be entering at the same time!\n");
+    // Arguments are copied, other sessions may run 'top' while this one waits
+    int interval = top_args.interval->count ? top_args.interval->ival[0] : CLI_TOP_INTERVAL_MS;
+    int count = top_args.count->count ? top_args.count->ival[0] : 1;
+    if(interval < CLI_TOP_MIN_INTERVAL_MS || count < 0){
+        cliSessionPrintf("Interval must be at least %d ms and count can not be negative!\n", CLI_TOP_MIN_INTERVAL_MS);
+        return 1;
+    }
+    // Endless refresh would hold the console, it can only be stopped by 'kill'
+    if(count == 0 && !cliJobIsCurrent()){
+        cliSessionPrintf("Endless refresh must run as a job, e.g. 'top -n 0 &'!\n");
+        return 1;
+    }
+    switch(cliTopRun(interval, count)){
+        case CLI_TOP_OK:
+        case CLI_TOP_ABORTED:
+            return 0;
+        case CLI_TOP_BUSY:
+            cliSessionPrintf("Top is already running!\n");
             return 1;
-        }
-        gpio_set_direction(pin_number, GPIO_MODE_INPUT_OUTPUT);
-        err = gpio_set_level(pin_number, pin_state);
-        if(err == ESP_OK)
-            printf("Write operation successful! GPIO Pin: %d, Pin Data: %d\n", pin_number, pin_state);
-        else
-            printf("Fail in Writing!\n");
-
-        }
-    // If tcp is enable:    
-    else if(ENABLE_TCP){
-        int pin_number = 0;
-        uint32_t pin_state = 0;
-        // For -p and -d arguments
-        if(write_gpio_args.pin_number->count && write_gpio_args.pin_state->count){
-            pin_number = write_gpio_args.pin_number->ival[0];
-            pin_state = write_gpio_args.pin_state->ival[0];
-        }
-        else{
-            strcpy(transmittedBuffer, "-p (pin) and -d (data) argument must be entering at the same time!\n");
-            int err = send(sock, transmittedBuffer, strlen(transmittedBuffer), 0);
-            if(err < 0)
-                ESP_LOGE(TAGTCP, "Error occurred during sending!");
-            ESP_LOGI(TAGTCP, "Sending %d bytes with TCP Protocol", strlen(transmittedBuffer));
-
+        default:
+            cliSessionPrintf("Run time stats are not enabled! Enable CONFIG_FREERTOS_USE_TRACE_FACILITY and CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS\n");
             return 1;
-        }
-        gpio_set_direction(pin_number, GPIO_MODE_INPUT_OUTPUT);
-        err = gpio_set_level(pin_number, pin_state);
-        if(err == ESP_OK){
-            sprintf(transmittedBuffer, "Write operation successful! GPIO Pin: %d, Pin Data: %d\n", pin_number, pin_state);
-            int err = send(sock, transmittedBuffer, strlen(transmittedBuffer), 0);
-            if(err < 0)
-                ESP_LOGE(TAGTCP, "Error occurred during sending!");
-            ESP_LOGI(TAGTCP, "Sending %d bytes with TCP Protocol", strlen(transmittedBuffer));
-        }
-        else{
-            strcpy(transmittedBuffer, "Fail during Writing!\n");
-            int err = send(sock, transmittedBuffer, strlen(transmittedBuffer), 0);
-            if(err < 0)
-                ESP_LOGE(TAGTCP, "Error occurred during sending!");
-            ESP_LOGI(TAGTCP, "Sending %d bytes with TCP Protocol", strlen(transmittedBuffer));
-        }
-    }
-    // If both are disable (uart and tcp):
-    else{
-        ESP_LOGE(TAGESP32, "No Connection!\n");
     }
-
-    return 0;
 }
 
-// Register function for 'write_gpio' command:
-static void register_write_gpio(void){
+// Register function for 'top' command:
+static void register_top(void){
     int num_args = 2;
 
-    write_gpio_args.pin_number = arg_int0("p", "pin", "<gpio>", "Pin number");
-    write_gpio_args.pin_state = arg_int0("d", "data", "<1|0>", "Write data");
-    write_gpio_args.end = arg_end(num_args);
+    top_args.interval = arg_int0("d", "delay", "<ms>", "Sample interval");
+    top_args.count = arg_int0("n", "count", "<count>", "Refresh count, 0 refreshes until job is killed");
+    top_args.end = arg_end(num_args);
 
     const esp_console_cmd_t cmd = {
-        .command = "write_gpio",
-        .help = "Write Data Specified GPIO Pin",
+        .command = "top",
+        .help = "Print CPU Usage of Tasks and Cores, Stack, Heap and lwIP Pool Usage",
         .hint = NULL,
-        .func = &write_gpio,
-        .argtable = &write_gpio_args
+        .func = &top,
+        .argtable = &top_args
     };
     ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
 }
 
-// Command function for 'restart' command:
-static int restart(int argc, char **argv){
-    if(ENABLE_UART){
-        printf("Restarting ESP32!\n");
-        esp_restart();
-    }
-    else if(ENABLE_TCP){
-        strcpy(transmittedBuffer, "Restarting ESP32!");
-        int err = send(sock, transmittedBuffer, strlen(transmittedBuffer), 0);
-        if(err < 0)
-            ESP_LOGE(TAGTCP, "Error occurred during sending!");
-        ESP_LOGI(TAGTCP, "Sending %d bytes with TCP Protocol", strlen(transmittedBuffer));
-        esp_restart();
-    }
-    else{
-        ESP_LOGE(TAGESP32, "No Connection!\n");
-    }
-
+// Command function for 'boot_profile' command:
+static int boot_profile(int argc, char **argv){
+    cliBootProfile();
     return 0;
 }
 
-// Register function for 'restart' command:
-static void register_restart(void){
+// Register function for 'boot_profile' command:
+static void register_boot_profile(void){
     const esp_console_cmd_t cmd = {
-        .command = "restart",
-        .help = "Software reset of the chip",
+        .command = "boot_profile",
+        .help = "Print Start and End Time, Core and Dependencies of Every Boot Stage and Time to First Command",
         .hint = NULL,
-        .func = &restart,
+        .func = &boot_profile,
         .argtable = NULL,
     };
     ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
 }
 
-// Command function for 'help' command:
-static int help(int argc, char **argv){
-    // This help function just for tcp:
-    if(ENABLE_TCP){
-        strcpy(transmittedBuffer, "\n-----------------------\n"
-                                  "All Registered Commands"
-                                  "\n-----------------------\n");
-        strcat(transmittedBuffer, "Command: help\nHints: List All Registered Commands\n"
-                                   "Arguments:\n\tNo\n\n");
-        strcat(transmittedBuffer, "Command: read_gpio\nHints: Prints GPIO Status\n"
-                                  "Arguments:\n\t-a : All Pins Status\n\t-p <gpio> : Specified Pin Status\n\n");
-        strcat(transmittedBuffer, "Command: write_gpio\nHints: Write Desired Data in Specified Pin\n"
-                                   "Arguments:\n\t-p <gpio> -d <1|0> : Pin and Data Values\n\n");
-        strcat(transmittedBuffer, "Command: version\nHints: Print ESP32 Version\n"
-                                   "Arguments:\n\tNo\n\n");
-        strcat(transmittedBuffer, "Command: restart\nHints: Restart ESP32\n"
-                                   "Arguments:\n\tNo\n\n"); 
-        strcat(transmittedBuffer, "Command: close_socket\nHints: Close Socket Connection\n"
-                                   "Arguments:\n\tNo\n\n");                                 
-        int err = send(sock, transmittedBuffer, strlen(transmittedBuffer), 0);
-        if(err < 0)
-            ESP_LOGE(TAGTCP, "Error occurred during sending!");
-        ESP_LOGI(TAGTCP, "Sending %d bytes with TCP Protocol", strlen(transmittedBuffer));
+// Prints a config value, secrets are masked
+static void config_print_value(cliConfigKey_t key, cliJson_t *json){
+    const cliConfigSchema_t *schema = cliConfigSchema(key);
+    if(json != NULL){
+        if(schema->secret)
+            cliJsonBool(json, "secret", true);
+        else if(schema->type == CLI_CONFIG_TYPE_STR)
+            cliJsonString(json, "value", cliConfigGetString(key));
+        else
+            cliJsonUint(json, "value", cliConfigGet(key));
     }
-    else{
-        return 1;
+    else if(schema->secret)
+        cliSessionPrintf("%-20s", "********");
+    else if(schema->type == CLI_CONFIG_TYPE_STR)
+        cliSessionPrintf("%-20s", cliConfigGetString(key));
+    else
+        cliSessionPrintf("%-20u", cliConfigGet(key));
+}
+
+// Prints all config keys
+static void config_list(void){
+    if(cliJsonEnabled()){
+        cliJson_t json;
+        cliJsonBegin(&json, cliSessionGetCurrent());
+        cliJsonArray(&json, "config");
+        for(int key = 0; key < CLI_CONFIG_COUNT; key++){
+            const cliConfigSchema_t *schema = cliConfigSchema(key);
+            cliJsonObject(&json, NULL);
+            cliJsonString(&json, "key", schema->name);
+            config_print_value(key, &json);
+            cliJsonString(&json, "type", schema->type == CLI_CONFIG_TYPE_STR ? "string" : "u32");
+            cliJsonUint(&json, "min", schema->min);
+            cliJsonUint(&json, "max", schema->max);
+            cliJsonString(&json, "apply", cliConfigApplyName(schema->apply));
+            cliJsonBool(&json, "dirty", cliConfigIsDirty(key));
+            cliJsonClose(&json);
+        }
+        cliJsonEnd(&json);
+        return;
+    }
+    cliSessionPrintf("Key          Value                Apply    Description\n");
+    for(int key = 0; key < CLI_CONFIG_COUNT; key++){
+        const cliConfigSchema_t *schema = cliConfigSchema(key);
+        cliSessionPrintf("%-12s ", schema->name);
+        config_print_value(key, NULL);
+        cliSessionPrintf(" %-8s %s%s\n", cliConfigApplyName(schema->apply), schema->help,
+                         cliConfigIsDirty(key) ? " (not committed)" : "");
     }
+}
+
+// Prints why a value is rejected
+static void config_report(cliConfigKey_t key, cliConfigResult_t result){
+    const cliConfigSchema_t *schema = cliConfigSchema(key);
+    if(result == CLI_CONFIG_NOT_NUMBER)
+        cliSessionPrintf("Value of %s must be a number!\n", schema->name);
+    else if(schema->type == CLI_CONFIG_TYPE_STR)
+        cliSessionPrintf("Length of %s must be between %u and %u%s!\n", schema->name, schema->min, schema->max,
+                         key == CLI_CONFIG_WIFI_PASS ? " or empty" : "");
+    else
+        cliSessionPrintf("Value of %s must be between %u and %u!\n", schema->name, schema->min, schema->max);
+}
 
+// Applies a changed value where it is safe at runtime
+static int config_apply(cliConfigKey_t key, const char *value){
+    const cliConfigSchema_t *schema = cliConfigSchema(key);
+    cliSession_t *session = cliSessionGetCurrent();
+    // Serial console switches after the host confirms new rate, otherwise old rate is kept
+    if(key == CLI_CONFIG_UART_BAUD){
+        // Only the serial console can confirm, a rate stored from elsewhere might lock the console out
+        if(session == NULL || session->transport != CLI_SESSION_UART){
+            cliSessionPrintf("%s can only be set from the serial console!\n", schema->name);
+            return 1;
+        }
+        uint32_t rate = strtoul(value, NULL, 0);
+        cliSessionPrintf("Switching to %u baud, press Enter at new rate in %d ms to confirm\n", rate, UART_BAUD_CONFIRM_MS);
+        fflush(stdout);
+        if(cliUartNegotiateBaudRate(rate) != 0){
+            cliSessionPrintf("Baud rate is not confirmed, %s is unchanged!\n", schema->name);
+            return 1;
+        }
+    }
+    cliConfigSet(key, value);
+    if(key == CLI_CONFIG_HISTORY_LEN)
+        linenoiseHistorySetMaxLen(cliConfigGet(key));
+    switch(schema->apply){
+        case CLI_CONFIG_APPLY_NOW:
+            cliSessionPrintf("%s is applied\n", schema->name);
+            break;
+        case CLI_CONFIG_APPLY_SESSION:
+            cliSessionPrintf("%s is applied to new sessions\n", schema->name);
+            break;
+        case CLI_CONFIG_APPLY_CONFIRM:
+            cliSessionPrintf("%s is applied\n", schema->name);
+            break;
+        default:
+            cliSessionPrintf("%s is applied after commit and restart\n", schema->name);
+            break;
+    }
     return 0;
 }
 
-// Register function for 'help' command:
-static void register_help(void){
+// Command function for 'config' command:
+static int config(int argc, char **argv){
+    if(argc == 1 || (argc == 2 && strcmp(argv[1], "list") == 0)){
+        config_list();
+        return 0;
+    }
+    if(argc == 2 && strcmp(argv[1], "commit") == 0){
+        esp_err_t err = cliConfigCommit();
+        if(err != ESP_OK){
+            cliSessionPrintf("Fail during Commit ( %s )!\n", esp_err_to_name(err));
+            return 1;
+        }
+        cliSessionPrintf("Configuration is saved\n");
+        return 0;
+    }
+    bool get = strcmp(argv[1], "get") == 0;
+    bool set = strcmp(argv[1], "set") == 0;
+    bool reset = strcmp(argv[1], "reset") == 0;
+    if(!((get || reset) && argc == 3) && !(set && argc == 4)){
+        cliSessionPrintf("Usage: config [list|commit] | config get|reset <key> | config set <key> <value>\n");
+        return 1;
+    }
+    int key = cliConfigFind(argv[2]);
+    if(key < 0){
+        cliSessionPrintf("Unknown key ( %s )! Type 'config list'\n", argv[2]);
+        return 1;
+    }
+    const cliConfigSchema_t *schema = cliConfigSchema(key);
+    if(get){
+        if(cliJsonEnabled()){
+            cliJson_t json;
+            cliJsonBegin(&json, cliSessionGetCurrent());
+            cliJsonString(&json, "key", schema->name);
+            config_print_value(key, &json);
+            cliJsonBool(&json, "dirty", cliConfigIsDirty(key));
+            cliJsonEnd(&json);
+            return 0;
+        }
+        cliSessionPrintf("%s = ", schema->name);
+        config_print_value(key, NULL);
+        cliSessionPrintf("\n%s, range %u-%u%s, applied %s\n", schema->help, schema->min, schema->max,
+                         schema->type == CLI_CONFIG_TYPE_STR ? " chars" : "", cliConfigApplyName(schema->apply));
+        return 0;
+    }
+    if(reset){
+        cliConfigReset(key);
+        if(key == CLI_CONFIG_HISTORY_LEN)
+            linenoiseHistorySetMaxLen(cliConfigGet(key));
+        cliSessionPrintf("%s is reset to default, commit to erase stored value\n", schema->name);
+        return 0;
+    }
+    cliConfigResult_t result = cliConfigCheck(key, argv[3]);
+    if(result != CLI_CONFIG_OK){
+        config_report(key, result);
+        return 1;
+    }
+    return config_apply(key, argv[3]);
+}
+
+// Register function for 'config' command:
+static void register_config(void){
     const esp_console_cmd_t cmd = {
-        .command = "help",
-        .help = "List All Registered Commands",
+        .command = "config",
+        .help = "List, Get, Set, Reset or Commit Runtime Configuration. Usage: config set <key> <value>",
         .hint = NULL,
-        .func = &help,
+        .func = &config,
         .argtable = NULL,
     };
     ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
 }
 
-// Command function for 'close_socket' command
-static int close_socket(int argc, char **argv){
-    // This command just for tcp
-    if(ENABLE_TCP){
-        // Shutdown socket
-        shutdown(sock, 0);
-        close(sock);
+// Prints recorder status
+static void record_status(void){
+    cliRecordStatus_t status;
+    cliRecordGetStatus(&status);
+    if(cliJsonEnabled()){
+        cliJson_t json;
+        cliJsonBegin(&json, cliSessionGetCurrent());
+        cliJsonString(&json, "state", cliRecordStateName(status.state));
+        cliJsonUint(&json, "size", status.size);
+        cliJsonUint(&json, "used", status.used);
+        cliJsonUint(&json, "lines", status.lines);
+        cliJsonUint(&json, "dropped", status.dropped);
+        cliJsonEnd(&json);
+        return;
+    }
+    cliSessionPrintf("Recorder: %s, %u of %u bytes, %u lines, %u dropped\n", cliRecordStateName(status.state),
+                     (unsigned)status.used, (unsigned)status.size, status.lines, status.dropped);
+}
+
+// Command function for 'record' command, arguments are parsed by hand because of subcommands
+static int record(int argc, char **argv){
+    if(argc == 1){
+        record_status();
+        return 0;
+    }
+    if(strcmp(argv[1], "start") == 0 && argc <= 3){
+        size_t kb = argc == 3 ? strtoul(argv[2], NULL, 10) : CLI_RECORD_DEFAULT_KB;
+        esp_err_t err = cliRecordStart(kb);
+        if(err == ESP_ERR_INVALID_ARG){
+            cliSessionPrintf("Log size must be between 1 and %d KB!\n", CLI_RECORD_MAX_KB);
+            return 1;
+        }
+        if(err != ESP_OK){
+            cliSessionPrintf("Unable to allocate %u KB log!\n", (unsigned)kb);
+            return 1;
+        }
+    }
+    else if(strcmp(argv[1], "stop") == 0 && argc == 2)
+        cliRecordStop();
+    else if(strcmp(argv[1], "clear") == 0 && argc == 2)
+        cliRecordClear();
+    else if(strcmp(argv[1], "dump") == 0 && argc == 2){
+        // Log is binary like capture stream
+        if(!cliSessionIsBinary(cliSessionGetCurrent())){
+            cliSessionPrintf("Dump needs a TCP or framed session in text format!\n");
+            return 1;
+        }
+        cliRecordDump();
+        return 0;
     }
     else{
+        cliSessionPrintf("Usage: record [start [kb]|stop|clear|dump]\n");
         return 1;
     }
-
+    record_status();
     return 0;
 }
 
-// Register function for 'close_socket' command
-static void register_close_socket(void){
+// Register function for 'record' command:
+static void register_record(void){
     const esp_console_cmd_t cmd = {
-        .command = "close_socket",
-        .help = "Close Socket Connection",
+        .command = "record",
+        .help = "Record Lines, Responses and Execution Times of All Sessions. Usage: record [start [kb]|stop|clear|dump]",
         .hint = NULL,
-        .func = &close_socket,
+        .func = &record,
         .argtable = NULL,
     };
     ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
 }
 
-// Command validity control function both TCP and UART protocol  
+// Command validity control function both TCP and UART protocol
 void cliCommandControl(esp_err_t err, int ret){
-    if(ENABLE_UART){
-        if(err == ESP_ERR_NOT_FOUND){
-            ESP_LOGE(TAGESP32, "Unrecognized command\n");
-        } 
-        else if(err == ESP_ERR_INVALID_ARG){
-            // command was empty
-        } 
-        else if(err == ESP_OK && ret != ESP_OK){
-            ESP_LOGE(TAGESP32, "Command returned non-zero error code: 0x%x (%s)\n", ret, esp_err_to_name(ret));
-        } 
-        else if(err != ESP_OK){
-            ESP_LOGE(TAGESP32, "Internal error: %s\n", esp_err_to_name(err));
-        }
+    cliSession_t *session = cliSessionGetCurrent();
+    // JSON sessions get structured error codes
+    if(session != NULL && session->format == CLI_SESSION_FORMAT_JSON){
+        cliJsonFinishResponse(session, err, ret);
+        return;
     }
-    else if(ENABLE_TCP){
-        if(err == ESP_ERR_NOT_FOUND){
-            strcpy(transmittedBuffer, "Unrecognized command\n");
-            int err2 = send(sock, transmittedBuffer, strlen(transmittedBuffer), 0);
-            if(err2 < 0)
-                ESP_LOGE(TAGTCP, "Error occurred during sending!");
-            ESP_LOGI(TAGTCP, "Sending %d bytes with TCP Protocol", strlen(transmittedBuffer));
-        } 
-        else if(err == ESP_ERR_INVALID_ARG){
-            // command was empty
-        } 
-        else if(err == ESP_OK && ret != ESP_OK){
-            sprintf(transmittedBuffer, "Command returned non-zero error code: 0x%x (%s)\n", ret, esp_err_to_name(ret));
-            int err2 = send(sock, transmittedBuffer, strlen(transmittedBuffer), 0);
-            if(err2 < 0)
-                ESP_LOGE(TAGTCP, "Error occurred during sending!");
-            ESP_LOGI(TAGTCP, "Sending %d bytes with TCP Protocol", strlen(transmittedBuffer));
-        } 
-        else if(err != ESP_OK){
-            sprintf(transmittedBuffer, "Internal error: %s\n", esp_err_to_name(err));
-            int err2 = send(sock, transmittedBuffer, strlen(transmittedBuffer), 0);
-            if(err2 < 0)
-                ESP_LOGE(TAGTCP, "Error occurred during sending!");
-            ESP_LOGI(TAGTCP, "Sending %d bytes with TCP Protocol", strlen(transmittedBuffer));
-        }
+    if(err == ESP_ERR_NOT_FOUND){
+        cliSessionPrintf("Unrecognized command\n");
     }
-    else{
-        ESP_LOGE(TAGESP32, "Connection Error!\n");
+    else if(err == ESP_ERR_INVALID_ARG){
+        // command was empty
+    }
+    else if(err == ESP_OK && ret != ESP_OK){
+        cliSessionPrintf("Command returned non-zero error code: 0x%x (%s)\n", ret, esp_err_to_name(ret));
+    }
+    else if(err != ESP_OK){
+        cliSessionPrintf("Internal error: %s\n", esp_err_to_name(err));
     }
-}
-
-// TCP init function for wifi connection
-void cliTCPInit(void){
-    cliSocketWifiInit();
 }
 
 // Read command function for both UART and TCP protocol
 char *cliReadCommand(const char *prompt){
     if(ENABLE_UART){
         // Get a line using linenoise. The line is returned when ENTER is pressed.
+        s_prompt = prompt;
+        s_editing = true;
         char* line = linenoise(prompt);
+        s_editing = false;
         if (line == NULL) { // Break on EOF or error
             return NULL;
         }
@@ -490,19 +2011,8 @@ char *cliReadCommand(const char *prompt){
        return line;
     }
     else if(ENABLE_TCP){
-        int len = recv(sock, receivedBuffer, sizeof(receivedBuffer), 0);
-        if (len < 0) {
-            ESP_LOGE(TAGTCP, "Error occurred during receiving: errno %d", errno);
-            sock = -1;
-        } 
-        else if (len == 0) {
-            ESP_LOGE(TAGTCP, "Connection closed");
-        } 
-        else {
-            receivedBuffer[len] = 0; // Null-terminate whatever is received and treat it like a string
-            ESP_LOGI(TAGESP32, "Received %d bytes: %s", len, receivedBuffer);
-        }
-
+        // Lines of all clients are received into their sessions, they are run by cliParseCommand()
+        cliSocketPoll();
         return NULL;
     }
     else{
@@ -511,22 +2021,138 @@ char *cliReadCommand(const char *prompt){
     }
 }
 
+// Starts output which is not a response of a running line, e.g. a push of 'every'. Serial console may be in
+// line editing meanwhile, so its prompt line is erased first. Returns true if cliConsoleAsyncEnd() must draw it
+bool cliConsoleAsyncBegin(cliSession_t *session){
+    if(session == NULL || session->transport != CLI_SESSION_UART || session->format != CLI_SESSION_FORMAT_TEXT || !s_editing)
+        return false;
+    // Dumb terminals do not know escape sequences, output starts on a new line there
+    printf(linenoiseIsDumbMode() ? "\n" : "\r\x1b[K");
+    return true;
+}
+
+// Ends output which is started by cliConsoleAsyncBegin(), linenoise redraws typed text with next key
+void cliConsoleAsyncEnd(bool erased){
+    if(!erased)
+        return;
+    printf("%s", s_prompt);
+    fflush(stdout);
+}
+
+// Runs one command line with output to given session
+esp_err_t cliRunCommand(cliSession_t *session, const char *line, int *ret){
+    xSemaphoreTakeRecursive(s_command_lock, portMAX_DELAY);
+    s_command_depth++;
+    cliSession_t *previous = cliSessionGetCurrent();
+    uint32_t previousId = previous != NULL ? previous->id : 0;
+    cliSessionSetCurrent(session);
+    // Text output of command is wrapped until it writes a structured response
+    if(session != NULL && session->format == CLI_SESSION_FORMAT_JSON)
+        session->jsonState = CLI_SESSION_JSON_PENDING;
+    esp_err_t err = esp_console_run(line, ret);
+    // Command may close its own session, e.g. 'close_socket', task must not be bound to it again
+    cliSessionSetCurrent(previous != NULL && previous->used && previous->id == previousId ? previous : NULL);
+    s_command_depth--;
+    xSemaphoreGiveRecursive(s_command_lock);
+    return err;
+}
+
+// Releases every level of command lock while a running command blocks, so other tasks can run commands
+// meanwhile. Returns the levels which cliCommandLock() must take back
+int cliCommandUnlock(void){
+    int depth = s_command_depth;
+    s_command_depth = 0;
+    for(int i = 0; i < depth; i++)
+        xSemaphoreGiveRecursive(s_command_lock);
+    return depth;
+}
+
+// Takes levels of command lock, e.g. back after cliCommandUnlock()
+void cliCommandLock(int depth){
+    for(int i = 0; i < depth; i++)
+        xSemaphoreTakeRecursive(s_command_lock, portMAX_DELAY);
+    s_command_depth += depth;
+}
+
+// Answers a line which is over the rate limit of current session, the line is dropped
+void cliCommandRateLimited(int retryMs){
+    cliSession_t *session = cliSessionGetCurrent();
+    if(session != NULL && session->format == CLI_SESSION_FORMAT_JSON){
+        cliJson_t json;
+        cliJsonBegin(&json, session);
+        cliJsonObject(&json, "error");
+        cliJsonInt(&json, "code", CLI_ERROR_RATE_LIMITED);
+        cliJsonString(&json, "name", cliErrorName(CLI_ERROR_RATE_LIMITED));
+        cliJsonInt(&json, "retry_ms", retryMs);
+        cliJsonClose(&json);
+        cliJsonEnd(&json);
+    }
+    else
+        cliSessionPrintf("Rate limited, retry in %d ms\n", retryMs);
+}
+
+// Runs a received line, it is started as a background job if it ends with '&'
+esp_err_t cliExecuteLine(char *line){
+    cliSession_t *session = cliSessionGetCurrent();
+    uint32_t id = session != NULL ? session->id : 0;
+    uint32_t timeout;
+    esp_err_t err = ESP_OK;
+    int ret = 0;
+    cliBootMarkFirstCommand();
+    cliSessionBeginResponse(session);
+    // Recorded line is taken before a background marker is stripped from it
+    bool recording = cliRecordBegin(session, line);
+    int retryMs = cliSessionRateCheck(session);
+    if(retryMs > 0){
+        cliCommandRateLimited(retryMs);
+        err = ESP_ERR_INVALID_STATE;
+    }
+    else if(session != NULL && cliJobIsBackground(line, &timeout)){
+        int jobId = cliJobStart(session, line, timeout);
+        if(session->format == CLI_SESSION_FORMAT_JSON){
+            cliJson_t json;
+            cliJsonBegin(&json, session);
+            if(jobId < 0){
+                cliJsonObject(&json, "error");
+                cliJsonInt(&json, "code", CLI_ERROR_NO_RESOURCE);
+                cliJsonString(&json, "name", cliErrorName(CLI_ERROR_NO_RESOURCE));
+                cliJsonClose(&json);
+            }
+            else
+                cliJsonInt(&json, "job", jobId);
+            cliJsonEnd(&json);
+        }
+        else if(jobId < 0)
+            cliSessionPrintf("No free job slot!\n");
+        else
+            cliSessionPrintf("[job %d] started\n", jobId);
+    }
+    else{
+        err = cliRunCommand(session, line, &ret);
+        // Session is gone if the command closed it
+        if(session != NULL && (!session->used || session->id != id))
+            session = NULL;
+        else
+            cliCommandControl(err, ret);
+    }
+    // Execution time ends here, flush time belongs to the transport
+    if(recording)
+        cliRecordEnd(err, ret);
+    // Flush response according to session policy
+    cliSessionEndResponse(session);
+    return err;
+}
+
 // Parse command function for both UART and TCP protocol
 void cliParseCommand(char *line){
     if(ENABLE_UART){
-        int ret;
-        esp_err_t err = esp_console_run(line, &ret);
-        cliCommandControl(err, ret);
+        cliExecuteLine(line);
         // Linenoise allocates line buffer on the heap, so need to free it 
         linenoiseFree(line);
     }
     else if(ENABLE_TCP){
-        //ESP_LOGI(TAGESP32, "receivedBuffer data before parsing: %s", receivedBuffer);
-        int ret;
-        esp_err_t err = esp_console_run(receivedBuffer, &ret);
-        cliCommandControl(err, ret);
-        if(err == ESP_OK)
-            ESP_LOGI(TAGTCP, "Command Successfully Received and Processed\n");
+        // Complete lines of clients are run in deficit round robin order
+        cliSocketSchedule();
     }
     else{
         ESP_LOGE(TAGESP32, "Connection Error!\n");
@@ -583,10 +2209,28 @@ void cliInitializeNVS(void){
         err = nvs_flash_init();
     }
     ESP_ERROR_CHECK(err);
+    // Runtime configuration is loaded before any module uses it
+    cliConfigInit();
+}
+
+// Core init function, sessions and command lock are used by every task which runs commands
+void cliCoreInit(void){
+    cliSessionInit();
+    s_command_lock = xSemaphoreCreateRecursiveMutex();
 }
 
-// Console init function, also it calls uartConfig() function
+// Console init function, commands can be registered after it
 void cliConsoleInit(void){
+    esp_console_config_t console_config = {
+        .max_cmdline_args = 8,
+        .max_cmdline_length = CLI_CMDLINE_LENGTH,
+        .hint_color = atoi(LOG_COLOR_CYAN)
+    };
+    esp_console_init(&console_config);
+}
+
+// Serial console init function, it configures UART and line editing
+void cliUartConsoleInit(void){
     // Drain stdout before reconfiguring it
     fflush(stdout);
     fsync(fileno(stdout));
@@ -600,13 +2244,6 @@ void cliConsoleInit(void){
     cliUartConfig();
 
     esp_vfs_dev_uart_use_driver(UART_PORT);
-    
-    esp_console_config_t console_config = {
-        .max_cmdline_args = 8,
-        .max_cmdline_length = 256,
-        .hint_color = atoi(LOG_COLOR_CYAN)
-    };
-    esp_console_init(&console_config);
 
     /* Configure linenoise line completion library */
     /* Enable multiline editing. If not set, long commands will scroll within
@@ -619,10 +2256,10 @@ void cliConsoleInit(void){
     linenoiseSetHintsCallback((linenoiseHintsCallback*) &esp_console_get_hint);
 
     /* Set command history size */
-    linenoiseHistorySetMaxLen(100);
+    linenoiseHistorySetMaxLen(cliConfigGet(CLI_CONFIG_HISTORY_LEN));
 
     /* Set command maximum length */
-    linenoiseSetMaxLineLen(console_config.max_cmdline_length);
+    linenoiseSetMaxLineLen(CLI_CMDLINE_LENGTH);
 
     /* Don't return empty lines */
     linenoiseAllowEmpty(false);
@@ -632,13 +2269,3 @@ void cliConsoleInit(void){
     linenoiseHistoryLoad(HISTORY_PATH);
 #endif
 }
-
-
-
-
-
-
-
-
-
-
@@ -6,18 +6,18 @@
 #ifndef _CLI_H_
 #define _CLI_H_
 
+#include "CLISession.h"
+
 // If you want to change protocol just change below macros as 1 or 0
 // WARNING: These macros should not be "1" at the same time
 #define ENABLE_UART (0)
 #define ENABLE_TCP  (1)
+// UDP datagram commands, it needs Wi-Fi so it works together with TCP
+#define ENABLE_UDP  (1)
 
 // Port macro
 #define PORT (3333)
 
-// TCP tranmitter and receiver buffer size macros
-#define TCP_TRANSMITTED_BUFFER_SIZE (1024)
-#define TCP_RECEIVED_BUFFER_SIZE  (1024)
-
 // GPIO status macros
 #define GPIO_PIN_HIGH (1)
 #define GPIO_PIN_LOW  (0)
@@ -26,24 +26,29 @@
 #define PROMPT_STR CONFIG_IDF_TARGET
 #define MOUNT_PATH "/data"
 #define HISTORY_PATH MOUNT_PATH "/history.txt"
-
-// TCP tranmitter and receiver buffers
-char transmittedBuffer[TCP_TRANSMITTED_BUFFER_SIZE];
-char receivedBuffer[TCP_RECEIVED_BUFFER_SIZE];
-
-// This value (sock) is using for multiple source file so I defined it by extern keyword in other source files.
-int sock; 
+// Default command history length
+#define CLI_HISTORY_LEN (100)
+// Maximum command line length of console and line editing
+#define CLI_CMDLINE_LENGTH (256)
 
 void cliRegisterCommands(void);
+void cliCoreInit(void);
 void cliConsoleInit(void);
+void cliUartConsoleInit(void);
 void cliCommandControl(esp_err_t, int);
+void cliCommandRateLimited(int);
 void cliInitializeNVS(void);
 void cliAddCommandHistory(const char*);
-void cliTCPInit(void);
 void cliStartTCPScreen(void);
 void cliStartUARTScreen(void);
 char *cliControlConsole(void);
 char *cliReadCommand(const char*);
 void cliParseCommand(char*);
+esp_err_t cliExecuteLine(char*);
+esp_err_t cliRunCommand(cliSession_t*, const char*, int*);
+int cliCommandUnlock(void);
+void cliCommandLock(int);
+bool cliConsoleAsyncBegin(cliSession_t*);
+void cliConsoleAsyncEnd(bool);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,272 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLIAdc.c
+*/
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "CLI.h"
+#include "CLISession.h"
+#include "CLIAdc.h"
+
+// TAG for ADC log functions
+static const char *TAGADC = "ADC";
+
+// Queue item which tells that reader task is finished
+#define CLI_ADC_END (0xFF)
+
+// Block which is filled by reader task and written to session by command task
+typedef struct{
+    uint32_t sequence;
+    uint32_t first;
+    uint32_t dropped;
+    uint16_t records;
+    int64_t opened;
+    uint8_t payload[CLI_ADC_BLOCK_SIZE];
+}cliAdcBlock_t;
+
+static cliAdcBlock_t s_blocks[CLI_ADC_BLOCKS];
+// Indexes of empty and filled blocks, blocks are never shared
+static QueueHandle_t s_free;
+static QueueHandle_t s_full;
+// Stream state, it is written by reader task until it sends CLI_ADC_END
+static cliAdcConfig_t s_config;
+static const cliAdcSource_t *s_source;
+static uint8_t s_channels;
+static size_t s_record_size;
+static uint32_t s_records;
+static uint32_t s_dropped;
+static cliAdcStatus_t s_status;
+static volatile bool s_stop;
+// Source and blocks are used by one stream at a time
+static bool s_busy;
+// Raw conversions of one read
+static cliAdcRaw_t s_raw[CLI_ADC_READ_SAMPLES];
+// Reduction of current record
+static struct{
+    uint32_t sum;
+    uint16_t min;
+    uint16_t max;
+    uint16_t count;
+}s_acc[CLI_ADC_MAX_CHANNELS];
+static uint8_t s_complete;
+
+// Writes little endian integer
+static void cliAdcPut(uint8_t *out, uint64_t value, size_t len){
+    for(size_t i = 0; i < len; i++)
+        out[i] = (value >> (8 * i)) & 0xFF;
+}
+
+// Starts a new record
+static void cliAdcResetRecord(void){
+    for(uint8_t i = 0; i < s_channels; i++){
+        s_acc[i].sum = 0;
+        s_acc[i].min = UINT16_MAX;
+        s_acc[i].max = 0;
+        s_acc[i].count = 0;
+    }
+    s_complete = 0;
+}
+
+// Hands a block over to command task
+static void cliAdcSendBlock(uint8_t *current){
+    xQueueSend(s_full, current, portMAX_DELAY);
+    *current = CLI_ADC_END;
+}
+
+// Appends reduced record to current block, the record is dropped if session holds all blocks
+static void cliAdcEmit(uint8_t *current, uint32_t *sequence){
+    if(*current == CLI_ADC_END){
+        if(xQueueReceive(s_free, current, 0) != pdTRUE){
+            s_dropped++;
+            return;
+        }
+        cliAdcBlock_t *block = &s_blocks[*current];
+        block->sequence = (*sequence)++;
+        block->first = s_records + s_dropped;
+        block->dropped = s_dropped;
+        block->records = 0;
+        block->opened = esp_timer_get_time();
+    }
+    cliAdcBlock_t *block = &s_blocks[*current];
+    uint8_t *out = block->payload + block->records * s_record_size;
+    for(uint8_t i = 0; i < s_channels; i++){
+        // Mean keeps 4 fraction bits, 12 bit conversions still fit 16 bits
+        if(s_config.fields & CLI_ADC_FIELD_MEAN){
+            cliAdcPut(out, (s_acc[i].sum * 16 + s_acc[i].count / 2) / s_acc[i].count, 2);
+            out += 2;
+        }
+        if(s_config.fields & CLI_ADC_FIELD_MIN){
+            cliAdcPut(out, s_acc[i].min, 2);
+            out += 2;
+        }
+        if(s_config.fields & CLI_ADC_FIELD_MAX){
+            cliAdcPut(out, s_acc[i].max, 2);
+            out += 2;
+        }
+    }
+    block->records++;
+    s_records++;
+    if((block->records + 1) * s_record_size > sizeof(block->payload))
+        cliAdcSendBlock(current);
+}
+
+// Reader task, it reduces conversions into records until limit or stop request
+static void cliAdcReaderTask(void *arg){
+    uint8_t current = CLI_ADC_END;
+    uint32_t sequence = 0;
+    bool overflow = false;
+    cliAdcStatus_t status = CLI_ADC_STATUS_OK;
+    cliAdcResetRecord();
+    while(!s_stop && s_records + s_dropped < s_config.records){
+        int count = s_source->read(s_raw, CLI_ADC_READ_SAMPLES, CLI_ADC_POLL_MS, &overflow);
+        if(count < 0){
+            ESP_LOGE(TAGADC, "Read fail from %s source!", s_source->name);
+            status = CLI_ADC_STATUS_ERROR;
+            break;
+        }
+        for(int i = 0; i < count && s_records + s_dropped < s_config.records; i++){
+            const cliAdcRaw_t *raw = &s_raw[i];
+            // A channel which has its conversions already waits for the others
+            if(raw->index >= s_channels || s_acc[raw->index].count >= s_config.decimation)
+                continue;
+            s_acc[raw->index].sum += raw->value;
+            if(raw->value < s_acc[raw->index].min)
+                s_acc[raw->index].min = raw->value;
+            if(raw->value > s_acc[raw->index].max)
+                s_acc[raw->index].max = raw->value;
+            if(++s_acc[raw->index].count == s_config.decimation && ++s_complete == s_channels){
+                cliAdcEmit(&current, &sequence);
+                cliAdcResetRecord();
+            }
+        }
+        // Slow streams send partial blocks
+        if(current != CLI_ADC_END && esp_timer_get_time() - s_blocks[current].opened >= CLI_ADC_BLOCK_MAX_MS * 1000)
+            cliAdcSendBlock(&current);
+    }
+    if(current != CLI_ADC_END)
+        cliAdcSendBlock(&current);
+    if(overflow && status == CLI_ADC_STATUS_OK)
+        status = CLI_ADC_STATUS_OVERRUN;
+    s_status = status;
+    uint8_t end = CLI_ADC_END;
+    xQueueSend(s_full, &end, portMAX_DELAY);
+    vTaskDelete(NULL);
+}
+
+// Writes End block
+static void cliAdcWriteEnd(cliAdcStatus_t status){
+    uint8_t end[11] = { 'A', 'E' };
+    cliAdcPut(end + 2, s_records, 4);
+    cliAdcPut(end + 6, s_dropped, 4);
+    end[10] = status;
+    cliSessionWrite((const char *)end, sizeof(end));
+}
+
+// Starts source and streams blocks to current session while reader task fills next ones
+cliAdcStatus_t cliAdcStream(const cliAdcConfig_t *config){
+    if(s_busy)
+        return CLI_ADC_STATUS_BUSY;
+    s_busy = true;
+    s_config = *config;
+    s_source = cliAdcGetSource(config->source);
+
+    // Channels are in GPIO order
+    uint8_t pins[CLI_ADC_MAX_CHANNELS];
+    s_channels = 0;
+    for(uint8_t pin = 0; pin < 64 && s_channels < CLI_ADC_MAX_CHANNELS; pin++){
+        if(config->mask & (1ULL << pin))
+            pins[s_channels++] = pin;
+    }
+    s_record_size = (size_t)s_channels * __builtin_popcount(config->fields) * 2;
+    s_records = 0;
+    s_dropped = 0;
+    s_stop = false;
+
+    // Queues hold every block and end item, so reader never blocks on them
+    if(s_free == NULL){
+        s_free = xQueueCreate(CLI_ADC_BLOCKS, sizeof(uint8_t));
+        s_full = xQueueCreate(CLI_ADC_BLOCKS + 1, sizeof(uint8_t));
+    }
+    xQueueReset(s_free);
+    xQueueReset(s_full);
+    for(uint8_t i = 0; i < CLI_ADC_BLOCKS; i++)
+        xQueueSend(s_free, &i, 0);
+
+    // Nothing is written if source can not start, so command can answer with text
+    if(s_source->start(pins, s_channels, config->rate) != ESP_OK){
+        s_busy = false;
+        return CLI_ADC_STATUS_NO_SOURCE;
+    }
+
+    // Header block
+    uint8_t header[23] = { 'A', 'H', CLI_ADC_VERSION };
+    cliAdcPut(header + 3, config->mask, 8);
+    cliAdcPut(header + 11, config->rate, 4);
+    cliAdcPut(header + 15, config->decimation, 2);
+    header[17] = config->fields;
+    header[18] = s_channels;
+    cliAdcPut(header + 19, config->records, 4);
+    cliSessionWrite((const char *)header, sizeof(header));
+
+    if(xTaskCreate(cliAdcReaderTask, "adc_reader", CLI_ADC_TASK_STACK, NULL, CLI_ADC_TASK_PRIORITY, NULL) != pdPASS){
+        ESP_LOGE(TAGADC, "Reader task can not be created!");
+        s_source->stop();
+        cliAdcWriteEnd(CLI_ADC_STATUS_ERROR);
+        s_busy = false;
+        return CLI_ADC_STATUS_ERROR;
+    }
+
+    // Blocks are written in fill order, a slow session leaves reader without free blocks
+    cliSession_t *session = cliSessionGetCurrent();
+    uint32_t txErrors = session->stats.txErrors;
+    cliAdcStatus_t status = CLI_ADC_STATUS_OK;
+    while(1){
+        uint8_t index;
+        // Other tasks may run commands while stream waits for blocks
+        int depth = cliCommandUnlock();
+        BaseType_t received = xQueueReceive(s_full, &index, pdMS_TO_TICKS(CLI_ADC_POLL_MS));
+        cliCommandLock(depth);
+        if(received == pdTRUE){
+            if(index == CLI_ADC_END)
+                break;
+            cliAdcBlock_t *block = &s_blocks[index];
+            uint8_t head[16] = { 'A', 'B' };
+            cliAdcPut(head + 2, block->sequence, 4);
+            cliAdcPut(head + 6, block->first, 4);
+            cliAdcPut(head + 10, block->dropped, 4);
+            cliAdcPut(head + 14, block->records, 2);
+            cliSessionWrite((const char *)head, sizeof(head));
+            cliSessionWrite((const char *)block->payload, block->records * s_record_size);
+            xQueueSend(s_free, &index, 0);
+            // Peer is gone, there is no reason to convert more
+            if(session->stats.txErrors != txErrors && !s_stop){
+                status = CLI_ADC_STATUS_ERROR;
+                s_stop = true;
+            }
+        }
+        // Any input of the client stops the stream
+        if(!s_stop && cliSessionHasInput(session)){
+            status = CLI_ADC_STATUS_ABORTED;
+            s_stop = true;
+        }
+    }
+
+    s_source->stop();
+    if(status == CLI_ADC_STATUS_OK)
+        status = s_status;
+    cliAdcWriteEnd(status);
+    s_busy = false;
+    return status;
+}
+
+// Returns true while a stream runs
+bool cliAdcIsBusy(void){
+    return s_busy;
+}
@@ -0,0 +1,102 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLIAdc.h
+*/
+#ifndef _CLIADC_H_
+#define _CLIADC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+// Maximum number of channels of a stream, ESP32 continuous mode only converts ADC1 which has 8 channels
+#define CLI_ADC_MAX_CHANNELS (8)
+// Largest decimation factor, sums of a channel must fit 32 bits
+#define CLI_ADC_MAX_DECIMATION (4096)
+// Payload size of a block and number of blocks between reader task and session
+#define CLI_ADC_BLOCK_SIZE (1024)
+#define CLI_ADC_BLOCKS (8)
+// A partial block is sent after this time, so slow streams keep a low latency
+#define CLI_ADC_BLOCK_MAX_MS (100)
+// Raw samples which are taken from the source at once
+#define CLI_ADC_READ_SAMPLES (256)
+// Conversions which are kept by the source between reads, it is 20 ms of two channels at 100 kHz
+#define CLI_ADC_POOL_SAMPLES (4096)
+// Longest time a read or a queue wait blocks, client input which stops the stream is checked after it
+#define CLI_ADC_POLL_MS (100)
+// Reader task settings, it runs above the console so DMA pool is drained while session sends
+#define CLI_ADC_TASK_STACK (3072)
+#define CLI_ADC_TASK_PRIORITY (configMAX_PRIORITIES - 1)
+// Stream format version which is written in header block
+#define CLI_ADC_VERSION (1)
+
+/* adc_stream is binary, all fields are little endian:
+ *   Header : 'A' 'H' | version (1) | pin mask (8) | rate Hz per channel (4) | decimation (2) | fields (1)
+ *            | channels (1) | record limit (4)
+ *   Block  : 'A' 'B' | sequence (4) | first record (4) | dropped records (4) | record count (2) | payload
+ *            a record is one value (2) for every field of every channel, channels in GPIO order,
+ *            fields in order mean, min, max. Mean is in 1/16 LSB, so oversampling adds resolution.
+ *   End    : 'A' 'E' | records (4) | dropped records (4) | status (1)
+ * Blocks are dropped as a whole when session can not keep up, records which are skipped are counted
+ * in 'dropped' and 'first record' of next block shows the gap. Any input of the client stops the
+ * stream with status aborted, the input is run as next command. */
+
+// Reduced values of a record
+#define CLI_ADC_FIELD_MEAN (1 << 0)
+#define CLI_ADC_FIELD_MIN  (1 << 1)
+#define CLI_ADC_FIELD_MAX  (1 << 2)
+
+// Status of End block
+typedef enum{
+    CLI_ADC_STATUS_OK = 0,
+    CLI_ADC_STATUS_OVERRUN,             // Source lost conversions, e.g. DMA pool overflowed
+    CLI_ADC_STATUS_ERROR,
+    CLI_ADC_STATUS_ABORTED,
+    // Returned by cliAdcStream when nothing is streamed
+    CLI_ADC_STATUS_BUSY,
+    CLI_ADC_STATUS_NO_SOURCE            // Source can not start with these pins and rate
+}cliAdcStatus_t;
+
+// Sources of conversions
+typedef enum{
+    CLI_ADC_SOURCE_HARDWARE = 0,        // ADC1 continuous (DMA) mode
+    CLI_ADC_SOURCE_SYNTHETIC,           // Generated waveforms, for host builds and throughput tests
+    CLI_ADC_SOURCE_COUNT
+}cliAdcSourceType_t;
+
+// Raw conversion, index is position of the pin in stream channel list
+typedef struct{
+    uint8_t index;
+    uint16_t value;
+}cliAdcRaw_t;
+
+/* Source interface, a source converts a list of pins at 'rate' conversions per second for every pin.
+ * read() blocks at most given time and returns number of conversions, or -1 on error. It sets
+ * 'overflow' when conversions are lost before they are read. */
+typedef struct{
+    const char *name;
+    uint32_t minRate;                   // Total conversion rate range of all channels
+    uint32_t maxRate;
+    esp_err_t (*start)(const uint8_t*, uint8_t, uint32_t);
+    int (*read)(cliAdcRaw_t*, int, uint32_t, bool*);
+    void (*stop)(void);
+}cliAdcSource_t;
+
+// Stream configuration
+typedef struct{
+    uint64_t mask;
+    uint32_t rate;
+    uint16_t decimation;
+    uint8_t fields;
+    uint32_t records;
+    cliAdcSourceType_t source;
+}cliAdcConfig_t;
+
+const cliAdcSource_t *cliAdcGetSource(cliAdcSourceType_t);
+cliAdcSourceType_t cliAdcFindSource(const char*);
+cliAdcStatus_t cliAdcStream(const cliAdcConfig_t*);
+bool cliAdcIsBusy(void);
+
+#endif
@@ -0,0 +1,217 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLIAdcSource.c
+*/
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "CLIAdc.h"
+
+// Hardware source needs continuous mode driver of ESP-IDF
+#if defined(ESP_PLATFORM) && !CONFIG_IDF_TARGET_LINUX
+#include "driver/adc.h"
+#define CLI_ADC_HARDWARE (1)
+#else
+#define CLI_ADC_HARDWARE (0)
+#endif
+
+// Conversions of one channel in a period of synthetic triangle wave, channel n has n + 1 times of it
+#define CLI_ADC_SYNTH_PERIOD (1000)
+// Highest value of 12 bit conversion
+#define CLI_ADC_FULL_SCALE (4095)
+
+#if CLI_ADC_HARDWARE
+// TAG for ADC log functions
+static const char *TAGADC = "ADC";
+
+// ADC1 channel of GPIOs, -1 for pins without ADC1
+static int8_t cliAdcChannelOf(uint8_t pin){
+    switch(pin){
+        case 36: return ADC1_CHANNEL_0;
+        case 37: return ADC1_CHANNEL_1;
+        case 38: return ADC1_CHANNEL_2;
+        case 39: return ADC1_CHANNEL_3;
+        case 32: return ADC1_CHANNEL_4;
+        case 33: return ADC1_CHANNEL_5;
+        case 34: return ADC1_CHANNEL_6;
+        case 35: return ADC1_CHANNEL_7;
+        default: return -1;
+    }
+}
+
+// Stream index of ADC1 channels
+static int8_t s_index_of[CLI_ADC_MAX_CHANNELS];
+// DMA result bytes of one read
+static uint8_t s_dma[CLI_ADC_READ_SAMPLES * ADC_DIGI_RESULT_BYTES];
+
+// Starts ADC1 continuous mode, pattern table converts every channel once per round
+static esp_err_t cliAdcHardwareStart(const uint8_t *pins, uint8_t count, uint32_t rate){
+    adc_digi_pattern_config_t pattern[CLI_ADC_MAX_CHANNELS] = {0};
+    uint32_t channelMask = 0;
+    memset(s_index_of, -1, sizeof(s_index_of));
+    for(uint8_t i = 0; i < count; i++){
+        int8_t channel = cliAdcChannelOf(pins[i]);
+        if(channel < 0)
+            return ESP_ERR_NOT_SUPPORTED;
+        s_index_of[channel] = i;
+        channelMask |= 1 << channel;
+        pattern[i].atten = ADC_ATTEN_DB_11;
+        pattern[i].channel = channel;
+        pattern[i].unit = 0;
+        pattern[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+    }
+    adc_digi_init_config_t init = {
+        .max_store_buf_size = CLI_ADC_POOL_SAMPLES * ADC_DIGI_RESULT_BYTES,
+        .conv_num_each_intr = sizeof(s_dma) / 4,
+        .adc1_chan_mask = channelMask,
+        .adc2_chan_mask = 0,
+    };
+    esp_err_t err = adc_digi_initialize(&init);
+    if(err != ESP_OK)
+        return err;
+    adc_digi_configuration_t digi = {
+        .conv_limit_en = ADC_CONV_LIMIT_EN,
+        .conv_limit_num = 250,
+        .pattern_num = count,
+        .adc_pattern = pattern,
+        .sample_freq_hz = rate * count,
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = ADC_DIGI_OUTPUT_FORMAT_TYPE1,
+    };
+    err = adc_digi_controller_configure(&digi);
+    if(err == ESP_OK)
+        err = adc_digi_start();
+    if(err != ESP_OK){
+        ESP_LOGE(TAGADC, "Continuous mode start fail: %s", esp_err_to_name(err));
+        adc_digi_deinitialize();
+    }
+    return err;
+}
+
+// Reads DMA results, driver reports overflow of its pool with ESP_ERR_INVALID_STATE
+static int cliAdcHardwareRead(cliAdcRaw_t *raw, int max, uint32_t timeoutMs, bool *overflow){
+    uint32_t len = 0;
+    uint32_t want = (max < CLI_ADC_READ_SAMPLES ? max : CLI_ADC_READ_SAMPLES) * ADC_DIGI_RESULT_BYTES;
+    esp_err_t err = adc_digi_read_bytes(s_dma, want, &len, timeoutMs);
+    if(err == ESP_ERR_TIMEOUT)
+        return 0;
+    if(err == ESP_ERR_INVALID_STATE)
+        *overflow = true;
+    else if(err != ESP_OK)
+        return -1;
+    int count = 0;
+    for(uint32_t i = 0; i + ADC_DIGI_RESULT_BYTES <= len; i += ADC_DIGI_RESULT_BYTES){
+        const adc_digi_output_data_t *result = (const adc_digi_output_data_t *)&s_dma[i];
+        if(result->type1.channel >= CLI_ADC_MAX_CHANNELS || s_index_of[result->type1.channel] < 0)
+            continue;
+        raw[count].index = s_index_of[result->type1.channel];
+        raw[count].value = result->type1.data;
+        count++;
+    }
+    return count;
+}
+
+// Stops continuous mode and releases DMA
+static void cliAdcHardwareStop(void){
+    adc_digi_stop();
+    adc_digi_deinitialize();
+}
+#else
+// Continuous mode driver does not exist in host builds
+static esp_err_t cliAdcHardwareStart(const uint8_t *pins, uint8_t count, uint32_t rate){
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static int cliAdcHardwareRead(cliAdcRaw_t *raw, int max, uint32_t timeoutMs, bool *overflow){
+    return -1;
+}
+
+static void cliAdcHardwareStop(void){
+}
+#endif
+
+// Synthetic source state, conversions are generated when they are due by wall clock
+static struct{
+    uint8_t count;
+    uint32_t rate;
+    int64_t start;
+    uint64_t produced;
+    uint8_t next;
+    uint32_t noise;
+}s_synth;
+
+// Starts synthetic source
+static esp_err_t cliAdcSyntheticStart(const uint8_t *pins, uint8_t count, uint32_t rate){
+    s_synth.count = count;
+    s_synth.rate = rate;
+    s_synth.start = esp_timer_get_time();
+    s_synth.produced = 0;
+    s_synth.next = 0;
+    s_synth.noise = 1;
+    return ESP_OK;
+}
+
+// Generates conversions which are due, channel n is a triangle wave with small noise
+static int cliAdcSyntheticRead(cliAdcRaw_t *raw, int max, uint32_t timeoutMs, bool *overflow){
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeoutMs * 1000;
+    uint64_t due;
+    while(1){
+        int64_t now = esp_timer_get_time();
+        due = (uint64_t)(now - s_synth.start) * s_synth.rate * s_synth.count / 1000000 - s_synth.produced;
+        if(due > 0 || now >= deadline)
+            break;
+        vTaskDelay(1);
+    }
+    // Conversions beyond the pool are lost like in hardware
+    if(due > CLI_ADC_POOL_SAMPLES){
+        uint64_t lost = due - CLI_ADC_POOL_SAMPLES;
+        s_synth.produced += lost;
+        s_synth.next = (s_synth.next + lost) % s_synth.count;
+        due = CLI_ADC_POOL_SAMPLES;
+        *overflow = true;
+    }
+    int count = due < (uint64_t)max ? (int)due : max;
+    for(int i = 0; i < count; i++){
+        uint32_t period = CLI_ADC_SYNTH_PERIOD * (s_synth.next + 1);
+        uint32_t phase = (s_synth.produced / s_synth.count) % period;
+        uint32_t value = phase < period / 2 ? phase * 2 * CLI_ADC_FULL_SCALE / period
+                                            : (period - phase) * 2 * CLI_ADC_FULL_SCALE / period;
+        // Linear congruential noise of +-7 LSB
+        s_synth.noise = s_synth.noise * 1103515245 + 12345;
+        int32_t noisy = (int32_t)value + (int32_t)((s_synth.noise >> 16) % 15) - 7;
+        raw[i].index = s_synth.next;
+        raw[i].value = noisy < 0 ? 0 : noisy > CLI_ADC_FULL_SCALE ? CLI_ADC_FULL_SCALE : noisy;
+        s_synth.produced++;
+        s_synth.next = (s_synth.next + 1) % s_synth.count;
+    }
+    return count;
+}
+
+// Synthetic source has nothing to release
+static void cliAdcSyntheticStop(void){
+}
+
+// Sources, indexed by type. ESP32 converts 20 kHz to 2 MHz in continuous mode.
+static const cliAdcSource_t s_sources[CLI_ADC_SOURCE_COUNT] = {
+    [CLI_ADC_SOURCE_HARDWARE]  = { "hw", 20000, 2000000, cliAdcHardwareStart, cliAdcHardwareRead, cliAdcHardwareStop },
+    [CLI_ADC_SOURCE_SYNTHETIC] = { "synth", 1, 2000000, cliAdcSyntheticStart, cliAdcSyntheticRead, cliAdcSyntheticStop }
+};
+
+// Returns a source
+const cliAdcSource_t *cliAdcGetSource(cliAdcSourceType_t type){
+    return &s_sources[type];
+}
+
+// Returns source type of a name, or CLI_ADC_SOURCE_COUNT
+cliAdcSourceType_t cliAdcFindSource(const char *name){
+    for(int type = 0; type < CLI_ADC_SOURCE_COUNT; type++){
+        if(strcmp(s_sources[type].name, name) == 0)
+            return type;
+    }
+    return CLI_ADC_SOURCE_COUNT;
+}
@@ -0,0 +1,120 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLIBoard.c
+*/
+#include <stdio.h>
+
+#include "CLISession.h"
+#include "CLIBoard.h"
+
+// Builds a mask from a pin range
+#define PINS(first, last) (((1ULL << ((last) - (first) + 1)) - 1) << (first))
+#define PIN(n) (1ULL << (n))
+
+// Pins which are common for all ESP32 chips
+#define ESP32_INPUT_ONLY (PINS(34, 39))
+#define ESP32_STRAPPING (PIN(0) | PIN(2) | PIN(5) | PIN(12) | PIN(15))
+#define ESP32_ADC (PINS(32, 39) | PIN(0) | PIN(2) | PIN(4) | PINS(12, 15) | PINS(25, 27))
+
+// Board profiles, indexed by CLI_BOARD
+static const cliBoardProfile_t s_profiles[] = {
+    [CLI_BOARD_ESP_WROOM_32] = {
+        .name = "ESP-WROOM-32",
+        .valid = PINS(0, 19) | PINS(21, 23) | PINS(25, 27) | PINS(32, 36) | PIN(39),
+        .inputOnly = ESP32_INPUT_ONLY,
+        .strapping = ESP32_STRAPPING,
+        .flash = PINS(6, 11),
+        .adc = ESP32_ADC
+    },
+    [CLI_BOARD_ESP32_WROVER] = {
+        // GPIO16 and GPIO17 are used by PSRAM
+        .name = "ESP32-WROVER",
+        .valid = PINS(0, 15) | PINS(18, 19) | PINS(21, 23) | PINS(25, 27) | PINS(32, 36) | PIN(39),
+        .inputOnly = ESP32_INPUT_ONLY,
+        .strapping = ESP32_STRAPPING,
+        .flash = PINS(6, 11) | PINS(16, 17),
+        .adc = ESP32_ADC
+    },
+    [CLI_BOARD_ESP32_PICO_D4] = {
+        // In-package flash uses GPIO6-8, GPIO11, GPIO16 and GPIO17, so GPIO9 and GPIO10 are free
+        .name = "ESP32-PICO-D4",
+        .valid = PINS(0, 5) | PINS(9, 10) | PINS(12, 15) | PINS(18, 19) | PINS(21, 23) | PINS(25, 27) | PINS(32, 39),
+        .inputOnly = ESP32_INPUT_ONLY,
+        .strapping = ESP32_STRAPPING,
+        .flash = PINS(6, 8) | PIN(11) | PINS(16, 17),
+        .adc = ESP32_ADC
+    }
+};
+
+_Static_assert(CLI_BOARD < sizeof(s_profiles) / sizeof(s_profiles[0]), "Unknown CLI_BOARD profile");
+
+// Returns profile of the build
+const cliBoardProfile_t *cliBoardGet(void){
+    return &s_profiles[CLI_BOARD];
+}
+
+// Returns mask of pins which can be used for given usage
+uint64_t cliBoardAllowed(cliBoardUse_t use){
+    const cliBoardProfile_t *board = cliBoardGet();
+    switch(use){
+        case CLI_BOARD_USE_WRITE:
+            return board->valid & ~board->flash & ~board->inputOnly;
+        case CLI_BOARD_USE_ADC:
+            return board->valid & ~board->flash & board->adc;
+        default:
+            return board->valid;
+    }
+}
+
+// Checks one pin with a single mask test, reason is looked up only for a rejected pin
+cliBoardPinError_t cliBoardCheckPin(int pin, cliBoardUse_t use){
+    if(pin >= 0 && pin <= CLI_BOARD_MAX_PIN && (cliBoardAllowed(use) & PIN(pin)))
+        return CLI_BOARD_PIN_OK;
+    const cliBoardProfile_t *board = cliBoardGet();
+    if(pin < 0 || pin > CLI_BOARD_MAX_PIN || !(board->valid & PIN(pin)))
+        return CLI_BOARD_PIN_INVALID;
+    if(board->flash & PIN(pin))
+        return CLI_BOARD_PIN_FLASH;
+    if(use == CLI_BOARD_USE_WRITE)
+        return CLI_BOARD_PIN_INPUT_ONLY;
+    return CLI_BOARD_PIN_NO_ADC;
+}
+
+// Checks every pin of a mask, first rejected pin is returned in badPin
+cliBoardPinError_t cliBoardCheckMask(uint64_t mask, cliBoardUse_t use, int *badPin){
+    uint64_t rejected = mask & ~cliBoardAllowed(use);
+    if(rejected == 0)
+        return CLI_BOARD_PIN_OK;
+    *badPin = __builtin_ctzll(rejected);
+    return cliBoardCheckPin(*badPin, use);
+}
+
+// Returns true if pin is sampled at reset, driving it may change boot mode
+bool cliBoardIsStrapping(int pin){
+    return pin >= 0 && pin <= CLI_BOARD_MAX_PIN && (cliBoardGet()->strapping & PIN(pin));
+}
+
+// Checks a pin and prints the reason to current session if it is rejected
+bool cliBoardReportPin(int pin, cliBoardUse_t use){
+    const char *name = cliBoardGet()->name;
+    switch(cliBoardCheckPin(pin, use)){
+        case CLI_BOARD_PIN_OK:
+            if(use == CLI_BOARD_USE_WRITE && cliBoardIsStrapping(pin))
+                cliSessionPrintf("Warning: GPIO %d is a strapping pin, its level at reset selects boot mode!\n", pin);
+            return true;
+        case CLI_BOARD_PIN_INVALID:
+            cliSessionPrintf("This pin ( %d ) is not available in %s Board!\n", pin, name);
+            break;
+        case CLI_BOARD_PIN_FLASH:
+            cliSessionPrintf("This pin ( %d ) is reserved for SPI flash/PSRAM in %s Board!\n", pin, name);
+            break;
+        case CLI_BOARD_PIN_INPUT_ONLY:
+            cliSessionPrintf("This pin ( %d ) is input only, it can not be driven!\n", pin);
+            break;
+        case CLI_BOARD_PIN_NO_ADC:
+            cliSessionPrintf("This pin ( %d ) has no ADC channel!\n", pin);
+            break;
+    }
+    return false;
+}
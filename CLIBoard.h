@@ -0,0 +1,58 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLIBoard.h
+*/
+#ifndef _CLIBOARD_H_
+#define _CLIBOARD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Board profiles, a new module variant only needs a new profile in CLIBoard.c
+#define CLI_BOARD_ESP_WROOM_32 (0)
+#define CLI_BOARD_ESP32_WROVER (1)
+#define CLI_BOARD_ESP32_PICO_D4 (2)
+
+// Profile of the build, it can be given by compiler flags too
+#ifndef CLI_BOARD
+#define CLI_BOARD CLI_BOARD_ESP_WROOM_32
+#endif
+
+// Highest GPIO number of ESP32
+#define CLI_BOARD_MAX_PIN (39)
+
+// Pin capability masks of a board, bit n is GPIOn
+typedef struct{
+    const char *name;
+    uint64_t valid;         // Pins which are routed out of the module
+    uint64_t inputOnly;     // Pins without output driver
+    uint64_t strapping;     // Pins which are sampled at reset
+    uint64_t flash;         // Pins which are connected to SPI flash or PSRAM
+    uint64_t adc;           // Pins which have an ADC channel
+}cliBoardProfile_t;
+
+// Usages which a command needs from a pin
+typedef enum{
+    CLI_BOARD_USE_READ = 0,
+    CLI_BOARD_USE_WRITE,
+    CLI_BOARD_USE_ADC
+}cliBoardUse_t;
+
+// Result of a pin check
+typedef enum{
+    CLI_BOARD_PIN_OK = 0,
+    CLI_BOARD_PIN_INVALID,
+    CLI_BOARD_PIN_FLASH,
+    CLI_BOARD_PIN_INPUT_ONLY,
+    CLI_BOARD_PIN_NO_ADC
+}cliBoardPinError_t;
+
+const cliBoardProfile_t *cliBoardGet(void);
+uint64_t cliBoardAllowed(cliBoardUse_t);
+cliBoardPinError_t cliBoardCheckPin(int, cliBoardUse_t);
+cliBoardPinError_t cliBoardCheckMask(uint64_t, cliBoardUse_t, int*);
+bool cliBoardIsStrapping(int);
+bool cliBoardReportPin(int, cliBoardUse_t);
+
+#endif
@@ -0,0 +1,129 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLIBoot.c
+*/
+#include <stdio.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+
+#include "CLISession.h"
+#include "CLIJson.h"
+#include "CLIBoot.h"
+
+// TAG for boot log functions
+static const char *TAGBOOT = "Boot";
+
+// Stage table of the last boot and its timings
+static const cliBootStage_t *s_stages;
+static int s_count;
+static cliBootTiming_t s_timings[CLI_BOOT_MAX_STAGES];
+// Finished stages, bit n is stage n
+static EventGroupHandle_t s_done;
+// Start and end of whole graph, and first command which is run after it
+static int64_t s_boot_start;
+static int64_t s_boot_end;
+static volatile int64_t s_first_command;
+
+// Waits for dependencies of a stage and runs it
+static void cliBootStageRun(int index){
+    const cliBootStage_t *stage = &s_stages[index];
+    cliBootTiming_t *timing = &s_timings[index];
+    if(stage->deps)
+        xEventGroupWaitBits(s_done, stage->deps, pdFALSE, pdTRUE, portMAX_DELAY);
+    timing->core = xPortGetCoreID();
+    timing->start = esp_timer_get_time();
+    stage->run();
+    timing->end = esp_timer_get_time();
+    ESP_LOGI(TAGBOOT, "%s done in %u ms", stage->name, (uint32_t)((timing->end - timing->start) / 1000));
+    xEventGroupSetBits(s_done, CLI_BOOT_DEP(index));
+}
+
+// Task of one stage
+static void cliBootTask(void *arg){
+    cliBootStageRun((int)(intptr_t)arg);
+    vTaskDelete(NULL);
+}
+
+// Runs all stages of a table and returns when every one is finished
+void cliBootRun(const cliBootStage_t *stages, int count){
+    s_boot_start = esp_timer_get_time();
+    s_stages = stages;
+    s_count = count < CLI_BOOT_MAX_STAGES ? count : CLI_BOOT_MAX_STAGES;
+    s_done = xEventGroupCreate();
+    uint32_t all = 0;
+    for(int i = 0; i < s_count; i++){
+        all |= CLI_BOOT_DEP(i);
+        // A dependency on a later stage would never be met
+        configASSERT((stages[i].deps & ~(CLI_BOOT_DEP(i) - 1)) == 0);
+        if(!stages[i].enabled){
+            s_timings[i].start = s_timings[i].end = 0;
+            xEventGroupSetBits(s_done, CLI_BOOT_DEP(i));
+            continue;
+        }
+        char name[configMAX_TASK_NAME_LEN];
+        snprintf(name, sizeof(name), "boot_%s", stages[i].name);
+        if(xTaskCreate(cliBootTask, name, CLI_BOOT_TASK_STACK, (void *)(intptr_t)i, CLI_BOOT_TASK_PRIORITY, NULL) != pdPASS){
+            // Caller runs the stage itself, later stages are only created after it
+            ESP_LOGW(TAGBOOT, "No task for %s, it is run serially", stages[i].name);
+            cliBootStageRun(i);
+        }
+    }
+    xEventGroupWaitBits(s_done, all, pdFALSE, pdTRUE, portMAX_DELAY);
+    s_boot_end = esp_timer_get_time();
+    ESP_LOGI(TAGBOOT, "Boot stages done in %u ms", (uint32_t)((s_boot_end - s_boot_start) / 1000));
+}
+
+// Records time of first command after boot, it is time-to-first-command
+void cliBootMarkFirstCommand(void){
+    if(s_first_command == 0 && s_boot_end != 0)
+        s_first_command = esp_timer_get_time();
+}
+
+// Prints timing of every stage to current session
+void cliBootProfile(void){
+    if(cliJsonEnabled()){
+        cliJson_t json;
+        cliJsonBegin(&json, cliSessionGetCurrent());
+        cliJsonUint(&json, "start_us", s_boot_start);
+        cliJsonUint(&json, "done_us", s_boot_end);
+        cliJsonUint(&json, "first_command_us", s_first_command);
+        cliJsonArray(&json, "stages");
+        for(int i = 0; i < s_count; i++){
+            const cliBootTiming_t *timing = &s_timings[i];
+            cliJsonObject(&json, NULL);
+            cliJsonString(&json, "name", s_stages[i].name);
+            cliJsonBool(&json, "enabled", s_stages[i].enabled);
+            if(s_stages[i].enabled){
+                cliJsonUint(&json, "start_us", timing->start);
+                cliJsonUint(&json, "end_us", timing->end);
+                cliJsonInt(&json, "core", timing->core);
+            }
+            cliJsonClose(&json);
+        }
+        cliJsonEnd(&json);
+        return;
+    }
+    cliSessionPrintf("STAGE          CORE  START(ms)  END(ms)  TIME(ms)  DEPENDS\n");
+    for(int i = 0; i < s_count; i++){
+        const cliBootTiming_t *timing = &s_timings[i];
+        cliSessionPrintf("%-14s ", s_stages[i].name);
+        if(!s_stages[i].enabled)
+            cliSessionPrintf("-     skipped                      ");
+        else
+            cliSessionPrintf("%-5d %-10u %-8u %-9u ", timing->core, (uint32_t)(timing->start / 1000),
+                             (uint32_t)(timing->end / 1000), (uint32_t)((timing->end - timing->start) / 1000));
+        for(int dep = 0; dep < s_count; dep++){
+            if(s_stages[i].deps & CLI_BOOT_DEP(dep))
+                cliSessionPrintf(" %s", s_stages[dep].name);
+        }
+        cliSessionPrintf("\n");
+    }
+    cliSessionPrintf("Stages: %u ms (from %u ms to %u ms after start)\n", (uint32_t)((s_boot_end - s_boot_start) / 1000),
+                     (uint32_t)(s_boot_start / 1000), (uint32_t)(s_boot_end / 1000));
+    if(s_first_command)
+        cliSessionPrintf("First command: %u ms after start\n", (uint32_t)(s_first_command / 1000));
+}
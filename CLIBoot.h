@@ -0,0 +1,45 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLIBoot.h
+*/
+#ifndef _CLIBOOT_H_
+#define _CLIBOOT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Maximum number of init stages, every stage is one event group bit
+#define CLI_BOOT_MAX_STAGES (16)
+// Stage task settings, Wi-Fi init needs the largest stack
+#define CLI_BOOT_TASK_STACK (4096)
+#define CLI_BOOT_TASK_PRIORITY (5)
+
+// Dependency mask of a stage
+#define CLI_BOOT_DEP(stage) (1u << (stage))
+
+/* Boot is a graph of stages. Each enabled stage runs on its own task as soon as all stages in its
+ * dependency mask are finished, so independent stages overlap, e.g. Wi-Fi association and command
+ * registration. A stage may only depend on stages before it in the table. A disabled stage is done
+ * at once, so stages which depend on it are not held. */
+
+// Init stage
+typedef struct{
+    const char *name;
+    void (*run)(void);
+    uint32_t deps;
+    bool enabled;
+}cliBootStage_t;
+
+// Timing of a stage in microseconds since start of application
+typedef struct{
+    int64_t start;              // All dependencies are finished
+    int64_t end;
+    int8_t core;
+}cliBootTiming_t;
+
+void cliBootRun(const cliBootStage_t*, int);
+void cliBootMarkFirstCommand(void);
+void cliBootProfile(void);
+
+#endif
@@ -0,0 +1,322 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLIBus.c
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "CLISession.h"
+#include "CLIJson.h"
+#include "CLIGpio.h"
+#include "CLIBus.h"
+
+// TAG for bus log functions
+static const char *TAGBUS = "Bus";
+
+// Opened driver and settings of every bus
+static struct{
+    const cliBusDriver_t *driver;
+    cliBusConfig_t config;
+}s_bus[CLI_BUS_COUNT];
+
+// Parsed list, commands are serialized so one list exists at a time. Transfers are packed back to back
+// in the pools, so only the first slice is word aligned; SPI master driver copies other DMA slices
+// through a temporary buffer.
+static cliBusOp_t s_ops[CLI_BUS_MAX_OPS];
+static int s_item_of[CLI_BUS_MAX_OPS];
+static int s_count;
+static uint8_t s_tx[CLI_BUS_DATA_SIZE] __attribute__((aligned(4)));
+static uint8_t s_rx[CLI_BUS_DATA_SIZE] __attribute__((aligned(4)));
+
+// Returns name of a bus
+const char *cliBusName(cliBusType_t bus){
+    return bus == CLI_BUS_I2C ? "i2c" : "spi";
+}
+
+// GPIO owner of a bus
+static cliGpioOwner_t cliBusOwner(cliBusType_t bus){
+    return bus == CLI_BUS_I2C ? CLI_GPIO_OWNER_I2C : CLI_GPIO_OWNER_SPI;
+}
+
+// Gives pins of a config back, unused pins are negative
+static void cliBusReleasePins(cliBusType_t bus, const cliBusConfig_t *config){
+    for(int i = 0; i < 4; i++){
+        if(config->pins[i] >= 0)
+            cliGpioRelease(config->pins[i], cliBusOwner(bus));
+    }
+}
+
+// Opens a bus with a driver, an open bus is closed first
+esp_err_t cliBusOpen(cliBusType_t bus, const cliBusDriver_t *driver, const cliBusConfig_t *config){
+    cliBusClose(bus);
+    // Pins are claimed before driver takes them, so they can not be driven by pwm or waveform meanwhile
+    for(int i = 0; i < 4; i++){
+        if(config->pins[i] >= 0 && !cliGpioClaim(config->pins[i], cliBusOwner(bus))){
+            cliBusReleasePins(bus, config);
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+    esp_err_t err = driver->open(bus, config);
+    if(err != ESP_OK){
+        ESP_LOGE(TAGBUS, "Unable to open %s with %s driver: %s", cliBusName(bus), driver->name, esp_err_to_name(err));
+        cliBusReleasePins(bus, config);
+        return err;
+    }
+    for(int i = 0; i < 4; i++){
+        if(config->pins[i] >= 0)
+            cliGpioEnableInput(config->pins[i]);
+    }
+    s_bus[bus].driver = driver;
+    s_bus[bus].config = *config;
+    return ESP_OK;
+}
+
+// Closes a bus and releases its pins
+void cliBusClose(cliBusType_t bus){
+    if(s_bus[bus].driver == NULL)
+        return;
+    s_bus[bus].driver->close(bus);
+    s_bus[bus].driver = NULL;
+    cliBusReleasePins(bus, &s_bus[bus].config);
+}
+
+// Returns driver of an open bus, or NULL
+const cliBusDriver_t *cliBusGetDriver(cliBusType_t bus){
+    return s_bus[bus].driver;
+}
+
+// Returns settings of an open bus
+const cliBusConfig_t *cliBusGetConfig(cliBusType_t bus){
+    return &s_bus[bus].config;
+}
+
+// Parses hex bytes into pool, returns end of digits or NULL for odd digit count or full pool
+static const char *cliBusParseHex(const char *p, uint8_t *out, size_t space, uint16_t *len){
+    size_t n = 0;
+    while(isxdigit((unsigned char)p[0])){
+        if(!isxdigit((unsigned char)p[1]) || n >= space)
+            return NULL;
+        char byte[3] = { p[0], p[1], 0 };
+        out[n++] = strtoul(byte, NULL, 16);
+        p += 2;
+    }
+    *len = n;
+    return n > 0 ? p : NULL;
+}
+
+// Parses a decimal number, returns end of digits or NULL
+static const char *cliBusParseNumber(const char *p, uint32_t *value){
+    if(!isdigit((unsigned char)*p))
+        return NULL;
+    char *end;
+    *value = strtoul(p, &end, 10);
+    return end;
+}
+
+// Parses a transaction list into s_ops, 'item' is set to the item which is wrong
+static cliBusResult_t cliBusParse(cliBusType_t bus, const char *list, int *item){
+    size_t txUsed = 0;
+    size_t rxUsed = 0;
+    uint32_t delayUs = 0;
+    int address = -1;
+    const char *p = list;
+    s_count = 0;
+    for(*item = 0; *p != 0; (*item)++){
+        char type = *p++;
+        uint32_t value = 0;
+        if(type == 'a'){
+            uint16_t len;
+            uint8_t byte;
+            p = cliBusParseHex(p, &byte, 1, &len);
+            if(p == NULL || byte > 0x7F)
+                return CLI_BUS_SYNTAX;
+            if(bus != CLI_BUS_I2C)
+                return CLI_BUS_WRONG_BUS;
+            address = byte;
+        }
+        else{
+            if(s_count >= CLI_BUS_MAX_OPS)
+                return CLI_BUS_TOO_LONG;
+            cliBusOp_t *op = &s_ops[s_count];
+            memset(op, 0, sizeof(*op));
+            switch(type){
+                case 'w':
+                case 'x':
+                    op->type = type == 'w' ? CLI_BUS_OP_WRITE : CLI_BUS_OP_EXCHANGE;
+                    op->tx = s_tx + txUsed;
+                    p = cliBusParseHex(p, s_tx + txUsed, sizeof(s_tx) - txUsed, &op->txLen);
+                    if(p == NULL)
+                        return txUsed >= sizeof(s_tx) ? CLI_BUS_TOO_LONG : CLI_BUS_SYNTAX;
+                    // Pattern is repeated, e.g. to clear a display memory
+                    if(*p == '*'){
+                        p = cliBusParseNumber(p + 1, &value);
+                        if(p == NULL || value == 0)
+                            return CLI_BUS_SYNTAX;
+                        if((size_t)op->txLen * value > sizeof(s_tx) - txUsed)
+                            return CLI_BUS_TOO_LONG;
+                        for(uint32_t i = 1; i < value; i++)
+                            memcpy(s_tx + txUsed + i * op->txLen, op->tx, op->txLen);
+                        op->txLen *= value;
+                    }
+                    txUsed += op->txLen;
+                    if(type == 'x')
+                        op->rxLen = op->txLen;
+                    break;
+                case 'r':
+                    op->type = CLI_BUS_OP_READ;
+                    p = cliBusParseNumber(p, &value);
+                    if(p == NULL || value == 0)
+                        return CLI_BUS_SYNTAX;
+                    if(value > CLI_BUS_DATA_SIZE)
+                        return CLI_BUS_TOO_LONG;
+                    op->rxLen = value;
+                    break;
+                case 'b':
+                    op->type = CLI_BUS_OP_BURST;
+                    op->tx = s_tx + txUsed;
+                    p = cliBusParseHex(p, s_tx + txUsed, sizeof(s_tx) - txUsed, &op->txLen);
+                    if(p == NULL || *p != ':')
+                        return CLI_BUS_SYNTAX;
+                    p = cliBusParseNumber(p + 1, &value);
+                    if(p == NULL || value == 0)
+                        return CLI_BUS_SYNTAX;
+                    if(value > CLI_BUS_DATA_SIZE)
+                        return CLI_BUS_TOO_LONG;
+                    txUsed += op->txLen;
+                    op->rxLen = value;
+                    break;
+                case 'd':
+                    op->type = CLI_BUS_OP_DELAY;
+                    p = cliBusParseNumber(p, &op->delayUs);
+                    if(p == NULL)
+                        return CLI_BUS_SYNTAX;
+                    // Command lock is held through delays, so they are bounded
+                    if(op->delayUs > CLI_BUS_MAX_DELAY_US || op->delayUs > CLI_BUS_MAX_LIST_DELAY_US - delayUs)
+                        return CLI_BUS_DELAY_TOO_LONG;
+                    delayUs += op->delayUs;
+                    break;
+                default:
+                    return CLI_BUS_SYNTAX;
+            }
+            if(op->type == CLI_BUS_OP_EXCHANGE && bus != CLI_BUS_SPI)
+                return CLI_BUS_WRONG_BUS;
+            if(bus == CLI_BUS_I2C && op->type != CLI_BUS_OP_DELAY){
+                if(address < 0)
+                    return CLI_BUS_NO_ADDRESS;
+                op->address = address;
+            }
+            // Reads are collected back to back, so the response is one copy of the pool
+            if(op->rxLen){
+                if(rxUsed + op->rxLen > sizeof(s_rx))
+                    return CLI_BUS_TOO_LONG;
+                op->rx = s_rx + rxUsed;
+                rxUsed += op->rxLen;
+            }
+            s_item_of[s_count++] = *item;
+        }
+        if(*p == ',')
+            p++;
+        else if(*p != 0)
+            return CLI_BUS_SYNTAX;
+    }
+    return CLI_BUS_OK;
+}
+
+// Parses and runs a transaction list, transfers between delays are given to the driver at once
+cliBusResult_t cliBusRun(cliBusType_t bus, const char *list, cliBusReport_t *report){
+    memset(report, 0, sizeof(*report));
+    const cliBusDriver_t *driver = s_bus[bus].driver;
+    if(driver == NULL)
+        return CLI_BUS_NOT_OPEN;
+    cliBusResult_t result = cliBusParse(bus, list, &report->item);
+    if(result != CLI_BUS_OK)
+        return result;
+
+    int64_t start = esp_timer_get_time();
+    int first = 0;
+    for(int i = 0; i <= s_count; i++){
+        if(i < s_count && s_ops[i].type != CLI_BUS_OP_DELAY)
+            continue;
+        if(i > first){
+            report->err = driver->run(bus, &s_ops[first], i - first);
+            if(report->err != ESP_OK){
+                report->item = s_item_of[first];
+                return CLI_BUS_FAIL;
+            }
+        }
+        if(i < s_count)
+            driver->delay(s_ops[i].delayUs);
+        first = i + 1;
+    }
+    report->elapsedUs = esp_timer_get_time() - start;
+    for(int i = 0; i < s_count; i++){
+        if(s_ops[i].rxLen){
+            report->reads++;
+            report->rxLen += s_ops[i].rxLen;
+        }
+    }
+    return CLI_BUS_OK;
+}
+
+// Writes hex of read bytes, groups are converted in a small buffer instead of one printf per byte
+static void cliBusWriteHex(const uint8_t *data, size_t len){
+    static const char digits[] = "0123456789abcdef";
+    char text[128];
+    size_t n = 0;
+    for(size_t i = 0; i < len; i++){
+        text[n++] = digits[data[i] >> 4];
+        text[n++] = digits[data[i] & 0x0F];
+        if(n == sizeof(text)){
+            cliSessionWrite(text, n);
+            n = 0;
+        }
+    }
+    cliSessionWrite(text, n);
+}
+
+// Writes read bytes of last run as text, JSON or binary response
+void cliBusWriteResponse(cliBusResult_t result, const cliBusReport_t *report, bool binary){
+    if(binary){
+        // Reads are consecutive in the pool, so payload is its head
+        uint8_t header[8] = { 'B', 'R', CLI_BUS_VERSION, result, report->reads };
+        size_t len = result == CLI_BUS_OK ? report->rxLen : 0;
+        header[5] = len & 0xFF;
+        header[6] = len >> 8;
+        cliSessionWrite((const char *)header, 7);
+        cliSessionWrite((const char *)s_rx, len);
+        return;
+    }
+    if(cliJsonEnabled()){
+        cliJson_t json;
+        cliJsonBegin(&json, cliSessionGetCurrent());
+        cliJsonArray(&json, "reads");
+        for(int i = 0; i < s_count; i++){
+            if(s_ops[i].rxLen == 0)
+                continue;
+            cliJsonHex(&json, NULL, s_ops[i].rx, s_ops[i].rxLen);
+        }
+        cliJsonClose(&json);
+        cliJsonUint(&json, "elapsed_us", report->elapsedUs);
+        cliJsonEnd(&json);
+        return;
+    }
+    if(report->reads == 0){
+        cliSessionPrintf("OK\n");
+        return;
+    }
+    bool space = false;
+    for(int i = 0; i < s_count; i++){
+        if(s_ops[i].rxLen == 0)
+            continue;
+        if(space)
+            cliSessionWrite(" ", 1);
+        cliBusWriteHex(s_ops[i].rx, s_ops[i].rxLen);
+        space = true;
+    }
+    cliSessionWrite("\n", 1);
+}
@@ -0,0 +1,118 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLIBus.h
+*/
+#ifndef _CLIBUS_H_
+#define _CLIBUS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Maximum number of transfers in a transaction list
+#define CLI_BUS_MAX_OPS (32)
+// Write and read data of a transaction list, large SPI transfers go through DMA
+#define CLI_BUS_DATA_SIZE (4096)
+// SPI transfers which fit the 4 byte transaction registers do not set up DMA
+#define CLI_BUS_SPI_INLINE_BYTES (4)
+// Default clocks
+#define CLI_BUS_I2C_HZ (100000)
+#define CLI_BUS_SPI_HZ (1000000)
+// Longest delay item and sum of delays of a list, other commands wait while a list runs
+#define CLI_BUS_MAX_DELAY_US (1000000)
+#define CLI_BUS_MAX_LIST_DELAY_US (2000000)
+// Longest time of one I2C segment
+#define CLI_BUS_I2C_TIMEOUT_MS (1000)
+// Binary response format version
+#define CLI_BUS_VERSION (1)
+
+/* A transaction list is one argument, transfers are separated by ',':
+ *   a<hex>          I2C device address of following transfers
+ *   w<hex>[*<n>]    write bytes, optionally repeated n times
+ *   r<n>            read n bytes
+ *   b<hex>:<n>      register burst, write register then read n bytes (I2C repeated start)
+ *   x<hex>[*<n>]    SPI full duplex exchange, read bytes are as many as written ones
+ *   d<us>           delay, it ends the segment: I2C stop condition, SPI chip select release. A delay is
+ *                   at most CLI_BUS_MAX_DELAY_US and delays of a list at most CLI_BUS_MAX_LIST_DELAY_US
+ * Transfers between delays are one segment which is given to the driver at once. Read bytes of all
+ * transfers are collected in one response:
+ *   Text   : hex of every read, separated by space
+ *   Binary : 'B' 'R' | version (1) | status (1) | reads (1) | length (2) | bytes */
+
+// Buses
+typedef enum{
+    CLI_BUS_I2C = 0,
+    CLI_BUS_SPI,
+    CLI_BUS_COUNT
+}cliBusType_t;
+
+// Transfer types
+typedef enum{
+    CLI_BUS_OP_WRITE = 0,
+    CLI_BUS_OP_READ,
+    CLI_BUS_OP_BURST,
+    CLI_BUS_OP_EXCHANGE,
+    CLI_BUS_OP_DELAY
+}cliBusOpType_t;
+
+// Transfer, tx and rx point into data pools of the list
+typedef struct{
+    cliBusOpType_t type;
+    uint8_t address;
+    uint16_t txLen;
+    uint16_t rxLen;
+    const uint8_t *tx;
+    uint8_t *rx;
+    uint32_t delayUs;
+}cliBusOp_t;
+
+// Bus settings, pins are SDA and SCL for I2C, MOSI, MISO, SCLK and CS for SPI
+typedef struct{
+    int pins[4];
+    uint32_t hz;
+    uint8_t mode;
+}cliBusConfig_t;
+
+/* Driver interface, run() gets one segment which has no delays. Hardware driver uses ESP-IDF I2C and
+ * SPI master drivers, mock driver keeps a 256 byte register file so lists can be tested on a host. */
+typedef struct{
+    const char *name;
+    esp_err_t (*open)(cliBusType_t, const cliBusConfig_t*);
+    void (*close)(cliBusType_t);
+    esp_err_t (*run)(cliBusType_t, const cliBusOp_t*, int);
+    void (*delay)(uint32_t);
+}cliBusDriver_t;
+
+// Results of a transaction list
+typedef enum{
+    CLI_BUS_OK = 0,
+    CLI_BUS_NOT_OPEN,
+    CLI_BUS_SYNTAX,
+    CLI_BUS_TOO_LONG,                   // Too many transfers or bytes
+    CLI_BUS_NO_ADDRESS,                 // I2C transfer before an 'a' item
+    CLI_BUS_WRONG_BUS,                  // Item is not supported by this bus
+    CLI_BUS_FAIL,                       // Driver returned an error
+    CLI_BUS_DELAY_TOO_LONG              // Delay item or sum of delays is over its limit
+}cliBusResult_t;
+
+// Outcome of a run, 'item' is the failed item, for driver errors it is first item of the segment
+typedef struct{
+    int item;
+    esp_err_t err;
+    int reads;
+    size_t rxLen;
+    int64_t elapsedUs;
+}cliBusReport_t;
+
+const cliBusDriver_t *cliBusHardwareDriver(void);
+const cliBusDriver_t *cliBusMockDriver(void);
+esp_err_t cliBusOpen(cliBusType_t, const cliBusDriver_t*, const cliBusConfig_t*);
+void cliBusClose(cliBusType_t);
+const cliBusDriver_t *cliBusGetDriver(cliBusType_t);
+const cliBusConfig_t *cliBusGetConfig(cliBusType_t);
+cliBusResult_t cliBusRun(cliBusType_t, const char*, cliBusReport_t*);
+void cliBusWriteResponse(cliBusResult_t, const cliBusReport_t*, bool);
+const char *cliBusName(cliBusType_t);
+
+#endif
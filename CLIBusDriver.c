@@ -0,0 +1,253 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLIBusDriver.c
+*/
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#include "CLIBus.h"
+
+// Hardware driver needs I2C and SPI master drivers of ESP-IDF
+#if defined(ESP_PLATFORM) && !CONFIG_IDF_TARGET_LINUX
+#include "driver/i2c.h"
+#include "driver/spi_master.h"
+#include "esp_rom_sys.h"
+#define CLI_BUS_HARDWARE (1)
+#else
+#define CLI_BUS_HARDWARE (0)
+#endif
+
+// Device address which answers on mock I2C bus
+#define CLI_BUS_MOCK_ADDRESS (0x50)
+// Shorter delays are busy waits, longer ones let other tasks run
+#define CLI_BUS_BUSY_WAIT_US (2000)
+
+#if CLI_BUS_HARDWARE
+// Ports of buses
+#define CLI_BUS_I2C_PORT (I2C_NUM_0)
+#define CLI_BUS_SPI_HOST (SPI2_HOST)
+
+// SPI device of open bus
+static spi_device_handle_t s_spi;
+
+// Installs I2C master or SPI master with DMA on pins of config
+static esp_err_t cliBusHardwareOpen(cliBusType_t bus, const cliBusConfig_t *config){
+    if(bus == CLI_BUS_I2C){
+        i2c_config_t i2c = {
+            .mode = I2C_MODE_MASTER,
+            .sda_io_num = config->pins[0],
+            .scl_io_num = config->pins[1],
+            .sda_pullup_en = GPIO_PULLUP_ENABLE,
+            .scl_pullup_en = GPIO_PULLUP_ENABLE,
+            .master.clk_speed = config->hz,
+        };
+        esp_err_t err = i2c_param_config(CLI_BUS_I2C_PORT, &i2c);
+        if(err == ESP_OK)
+            err = i2c_driver_install(CLI_BUS_I2C_PORT, I2C_MODE_MASTER, 0, 0, 0);
+        return err;
+    }
+    spi_bus_config_t spi = {
+        .mosi_io_num = config->pins[0],
+        .miso_io_num = config->pins[1],
+        .sclk_io_num = config->pins[2],
+        .quadwp_io_num = -1,
+        .quadhd_io_num = -1,
+        .max_transfer_sz = CLI_BUS_DATA_SIZE,
+    };
+    esp_err_t err = spi_bus_initialize(CLI_BUS_SPI_HOST, &spi, SPI_DMA_CH_AUTO);
+    if(err != ESP_OK)
+        return err;
+    spi_device_interface_config_t device = {
+        .mode = config->mode,
+        .clock_speed_hz = config->hz,
+        .spics_io_num = config->pins[3],
+        .queue_size = 1,
+    };
+    err = spi_bus_add_device(CLI_BUS_SPI_HOST, &device, &s_spi);
+    if(err != ESP_OK)
+        spi_bus_free(CLI_BUS_SPI_HOST);
+    return err;
+}
+
+// Removes driver of a bus
+static void cliBusHardwareClose(cliBusType_t bus){
+    if(bus == CLI_BUS_I2C){
+        i2c_driver_delete(CLI_BUS_I2C_PORT);
+        return;
+    }
+    spi_bus_remove_device(s_spi);
+    spi_bus_free(CLI_BUS_SPI_HOST);
+}
+
+// Runs an I2C segment as one command link, transfers are joined with repeated starts
+static esp_err_t cliBusHardwareI2c(const cliBusOp_t *ops, int count){
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    if(cmd == NULL)
+        return ESP_ERR_NO_MEM;
+    for(int i = 0; i < count; i++){
+        const cliBusOp_t *op = &ops[i];
+        if(op->txLen){
+            i2c_master_start(cmd);
+            i2c_master_write_byte(cmd, (op->address << 1) | I2C_MASTER_WRITE, true);
+            i2c_master_write(cmd, op->tx, op->txLen, true);
+        }
+        if(op->rxLen){
+            i2c_master_start(cmd);
+            i2c_master_write_byte(cmd, (op->address << 1) | I2C_MASTER_READ, true);
+            i2c_master_read(cmd, op->rx, op->rxLen, I2C_MASTER_LAST_NACK);
+        }
+    }
+    i2c_master_stop(cmd);
+    esp_err_t err = i2c_master_cmd_begin(CLI_BUS_I2C_PORT, cmd, pdMS_TO_TICKS(CLI_BUS_I2C_TIMEOUT_MS));
+    i2c_cmd_link_delete(cmd);
+    return err;
+}
+
+// Runs one SPI transfer, short ones use transaction registers instead of DMA descriptors
+static esp_err_t cliBusHardwareSpiTransfer(const uint8_t *tx, uint8_t *rx, size_t len, bool keep){
+    spi_transaction_t t = {
+        .length = len * 8,
+        .rxlength = rx ? len * 8 : 0,
+        .flags = keep ? SPI_TRANS_CS_KEEP_ACTIVE : 0,
+    };
+    if(len <= CLI_BUS_SPI_INLINE_BYTES){
+        if(tx)
+            memcpy(t.tx_data, tx, len);
+        t.flags |= (tx ? SPI_TRANS_USE_TXDATA : 0) | (rx ? SPI_TRANS_USE_RXDATA : 0);
+    }
+    else{
+        t.tx_buffer = tx;
+        t.rx_buffer = rx;
+    }
+    esp_err_t err = spi_device_polling_transmit(s_spi, &t);
+    if(err == ESP_OK && rx && len <= CLI_BUS_SPI_INLINE_BYTES)
+        memcpy(rx, t.rx_data, len);
+    return err;
+}
+
+// Runs an SPI segment with chip select held, bus is acquired so no other device can take it
+static esp_err_t cliBusHardwareSpi(const cliBusOp_t *ops, int count){
+    esp_err_t err = spi_device_acquire_bus(s_spi, portMAX_DELAY);
+    if(err != ESP_OK)
+        return err;
+    for(int i = 0; i < count && err == ESP_OK; i++){
+        const cliBusOp_t *op = &ops[i];
+        bool last = i == count - 1;
+        switch(op->type){
+            case CLI_BUS_OP_WRITE:
+                err = cliBusHardwareSpiTransfer(op->tx, NULL, op->txLen, !last);
+                break;
+            case CLI_BUS_OP_READ:
+                err = cliBusHardwareSpiTransfer(NULL, op->rx, op->rxLen, !last);
+                break;
+            case CLI_BUS_OP_BURST:
+                err = cliBusHardwareSpiTransfer(op->tx, NULL, op->txLen, true);
+                if(err == ESP_OK)
+                    err = cliBusHardwareSpiTransfer(NULL, op->rx, op->rxLen, !last);
+                break;
+            default:
+                err = cliBusHardwareSpiTransfer(op->tx, op->rx, op->txLen, !last);
+                break;
+        }
+    }
+    spi_device_release_bus(s_spi);
+    return err;
+}
+
+// Runs a segment on a bus
+static esp_err_t cliBusHardwareRun(cliBusType_t bus, const cliBusOp_t *ops, int count){
+    return bus == CLI_BUS_I2C ? cliBusHardwareI2c(ops, count) : cliBusHardwareSpi(ops, count);
+}
+
+// Waits between segments
+static void cliBusHardwareDelay(uint32_t us){
+    if(us < CLI_BUS_BUSY_WAIT_US)
+        esp_rom_delay_us(us);
+    else
+        vTaskDelay(pdMS_TO_TICKS(us / 1000) + 1);
+}
+#else
+// I2C and SPI master drivers do not exist in host builds
+static esp_err_t cliBusHardwareOpen(cliBusType_t bus, const cliBusConfig_t *config){
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static void cliBusHardwareClose(cliBusType_t bus){
+}
+
+static esp_err_t cliBusHardwareRun(cliBusType_t bus, const cliBusOp_t *ops, int count){
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static void cliBusHardwareDelay(uint32_t us){
+    vTaskDelay(pdMS_TO_TICKS(us / 1000) + 1);
+}
+#endif
+
+// Register file of mock device of every bus, first written byte sets register pointer
+static struct{
+    uint8_t memory[256];
+    uint8_t pointer;
+}s_mock[CLI_BUS_COUNT];
+
+// Mock bus needs no pins
+static esp_err_t cliBusMockOpen(cliBusType_t bus, const cliBusConfig_t *config){
+    memset(&s_mock[bus], 0, sizeof(s_mock[bus]));
+    return ESP_OK;
+}
+
+static void cliBusMockClose(cliBusType_t bus){
+}
+
+// Writes register pointer and data to register file
+static void cliBusMockWrite(cliBusType_t bus, const uint8_t *data, size_t len){
+    if(len == 0)
+        return;
+    s_mock[bus].pointer = data[0];
+    for(size_t i = 1; i < len; i++)
+        s_mock[bus].memory[s_mock[bus].pointer++] = data[i];
+}
+
+// Reads register file from pointer, pointer wraps like in EEPROMs
+static void cliBusMockRead(cliBusType_t bus, uint8_t *data, size_t len){
+    for(size_t i = 0; i < len; i++)
+        data[i] = s_mock[bus].memory[s_mock[bus].pointer++];
+}
+
+// Runs a segment against register file, I2C devices other than mock address do not acknowledge
+static esp_err_t cliBusMockRun(cliBusType_t bus, const cliBusOp_t *ops, int count){
+    for(int i = 0; i < count; i++){
+        const cliBusOp_t *op = &ops[i];
+        if(bus == CLI_BUS_I2C && op->address != CLI_BUS_MOCK_ADDRESS)
+            return ESP_FAIL;
+        if(op->type == CLI_BUS_OP_EXCHANGE){
+            // SPI exchange is a loopback of MOSI to MISO
+            memcpy(op->rx, op->tx, op->txLen);
+            continue;
+        }
+        cliBusMockWrite(bus, op->tx, op->txLen);
+        cliBusMockRead(bus, op->rx, op->rxLen);
+    }
+    return ESP_OK;
+}
+
+// Mock delays are not waited, so benchmarks measure parsing, batching and encoding
+static void cliBusMockDelay(uint32_t us){
+}
+
+static const cliBusDriver_t s_hardware = { "hw", cliBusHardwareOpen, cliBusHardwareClose, cliBusHardwareRun, cliBusHardwareDelay };
+static const cliBusDriver_t s_mock_driver = { "mock", cliBusMockOpen, cliBusMockClose, cliBusMockRun, cliBusMockDelay };
+
+// Returns ESP-IDF driver
+const cliBusDriver_t *cliBusHardwareDriver(void){
+    return &s_hardware;
+}
+
+// Returns mock driver
+const cliBusDriver_t *cliBusMockDriver(void){
+    return &s_mock_driver;
+}
@@ -0,0 +1,268 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLICapture.c
+*/
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_intr_alloc.h"
+#include "driver/timer.h"
+#include "soc/soc.h"
+#include "soc/gpio_reg.h"
+
+#include "CLI.h"
+#include "CLISession.h"
+#include "CLIJob.h"
+#include "CLICapture.h"
+
+// TAG for capture log functions
+static const char *TAGCAPTURE = "Capture";
+
+// Double buffer which is filled by timer ISR
+static uint64_t s_buffer[2][CLI_CAPTURE_BUF_SAMPLES];
+// Valid sample count of a handed over buffer
+static volatile uint32_t s_length[2];
+// Set by ISR when buffer is handed over to task, cleared by task after encoding
+static volatile bool s_owned[2];
+// State shared with ISR
+static volatile uint8_t s_fill;
+static volatile uint32_t s_index;
+static volatile uint32_t s_taken;
+static volatile bool s_armed;
+static volatile bool s_stopped;
+static volatile bool s_overrun;
+static uint64_t s_mask;
+static uint64_t s_trigger_mask;
+static uint64_t s_last;
+static uint32_t s_limit;
+static cliCaptureTrigger_t s_trigger;
+static TaskHandle_t s_task;
+// Timer and buffers are used by one capture at a time
+static bool s_busy;
+// Encoded block buffer
+static uint8_t s_block[CLI_CAPTURE_BLOCK_SIZE];
+
+// Timer ISR, it reads both GPIO input registers at once
+static bool IRAM_ATTR cliCaptureIsr(void *arg){
+    if(s_stopped)
+        return false;
+    uint64_t level = (((uint64_t)(REG_READ(GPIO_IN1_REG) & 0xFF) << 32) | REG_READ(GPIO_IN_REG)) & s_mask;
+    // Wait for trigger edge before recording
+    if(s_armed){
+        bool wasHigh = (s_last & s_trigger_mask) != 0;
+        bool isHigh = (level & s_trigger_mask) != 0;
+        s_last = level;
+        if(s_trigger == CLI_CAPTURE_TRIGGER_RISING ? (wasHigh || !isHigh) : (!wasHigh || isHigh))
+            return false;
+        s_armed = false;
+    }
+
+    uint8_t fill = s_fill;
+    s_buffer[fill][s_index++] = level;
+    s_taken++;
+    if(s_index < CLI_CAPTURE_BUF_SAMPLES && s_taken < s_limit)
+        return false;
+
+    // Hand over the full buffer and continue with the other one
+    BaseType_t woken = pdFALSE;
+    s_length[fill] = s_index;
+    s_owned[fill] = true;
+    if(s_taken >= s_limit)
+        s_stopped = true;
+    else if(s_owned[fill ^ 1]){
+        // Task is still encoding the other half, samples would be lost from now on
+        s_overrun = true;
+        s_stopped = true;
+    }
+    else{
+        s_fill = fill ^ 1;
+        s_index = 0;
+    }
+    vTaskNotifyGiveFromISR(s_task, &woken);
+    return woken == pdTRUE;
+}
+
+// Appends LEB128 varint
+static size_t cliCaptureVarint(uint8_t *out, uint32_t value){
+    size_t len = 0;
+    do{
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        out[len++] = byte | (value ? 0x80 : 0);
+    }while(value);
+    return len;
+}
+
+// Packs levels of masked pins into consecutive bits
+static uint64_t cliCapturePack(uint64_t level){
+    uint64_t packed = 0;
+    uint8_t bit = 0;
+    for(uint8_t pin = 0; pin < 40; pin++){
+        if(!(s_mask & (1ULL << pin)))
+            continue;
+        if(level & (1ULL << pin))
+            packed |= 1ULL << bit;
+        bit++;
+    }
+    return packed;
+}
+
+// Writes little endian integer
+static void cliCapturePut(uint8_t *out, uint64_t value, size_t len){
+    for(size_t i = 0; i < len; i++)
+        out[i] = (value >> (8 * i)) & 0xFF;
+}
+
+// Writes a Block with given payload
+static void cliCaptureWriteBlock(uint32_t first, size_t payloadLen){
+    uint8_t header[8] = { 'C', 'B' };
+    cliCapturePut(header + 2, first, 4);
+    cliCapturePut(header + 6, payloadLen, 2);
+    cliSessionWrite((const char *)header, sizeof(header));
+    cliSessionWrite((const char *)s_block, payloadLen);
+}
+
+// Run length encodes one buffer, runs are split into several blocks when payload is full
+static void cliCaptureEncode(const uint64_t *samples, uint32_t count, uint32_t first, size_t valueBytes){
+    size_t len = 0;
+    uint32_t blockFirst = first;
+    uint32_t i = 0;
+    while(i < count){
+        uint64_t value = samples[i];
+        uint32_t run = 1;
+        while(i + run < count && samples[i + run] == value)
+            run++;
+        // Worst case of one run is 5 bytes varint and 5 bytes value
+        if(len + 5 + valueBytes > sizeof(s_block)){
+            cliCaptureWriteBlock(blockFirst, len);
+            blockFirst = first + i;
+            len = 0;
+        }
+        len += cliCaptureVarint(s_block + len, run);
+        cliCapturePut(s_block + len, cliCapturePack(value), valueBytes);
+        len += valueBytes;
+        i += run;
+    }
+    if(len > 0)
+        cliCaptureWriteBlock(blockFirst, len);
+}
+
+// Writes End block
+static void cliCaptureWriteEnd(uint32_t samples, cliCaptureStatus_t status){
+    uint8_t end[7] = { 'C', 'E' };
+    cliCapturePut(end + 2, samples, 4);
+    end[6] = status;
+    cliSessionWrite((const char *)end, sizeof(end));
+}
+
+// Starts timer ISR sampling and streams encoded buffers while next buffer is filled
+cliCaptureStatus_t cliCaptureRun(const cliCaptureConfig_t *config){
+    uint8_t bits = __builtin_popcountll(config->mask);
+    size_t valueBytes = (bits + 7) / 8;
+
+    s_busy = true;
+    // Header block
+    uint8_t header[20] = { 'C', 'H', CLI_CAPTURE_VERSION };
+    cliCapturePut(header + 3, config->mask, 8);
+    cliCapturePut(header + 11, config->periodUs, 4);
+    cliCapturePut(header + 15, config->samples, 4);
+    header[19] = bits;
+    cliSessionWrite((const char *)header, sizeof(header));
+
+    // Reset shared state before ISR is enabled
+    s_mask = config->mask;
+    s_trigger = config->trigger;
+    s_trigger_mask = 1ULL << config->triggerPin;
+    s_armed = config->trigger != CLI_CAPTURE_TRIGGER_NONE;
+    s_last = (((uint64_t)(REG_READ(GPIO_IN1_REG) & 0xFF) << 32) | REG_READ(GPIO_IN_REG)) & s_mask;
+    s_limit = config->samples;
+    s_fill = 0;
+    s_index = 0;
+    s_taken = 0;
+    s_owned[0] = s_owned[1] = false;
+    s_stopped = false;
+    s_overrun = false;
+    s_task = xTaskGetCurrentTaskHandle();
+    ulTaskNotifyTake(pdTRUE, 0);
+
+    // 80 MHz APB divided by 80 gives 1 us timer resolution
+    timer_config_t timerConfig = {
+        .divider = 80,
+        .counter_dir = TIMER_COUNT_UP,
+        .counter_en = TIMER_PAUSE,
+        .alarm_en = TIMER_ALARM_EN,
+        .auto_reload = TIMER_AUTORELOAD_EN,
+    };
+    if(timer_init(TIMER_GROUP_0, TIMER_0, &timerConfig) != ESP_OK){
+        ESP_LOGE(TAGCAPTURE, "Timer init fail!");
+        cliCaptureWriteEnd(0, CLI_CAPTURE_STATUS_ERROR);
+        s_busy = false;
+        return CLI_CAPTURE_STATUS_ERROR;
+    }
+    timer_set_counter_value(TIMER_GROUP_0, TIMER_0, 0);
+    timer_set_alarm_value(TIMER_GROUP_0, TIMER_0, config->periodUs);
+    timer_enable_intr(TIMER_GROUP_0, TIMER_0);
+    timer_isr_callback_add(TIMER_GROUP_0, TIMER_0, cliCaptureIsr, NULL, ESP_INTR_FLAG_IRAM);
+    timer_start(TIMER_GROUP_0, TIMER_0);
+
+    // Buffers are handed over in fill order, task wakes up periodically for job cancellation
+    cliCaptureStatus_t status = CLI_CAPTURE_STATUS_OK;
+    uint8_t read = 0;
+    uint32_t first = 0;
+    TickType_t bufferTime = pdMS_TO_TICKS((uint64_t)config->periodUs * CLI_CAPTURE_BUF_SAMPLES / 1000 + 1000);
+    TickType_t waited = 0;
+    bool armed = s_armed;
+    while(1){
+        if(armed != s_armed){
+            armed = s_armed;
+            waited = 0;
+        }
+        TickType_t limit = armed ? pdMS_TO_TICKS(CLI_CAPTURE_TRIGGER_TIMEOUT_MS) : bufferTime;
+        // Other tasks may run commands while capture waits for buffers
+        int depth = cliCommandUnlock();
+        uint32_t notified = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CLI_CAPTURE_POLL_MS));
+        cliCommandLock(depth);
+        if(notified == 0 && !s_owned[read]){
+            waited += pdMS_TO_TICKS(CLI_CAPTURE_POLL_MS);
+            if(waited >= limit){
+                status = s_armed ? CLI_CAPTURE_STATUS_TRIGGER_TIMEOUT : CLI_CAPTURE_STATUS_ERROR;
+                s_stopped = true;
+                break;
+            }
+        }
+        else
+            waited = 0;
+        while(s_owned[read]){
+            cliCaptureEncode(s_buffer[read], s_length[read], first, valueBytes);
+            first += s_length[read];
+            s_owned[read] = false;
+            read ^= 1;
+        }
+        if(s_stopped && !s_owned[read])
+            break;
+        if(cliJobCheckpoint()){
+            status = CLI_CAPTURE_STATUS_ABORTED;
+            s_stopped = true;
+            break;
+        }
+    }
+
+    timer_pause(TIMER_GROUP_0, TIMER_0);
+    timer_disable_intr(TIMER_GROUP_0, TIMER_0);
+    timer_isr_callback_remove(TIMER_GROUP_0, TIMER_0);
+    timer_deinit(TIMER_GROUP_0, TIMER_0);
+    if(s_overrun && status == CLI_CAPTURE_STATUS_OK)
+        status = CLI_CAPTURE_STATUS_OVERRUN;
+    s_busy = false;
+
+    cliCaptureWriteEnd(first, status);
+    return status;
+}
+
+// Returns true while a capture runs, a background capture may be running when another session asks
+bool cliCaptureIsBusy(void){
+    return s_busy;
+}
@@ -0,0 +1,61 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLICapture.h
+*/
+#ifndef _CLICAPTURE_H_
+#define _CLICAPTURE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Samples in one half of the double buffer
+#define CLI_CAPTURE_BUF_SAMPLES (1024)
+// Encoded block size which is written to the session at once
+#define CLI_CAPTURE_BLOCK_SIZE (1024)
+// Fastest sample period. Interrupt entry and timer driver dispatch take about 2 us of the core, so
+// at 20 us the ISR keeps about a tenth of it and Wi-Fi and the encoding task still run
+#define CLI_CAPTURE_MIN_PERIOD_US (20)
+// Time to wait for trigger condition
+#define CLI_CAPTURE_TRIGGER_TIMEOUT_MS (10000)
+// Longest time capture task sleeps, it checks job cancellation after that
+#define CLI_CAPTURE_POLL_MS (100)
+// Stream format version which is written in header block
+#define CLI_CAPTURE_VERSION (1)
+
+/* Capture stream is binary, all fields are little endian:
+ *   Header : 'C' 'H' | version (1) | pin mask (8) | period us (4) | sample limit (4) | bits per sample (1)
+ *   Block  : 'C' 'B' | first sample index (4) | payload length (2) | payload
+ *            payload is a list of runs: run length (LEB128 varint) | value ((bits + 7) / 8 bytes)
+ *            value bit n is the level of the n-th set pin of the mask, counting from GPIO0
+ *   End    : 'C' 'E' | captured samples (4) | status (1) */
+
+// Trigger edges
+typedef enum{
+    CLI_CAPTURE_TRIGGER_NONE = 0,
+    CLI_CAPTURE_TRIGGER_RISING,
+    CLI_CAPTURE_TRIGGER_FALLING
+}cliCaptureTrigger_t;
+
+// Status of End block
+typedef enum{
+    CLI_CAPTURE_STATUS_OK = 0,
+    CLI_CAPTURE_STATUS_OVERRUN,
+    CLI_CAPTURE_STATUS_TRIGGER_TIMEOUT,
+    CLI_CAPTURE_STATUS_ERROR,
+    CLI_CAPTURE_STATUS_ABORTED
+}cliCaptureStatus_t;
+
+// Capture configuration
+typedef struct{
+    uint64_t mask;
+    uint32_t periodUs;
+    uint32_t samples;
+    uint8_t triggerPin;
+    cliCaptureTrigger_t trigger;
+}cliCaptureConfig_t;
+
+cliCaptureStatus_t cliCaptureRun(const cliCaptureConfig_t*);
+bool cliCaptureIsBusy(void);
+
+#endif
@@ -0,0 +1,199 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLIConfig.c
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_event.h"
+#include "nvs.h"
+
+#include "CLI.h"
+#include "CLISocket.h"
+#include "CLISession.h"
+#include "CLIUart.h"
+#include "CLIUdp.h"
+#include "CLIConfig.h"
+
+// TAG for config log functions
+static const char *TAGCONFIG = "Config";
+
+// Schema, compile time macros are the defaults
+static const cliConfigSchema_t s_schema[CLI_CONFIG_COUNT] = {
+    [CLI_CONFIG_WIFI_SSID]     = { "wifi_ssid", CLI_CONFIG_TYPE_STR, CLI_CONFIG_APPLY_RESTART, 1, 32, 0, ESP_WIFI_SSID, false, "Wi-Fi network name" },
+    [CLI_CONFIG_WIFI_PASS]     = { "wifi_pass", CLI_CONFIG_TYPE_STR, CLI_CONFIG_APPLY_RESTART, 8, 63, 0, ESP_WIFI_PASS, true, "Wi-Fi WPA2 password, empty for an open network" },
+    [CLI_CONFIG_WIFI_RETRY]    = { "wifi_retry", CLI_CONFIG_TYPE_U32, CLI_CONFIG_APPLY_NOW, 0, 1000, ESP_MAXIMUM_RETRY, NULL, false, "Wi-Fi connect retries" },
+    [CLI_CONFIG_TCP_PORT]      = { "tcp_port", CLI_CONFIG_TYPE_U32, CLI_CONFIG_APPLY_RESTART, 1, 65535, PORT, NULL, false, "TCP server port" },
+    [CLI_CONFIG_UDP_PORT]      = { "udp_port", CLI_CONFIG_TYPE_U32, CLI_CONFIG_APPLY_RESTART, 1, 65535, CLI_UDP_PORT, NULL, false, "UDP command port" },
+    [CLI_CONFIG_MAX_CLIENTS]   = { "max_clients", CLI_CONFIG_TYPE_U32, CLI_CONFIG_APPLY_NOW, 1, CLI_SOCKET_MAX_CLIENTS, CLI_SOCKET_MAX_CLIENTS, NULL, false, "TCP clients served at once" },
+    [CLI_CONFIG_DRR_QUANTUM]   = { "drr_quantum", CLI_CONFIG_TYPE_U32, CLI_CONFIG_APPLY_NOW, 64, 65536, CLI_SOCKET_DRR_QUANTUM, NULL, false, "Response bytes of a client in one round" },
+    [CLI_CONFIG_TX_COALESCE]   = { "tx_coalesce", CLI_CONFIG_TYPE_U32, CLI_CONFIG_APPLY_SESSION, 64, CLI_SESSION_MSS, CLI_SESSION_MSS, NULL, false, "TCP output coalesced before a send" },
+    [CLI_CONFIG_FLUSH_TIMER]   = { "flush_timer", CLI_CONFIG_TYPE_U32, CLI_CONFIG_APPLY_SESSION, 1, 1000, CLI_SESSION_FLUSH_TIMER_MS, NULL, false, "Flush timer of throughput policy in ms" },
+    [CLI_CONFIG_RATE_COMMANDS] = { "rate_cmds", CLI_CONFIG_TYPE_U32, CLI_CONFIG_APPLY_SESSION, 0, 10000, CLI_SESSION_RATE_COMMANDS, NULL, false, "Commands per second, 0 is unlimited" },
+    [CLI_CONFIG_RATE_BYTES]    = { "rate_bytes", CLI_CONFIG_TYPE_U32, CLI_CONFIG_APPLY_SESSION, 0, 10000000, CLI_SESSION_RATE_BYTES, NULL, false, "Output bytes per second, 0 is unlimited" },
+    [CLI_CONFIG_UART_BAUD]     = { "uart_baud", CLI_CONFIG_TYPE_U32, CLI_CONFIG_APPLY_CONFIRM, UART_BAUD_MIN, UART_BAUD_MAX, UART_BAUD_RATE, NULL, false, "Serial console baud rate" },
+    [CLI_CONFIG_UART_RX_BUF]   = { "uart_rx_buf", CLI_CONFIG_TYPE_U32, CLI_CONFIG_APPLY_RESTART, 256, 16384, UART_READ_BUF_SIZE, NULL, false, "UART driver RX buffer size" },
+    [CLI_CONFIG_HISTORY_LEN]   = { "history_len", CLI_CONFIG_TYPE_U32, CLI_CONFIG_APPLY_NOW, 1, 1000, CLI_HISTORY_LEN, NULL, false, "Command history length" }
+};
+
+// Cached values, indexed by key
+static struct{
+    uint32_t value;
+    char string[CLI_CONFIG_STR_SIZE];
+    bool dirty;                         // RAM value is not committed yet
+}s_values[CLI_CONFIG_COUNT];
+
+// Sets cached value to default
+static void cliConfigDefault(cliConfigKey_t key){
+    const cliConfigSchema_t *schema = &s_schema[key];
+    if(schema->type == CLI_CONFIG_TYPE_STR)
+        strlcpy(s_values[key].string, schema->defaultString, sizeof(s_values[key].string));
+    else
+        s_values[key].value = schema->defaultValue;
+}
+
+// Loads stored values, missing or invalid ones keep their defaults
+void cliConfigInit(void){
+    for(int key = 0; key < CLI_CONFIG_COUNT; key++)
+        cliConfigDefault(key);
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(CLI_CONFIG_NAMESPACE, NVS_READONLY, &handle);
+    if(err != ESP_OK){
+        // Namespace does not exist until first commit
+        if(err != ESP_ERR_NVS_NOT_FOUND)
+            ESP_LOGE(TAGCONFIG, "Unable to open NVS: %s", esp_err_to_name(err));
+        return;
+    }
+    for(int key = 0; key < CLI_CONFIG_COUNT; key++){
+        const cliConfigSchema_t *schema = &s_schema[key];
+        char text[CLI_CONFIG_STR_SIZE];
+        if(schema->type == CLI_CONFIG_TYPE_STR){
+            size_t len = sizeof(text);
+            err = nvs_get_str(handle, schema->name, text, &len);
+        }
+        else{
+            uint32_t value = 0;
+            err = nvs_get_u32(handle, schema->name, &value);
+            snprintf(text, sizeof(text), "%u", value);
+        }
+        if(err == ESP_ERR_NVS_NOT_FOUND)
+            continue;
+        if(err != ESP_OK || cliConfigSet(key, text) != CLI_CONFIG_OK)
+            ESP_LOGW(TAGCONFIG, "Stored %s is invalid, default is used", schema->name);
+        s_values[key].dirty = false;
+    }
+    nvs_close(handle);
+}
+
+// Returns key of a name, or -1
+int cliConfigFind(const char *name){
+    for(int key = 0; key < CLI_CONFIG_COUNT; key++){
+        if(strcmp(s_schema[key].name, name) == 0)
+            return key;
+    }
+    return -1;
+}
+
+// Returns schema of a key
+const cliConfigSchema_t *cliConfigSchema(cliConfigKey_t key){
+    return &s_schema[key];
+}
+
+// Returns a number value
+uint32_t cliConfigGet(cliConfigKey_t key){
+    return s_values[key].value;
+}
+
+// Returns a string value
+const char *cliConfigGetString(cliConfigKey_t key){
+    return s_values[key].string;
+}
+
+// Validates a value against schema without storing it
+cliConfigResult_t cliConfigCheck(cliConfigKey_t key, const char *text){
+    if((int)key < 0 || key >= CLI_CONFIG_COUNT)
+        return CLI_CONFIG_UNKNOWN_KEY;
+    const cliConfigSchema_t *schema = &s_schema[key];
+    if(schema->type == CLI_CONFIG_TYPE_STR){
+        size_t len = strlen(text);
+        // Open network has no password
+        if(key == CLI_CONFIG_WIFI_PASS && len == 0)
+            return CLI_CONFIG_OK;
+        return len < schema->min || len > schema->max ? CLI_CONFIG_OUT_OF_RANGE : CLI_CONFIG_OK;
+    }
+    char *end;
+    unsigned long value = strtoul(text, &end, 0);
+    if(*text == 0 || *text == '-' || *end != 0)
+        return CLI_CONFIG_NOT_NUMBER;
+    return value < schema->min || value > schema->max ? CLI_CONFIG_OUT_OF_RANGE : CLI_CONFIG_OK;
+}
+
+// Validates and stores a value in RAM, it is written to NVS by cliConfigCommit
+cliConfigResult_t cliConfigSet(cliConfigKey_t key, const char *text){
+    cliConfigResult_t result = cliConfigCheck(key, text);
+    if(result != CLI_CONFIG_OK)
+        return result;
+    if(s_schema[key].type == CLI_CONFIG_TYPE_STR)
+        strlcpy(s_values[key].string, text, sizeof(s_values[key].string));
+    else
+        s_values[key].value = strtoul(text, NULL, 0);
+    s_values[key].dirty = true;
+    return CLI_CONFIG_OK;
+}
+
+// Restores default value, stored value is erased by next commit
+void cliConfigReset(cliConfigKey_t key){
+    cliConfigDefault(key);
+    s_values[key].dirty = true;
+}
+
+// Returns true if value is changed after last commit
+bool cliConfigIsDirty(cliConfigKey_t key){
+    return s_values[key].dirty;
+}
+
+// Writes changed values to NVS
+esp_err_t cliConfigCommit(void){
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(CLI_CONFIG_NAMESPACE, NVS_READWRITE, &handle);
+    if(err != ESP_OK)
+        return err;
+    for(int key = 0; key < CLI_CONFIG_COUNT && err == ESP_OK; key++){
+        const cliConfigSchema_t *schema = &s_schema[key];
+        if(!s_values[key].dirty)
+            continue;
+        bool isDefault = schema->type == CLI_CONFIG_TYPE_STR ? strcmp(s_values[key].string, schema->defaultString) == 0
+                                                             : s_values[key].value == schema->defaultValue;
+        if(isDefault){
+            err = nvs_erase_key(handle, schema->name);
+            if(err == ESP_ERR_NVS_NOT_FOUND)
+                err = ESP_OK;
+        }
+        else if(schema->type == CLI_CONFIG_TYPE_STR)
+            err = nvs_set_str(handle, schema->name, s_values[key].string);
+        else
+            err = nvs_set_u32(handle, schema->name, s_values[key].value);
+    }
+    if(err == ESP_OK)
+        err = nvs_commit(handle);
+    nvs_close(handle);
+    if(err != ESP_OK){
+        ESP_LOGE(TAGCONFIG, "Unable to commit: %s", esp_err_to_name(err));
+        return err;
+    }
+    for(int key = 0; key < CLI_CONFIG_COUNT; key++)
+        s_values[key].dirty = false;
+    return ESP_OK;
+}
+
+// Returns name of an apply class
+const char *cliConfigApplyName(cliConfigApply_t apply){
+    switch(apply){
+        case CLI_CONFIG_APPLY_NOW:     return "now";
+        case CLI_CONFIG_APPLY_SESSION: return "session";
+        case CLI_CONFIG_APPLY_CONFIRM: return "confirm";
+        default:                       return "restart";
+    }
+}
@@ -0,0 +1,88 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLIConfig.h
+*/
+#ifndef _CLICONFIG_H_
+#define _CLICONFIG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// NVS namespace of stored configuration
+#define CLI_CONFIG_NAMESPACE "cli_config"
+// String value size with terminator, Wi-Fi password is the longest one
+#define CLI_CONFIG_STR_SIZE (64)
+
+/* Values are loaded from NVS once at boot into a RAM table which is indexed by key, so getters never
+ * touch flash. 'config set' changes RAM only, 'config commit' writes changed values to NVS. A key
+ * which has its default value is erased from NVS, so new firmware defaults reach it. */
+
+// Value types
+typedef enum{
+    CLI_CONFIG_TYPE_U32 = 0,
+    CLI_CONFIG_TYPE_STR
+}cliConfigType_t;
+
+// When a new value takes effect
+typedef enum{
+    CLI_CONFIG_APPLY_NOW = 0,           // Next use of the value
+    CLI_CONFIG_APPLY_SESSION,           // Sessions which are opened later
+    CLI_CONFIG_APPLY_CONFIRM,           // After the peer confirms it, e.g. baud rate
+    CLI_CONFIG_APPLY_RESTART            // After restart, it must be committed
+}cliConfigApply_t;
+
+// Configuration keys, they index the schema
+typedef enum{
+    CLI_CONFIG_WIFI_SSID = 0,
+    CLI_CONFIG_WIFI_PASS,
+    CLI_CONFIG_WIFI_RETRY,
+    CLI_CONFIG_TCP_PORT,
+    CLI_CONFIG_UDP_PORT,
+    CLI_CONFIG_MAX_CLIENTS,
+    CLI_CONFIG_DRR_QUANTUM,
+    CLI_CONFIG_TX_COALESCE,
+    CLI_CONFIG_FLUSH_TIMER,
+    CLI_CONFIG_RATE_COMMANDS,
+    CLI_CONFIG_RATE_BYTES,
+    CLI_CONFIG_UART_BAUD,
+    CLI_CONFIG_UART_RX_BUF,
+    CLI_CONFIG_HISTORY_LEN,
+    CLI_CONFIG_COUNT
+}cliConfigKey_t;
+
+// Schema of a key, range is value range for numbers and length range for strings
+typedef struct{
+    const char *name;                   // Also NVS key, at most 15 characters
+    cliConfigType_t type;
+    cliConfigApply_t apply;
+    uint32_t min;
+    uint32_t max;
+    uint32_t defaultValue;
+    const char *defaultString;
+    bool secret;                        // Value is never printed
+    const char *help;
+}cliConfigSchema_t;
+
+// Results of setting a value
+typedef enum{
+    CLI_CONFIG_OK = 0,
+    CLI_CONFIG_UNKNOWN_KEY,
+    CLI_CONFIG_NOT_NUMBER,
+    CLI_CONFIG_OUT_OF_RANGE
+}cliConfigResult_t;
+
+void cliConfigInit(void);
+int cliConfigFind(const char*);
+const cliConfigSchema_t *cliConfigSchema(cliConfigKey_t);
+uint32_t cliConfigGet(cliConfigKey_t);
+const char *cliConfigGetString(cliConfigKey_t);
+cliConfigResult_t cliConfigCheck(cliConfigKey_t, const char*);
+cliConfigResult_t cliConfigSet(cliConfigKey_t, const char*);
+void cliConfigReset(cliConfigKey_t);
+bool cliConfigIsDirty(cliConfigKey_t);
+esp_err_t cliConfigCommit(void);
+const char *cliConfigApplyName(cliConfigApply_t);
+
+#endif
@@ -0,0 +1,289 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLIFrame.c
+*/
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_console.h"
+#include "driver/uart.h"
+
+#include "CLI.h"
+#include "CLIUart.h"
+#include "CLISession.h"
+#include "CLIFrame.h"
+#include "CLIJson.h"
+#include "CLIRecord.h"
+
+// Set by 'framed' command, cli_task enters framed mode after the command returns
+static bool s_requested = false;
+// Cleared by EXIT frame
+static bool s_active = false;
+// Frames are written by console task and by tasks which send events
+static SemaphoreHandle_t s_tx_lock;
+// Framed mode statistics
+static cliFrameStats_t s_stats;
+// CRC-16/CCITT nibble table, polynomial 0x1021
+static const uint16_t s_crc_table[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+    0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef
+};
+
+// Log output of framed mode, it is swallowed
+static int cliFrameLogMute(const char *fmt, va_list args){
+    return 0;
+}
+
+// COBS encoder, out must have room for len + len / 254 + 1 bytes. Returns encoded length without delimiter
+size_t cliFrameCobsEncode(const uint8_t *in, size_t len, uint8_t *out){
+    size_t codeIndex = 0;
+    size_t outIndex = 1;
+    uint8_t code = 1;
+    for(size_t i = 0; i < len; i++){
+        if(in[i] == 0){
+            out[codeIndex] = code;
+            code = 1;
+            codeIndex = outIndex++;
+            continue;
+        }
+        out[outIndex++] = in[i];
+        code++;
+        if(code == 0xFF){
+            out[codeIndex] = code;
+            code = 1;
+            codeIndex = outIndex++;
+        }
+    }
+    out[codeIndex] = code;
+    return outIndex;
+}
+
+// COBS decoder, out must have room for len bytes. Returns decoded length or -1 on malformed input
+int cliFrameCobsDecode(const uint8_t *in, size_t len, uint8_t *out){
+    size_t i = 0;
+    size_t o = 0;
+    while(i < len){
+        uint8_t code = in[i++];
+        if(code == 0)
+            return -1;
+        for(uint8_t j = 1; j < code; j++){
+            if(i >= len)
+                return -1;
+            out[o++] = in[i++];
+        }
+        if(code != 0xFF && i < len)
+            out[o++] = 0;
+    }
+    return o;
+}
+
+// CRC-16/CCITT-FALSE, initial value 0xFFFF
+uint16_t cliFrameCrc16(const uint8_t *data, size_t len){
+    uint16_t crc = 0xFFFF;
+    for(size_t i = 0; i < len; i++){
+        crc = (uint16_t)(crc << 4) ^ s_crc_table[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (uint16_t)(crc << 4) ^ s_crc_table[(crc >> 12) ^ (data[i] & 0x0F)];
+    }
+    return crc;
+}
+
+// Builds, encodes and writes one frame. Prefix is placed before data, it is used for status byte
+static void cliFrameSendParts(cliFrameType_t type, uint16_t seq, const uint8_t *prefix, size_t prefixLen, const uint8_t *data, size_t len){
+    static uint8_t raw[CLI_FRAME_MAX_LEN];
+    static uint8_t encoded[CLI_FRAME_MAX_ENCODED_LEN];
+    if(prefixLen + len > CLI_FRAME_MAX_DATA + 1)
+        len = CLI_FRAME_MAX_DATA + 1 - prefixLen;
+
+    xSemaphoreTake(s_tx_lock, portMAX_DELAY);
+    size_t rawLen = 0;
+    raw[rawLen++] = type;
+    raw[rawLen++] = seq & 0xFF;
+    raw[rawLen++] = seq >> 8;
+    if(prefixLen > 0){
+        memcpy(raw + rawLen, prefix, prefixLen);
+        rawLen += prefixLen;
+    }
+    if(len > 0){
+        memcpy(raw + rawLen, data, len);
+        rawLen += len;
+    }
+    uint16_t crc = cliFrameCrc16(raw, rawLen);
+    raw[rawLen++] = crc & 0xFF;
+    raw[rawLen++] = crc >> 8;
+
+    // Leading delimiter ends any bytes which are written to UART outside of frames
+    encoded[0] = 0;
+    size_t encodedLen = cliFrameCobsEncode(raw, rawLen, encoded + 1) + 1;
+    encoded[encodedLen++] = 0;
+    // Driver is used directly, VFS would translate line endings inside binary data
+    uart_write_bytes(UART_PORT, (const char *)encoded, encodedLen);
+    s_stats.txFrames++;
+    xSemaphoreGive(s_tx_lock);
+}
+
+// Sends one frame with given type and sequence
+void cliFrameSend(cliFrameType_t type, uint16_t seq, const uint8_t *data, size_t len){
+    cliFrameSendParts(type, seq, NULL, 0, data, len);
+}
+
+// Sends output of another task as EVENT frames
+void cliFrameSendEvent(const char *data, size_t len){
+    do{
+        size_t part = len < CLI_FRAME_MAX_DATA ? len : CLI_FRAME_MAX_DATA;
+        cliFrameSend(CLI_FRAME_EVENT, 0, (const uint8_t *)data, part);
+        data += part;
+        len -= part;
+    }while(len > 0);
+}
+
+// Sends last frame of a response with its status and remaining output of the session
+static void cliFrameFinish(cliSession_t *session, uint16_t seq, cliFrameStatus_t status){
+    uint8_t statusByte = status;
+    cliFrameSendParts(CLI_FRAME_RESPONSE, seq, &statusByte, 1, (const uint8_t *)session->txBuffer, session->txLen);
+    session->txLen = 0;
+}
+
+// Runs a command line which is received in a REQUEST frame
+static void cliFrameRunCommand(cliSession_t *session, uint16_t seq, char *line){
+    int ret = 0;
+    session->frameSeq = seq;
+    bool recording = cliRecordBegin(session, line);
+    esp_err_t err = cliRunCommand(session, line, &ret);
+    // Frame status tells the result, JSON sessions get it in the response too
+    cliJsonFinishResponse(session, err, ret);
+    if(recording)
+        cliRecordEnd(err, ret);
+    session->stats.commands++;
+
+    cliFrameStatus_t status;
+    if(err == ESP_ERR_NOT_FOUND)
+        status = CLI_FRAME_STATUS_NOT_FOUND;
+    else if(err == ESP_ERR_INVALID_ARG)
+        status = CLI_FRAME_STATUS_EMPTY;
+    else if(err != ESP_OK)
+        status = CLI_FRAME_STATUS_INTERNAL;
+    else if(ret != 0)
+        status = CLI_FRAME_STATUS_FAILED;
+    else
+        status = CLI_FRAME_STATUS_OK;
+    cliFrameFinish(session, seq, status);
+}
+
+// Decodes and dispatches one received frame
+static void cliFrameProcess(cliSession_t *session, const uint8_t *encoded, size_t len, uint8_t *frame){
+    int frameLen = cliFrameCobsDecode(encoded, len, frame);
+    if(frameLen < CLI_FRAME_HEADER_LEN + CLI_FRAME_CRC_LEN || frameLen > CLI_FRAME_MAX_LEN){
+        s_stats.lengthErrors++;
+        cliFrameSend(CLI_FRAME_NAK, 0, NULL, 0);
+        return;
+    }
+    uint16_t seq = frame[1] | (frame[2] << 8);
+    uint16_t crc = frame[frameLen - 2] | (frame[frameLen - 1] << 8);
+    if(crc != cliFrameCrc16(frame, frameLen - CLI_FRAME_CRC_LEN)){
+        // Sequence may be corrupted too, host matches it only if it is one of its in-flight requests
+        s_stats.crcErrors++;
+        cliFrameSend(CLI_FRAME_NAK, seq, NULL, 0);
+        return;
+    }
+    s_stats.rxFrames++;
+
+    char *data = (char *)frame + CLI_FRAME_HEADER_LEN;
+    size_t dataLen = frameLen - CLI_FRAME_HEADER_LEN - CLI_FRAME_CRC_LEN;
+    switch(frame[0]){
+        case CLI_FRAME_REQUEST:
+            // CRC is already checked, its place is used for terminator
+            data[dataLen] = 0;
+            cliFrameRunCommand(session, seq, data);
+            break;
+        case CLI_FRAME_PING:
+            cliFrameSend(CLI_FRAME_PONG, seq, NULL, 0);
+            break;
+        case CLI_FRAME_EXIT:
+            cliFrameFinish(session, seq, CLI_FRAME_STATUS_OK);
+            s_active = false;
+            break;
+        default:
+            cliFrameSend(CLI_FRAME_NAK, seq, NULL, 0);
+            break;
+    }
+}
+
+// Requests framed mode, it is entered after the running command returns
+void cliFrameRequest(void){
+    s_requested = true;
+}
+
+// Returns true if framed mode is requested
+bool cliFrameIsRequested(void){
+    return s_requested;
+}
+
+// Returns true while framed mode runs
+bool cliFrameIsActive(void){
+    return s_active;
+}
+
+// Returns framed mode statistics
+const cliFrameStats_t *cliFrameGetStats(void){
+    return &s_stats;
+}
+
+// Framed mode loop, it replaces linenoise until an EXIT frame is received
+void cliFrameRun(void){
+    static uint8_t rx[CLI_FRAME_MAX_ENCODED_LEN];
+    static uint8_t frame[CLI_FRAME_MAX_ENCODED_LEN];
+    uint8_t chunk[128];
+    size_t rxLen = 0;
+    bool overflow = false;
+
+    s_requested = false;
+    cliSession_t *previous = cliSessionGetCurrent();
+    cliSession_t *session = cliSessionOpen(CLI_SESSION_FRAME, -1);
+    if(session == NULL)
+        return;
+    cliSessionSetCurrent(session);
+    if(s_tx_lock == NULL)
+        s_tx_lock = xSemaphoreCreateMutex();
+    // Log lines would be interleaved with frames and waste link time, they are swallowed instead of
+    // lowering levels, so per tag levels set at runtime are kept. Output of jobs and 'every' for the
+    // console is sent as EVENT frames by cliSessionEventEnd()
+    vprintf_like_t previousLog = esp_log_set_vprintf(cliFrameLogMute);
+    uart_flush_input(UART_PORT);
+    s_active = true;
+
+    while(s_active){
+        size_t available = 0;
+        uart_get_buffered_data_len(UART_PORT, &available);
+        if(available == 0){
+            cliUartWaitData(CLI_FRAME_IDLE_MS);
+            continue;
+        }
+        int len = uart_read_bytes(UART_PORT, chunk, available < sizeof(chunk) ? available : sizeof(chunk), 0);
+        for(int i = 0; i < len && s_active; i++){
+            if(chunk[i] != 0){
+                if(rxLen < sizeof(rx))
+                    rx[rxLen++] = chunk[i];
+                else
+                    overflow = true;
+                continue;
+            }
+            // Delimiter, empty frames are used by hosts for resynchronization
+            if(overflow){
+                s_stats.lengthErrors++;
+                cliFrameSend(CLI_FRAME_NAK, 0, NULL, 0);
+            }
+            else if(rxLen > 0)
+                cliFrameProcess(session, rx, rxLen, frame);
+            rxLen = 0;
+            overflow = false;
+        }
+    }
+
+    esp_log_set_vprintf(previousLog);
+    cliSessionClose(session);
+    cliSessionSetCurrent(previous);
+}
@@ -0,0 +1,70 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLIFrame.h
+*/
+#ifndef _CLIFRAME_H_
+#define _CLIFRAME_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Framed machine mode for UART. Every frame is COBS encoded, preceded and terminated by a 0x00 byte, so
+ * stray bytes which come before a frame are a separate broken frame instead of a part of it.
+ * Decoded frame layout (little endian):
+ *   | type (1) | sequence (2) | data (0..CLI_FRAME_MAX_DATA) | CRC-16/CCITT of previous bytes (2) |
+ * Host may send several requests without waiting, responses carry the sequence of their request.
+ * A response longer than one frame is sent as RESPONSE_MORE frames followed by a RESPONSE frame
+ * whose first data byte is the status of the command. */
+#define CLI_FRAME_MAX_DATA   (1436)
+#define CLI_FRAME_HEADER_LEN (3)
+#define CLI_FRAME_CRC_LEN    (2)
+#define CLI_FRAME_MAX_LEN    (CLI_FRAME_HEADER_LEN + 1 + CLI_FRAME_MAX_DATA + CLI_FRAME_CRC_LEN)
+// COBS adds one byte for every 254 bytes and the delimiters before and after the frame
+#define CLI_FRAME_MAX_ENCODED_LEN (CLI_FRAME_MAX_LEN + CLI_FRAME_MAX_LEN / 254 + 3)
+// Receive wait time, framed loop checks for exit request at this period
+#define CLI_FRAME_IDLE_MS (100)
+
+// Frame types
+typedef enum{
+    CLI_FRAME_REQUEST = 0x01,       // Host -> ESP32, data is a command line
+    CLI_FRAME_RESPONSE = 0x02,      // ESP32 -> Host, status byte + last part of output
+    CLI_FRAME_RESPONSE_MORE = 0x03, // ESP32 -> Host, part of output, more frames follow
+    CLI_FRAME_NAK = 0x04,           // ESP32 -> Host, frame is dropped because of CRC or length error
+    CLI_FRAME_PING = 0x05,          // Host -> ESP32, answered with PONG of same sequence
+    CLI_FRAME_PONG = 0x06,
+    CLI_FRAME_EXIT = 0x07,          // Host -> ESP32, leave framed mode, answered with RESPONSE
+    CLI_FRAME_EVENT = 0x08          // ESP32 -> Host, job notice or 'every' push, sequence 0. It may come
+                                    // between frames of a response, a long event spans several frames
+}cliFrameType_t;
+
+// Status byte of a RESPONSE frame
+typedef enum{
+    CLI_FRAME_STATUS_OK = 0,
+    CLI_FRAME_STATUS_NOT_FOUND,
+    CLI_FRAME_STATUS_EMPTY,
+    CLI_FRAME_STATUS_FAILED,
+    CLI_FRAME_STATUS_INTERNAL
+}cliFrameStatus_t;
+
+// Framed mode statistics
+typedef struct{
+    uint32_t rxFrames;
+    uint32_t txFrames;
+    uint32_t crcErrors;
+    uint32_t lengthErrors;
+}cliFrameStats_t;
+
+size_t cliFrameCobsEncode(const uint8_t*, size_t, uint8_t*);
+int cliFrameCobsDecode(const uint8_t*, size_t, uint8_t*);
+uint16_t cliFrameCrc16(const uint8_t*, size_t);
+void cliFrameSend(cliFrameType_t, uint16_t, const uint8_t*, size_t);
+void cliFrameRequest(void);
+bool cliFrameIsRequested(void);
+void cliFrameRun(void);
+bool cliFrameIsActive(void);
+void cliFrameSendEvent(const char*, size_t);
+const cliFrameStats_t *cliFrameGetStats(void);
+
+#endif
@@ -0,0 +1,216 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLIGpio.c
+*/
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "esp_timer.h"
+#include "soc/soc.h"
+#include "soc/gpio_reg.h"
+#include "soc/io_mux_reg.h"
+#include "soc/gpio_periph.h"
+
+#include "CLISession.h"
+#include "CLIBoard.h"
+#include "CLIGpio.h"
+
+/* Pin levels are read from hardware at most once in a window and shared by all readers together with
+ * the formatted table. Snapshot is protected by a sequence counter: writer makes it odd while it
+ * updates the snapshot, readers copy the snapshot and retry if counter is changed meanwhile. Readers
+ * never block, and a writer which finds another writer busy reads hardware for itself. */
+
+// Shared snapshot
+typedef struct{
+    uint64_t levels;
+    int64_t stamp;
+    uint32_t epoch;
+    size_t len;
+    char text[CLI_GPIO_TABLE_SIZE];
+}cliGpioSnapshot_t;
+
+static cliGpioSnapshot_t s_snapshot;
+// Sequence counter of snapshot, odd while it is written
+static volatile uint32_t s_seq;
+// Incremented by pin writes, a snapshot of an older epoch is stale
+static volatile uint32_t s_epoch = 1;
+static uint32_t s_window = CLI_GPIO_CACHE_WINDOW_US;
+static cliGpioStats_t s_stats;
+// Peripheral which drives every pin, it is changed by serialized commands only
+static uint8_t s_owner[CLI_BOARD_MAX_PIN + 1];
+
+// Reads both input registers at once
+static uint64_t cliGpioReadHardware(void){
+    return ((uint64_t)(REG_READ(GPIO_IN1_REG) & 0xFF) << 32) | REG_READ(GPIO_IN_REG);
+}
+
+// Formats 'read_gpio -a' table
+static size_t cliGpioFormat(char *text, uint64_t levels){
+    size_t len = snprintf(text, CLI_GPIO_TABLE_SIZE, "\n------------------\n"
+                                                     "|GPIO_PIN | STATUS|"
+                                                     "\n------------------\n");
+    uint64_t valid = cliBoardAllowed(CLI_BOARD_USE_READ);
+    for(uint8_t i = 0; i <= CLI_BOARD_MAX_PIN; i++){
+        if(!(valid & (1ULL << i)))
+            continue;
+        const char *level = (levels & (1ULL << i)) ? "HIGH" : "LOW";
+        if(s_owner[i] != CLI_GPIO_OWNER_NONE)
+            len += snprintf(text + len, CLI_GPIO_TABLE_SIZE - len, "Pin-%d :  %s (%s)\n", i, level, cliGpioOwnerName(s_owner[i]));
+        else
+            len += snprintf(text + len, CLI_GPIO_TABLE_SIZE - len, "Pin-%d :  %s\n", i, level);
+    }
+    len += snprintf(text + len, CLI_GPIO_TABLE_SIZE - len, "----------------------\n");
+    return len;
+}
+
+// Copies snapshot if it is consistent and, when asked, fresh. Text is copied too if it is not NULL
+static bool cliGpioLoad(uint64_t *levels, char *text, size_t *len, bool fresh){
+    for(int i = 0; i < CLI_GPIO_READ_RETRIES; i++){
+        uint32_t seq = __atomic_load_n(&s_seq, __ATOMIC_ACQUIRE);
+        if(seq & 1){
+            s_stats.retries++;
+            continue;
+        }
+        if(fresh && (s_snapshot.epoch != s_epoch || esp_timer_get_time() - s_snapshot.stamp > s_window))
+            return false;
+        *levels = s_snapshot.levels;
+        if(text != NULL){
+            *len = s_snapshot.len;
+            memcpy(text, s_snapshot.text, *len);
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(__atomic_load_n(&s_seq, __ATOMIC_RELAXED) == seq)
+            return true;
+        s_stats.retries++;
+    }
+    return false;
+}
+
+// Reads hardware into snapshot, returns false if another writer is busy
+static bool cliGpioRefresh(void){
+    uint32_t seq = __atomic_load_n(&s_seq, __ATOMIC_RELAXED);
+    if((seq & 1) || !__atomic_compare_exchange_n(&s_seq, &seq, seq + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return false;
+    // Epoch is taken before hardware is read, so a write meanwhile makes this snapshot stale
+    s_snapshot.epoch = s_epoch;
+    s_snapshot.levels = cliGpioReadHardware();
+    s_snapshot.stamp = esp_timer_get_time();
+    s_snapshot.len = cliGpioFormat(s_snapshot.text, s_snapshot.levels);
+    __atomic_store_n(&s_seq, seq + 2, __ATOMIC_RELEASE);
+    s_stats.refreshes++;
+    return true;
+}
+
+// Gets levels and optionally table from snapshot, it is refreshed when stale
+static void cliGpioSnapshot(uint64_t *levels, char *text, size_t *len){
+    if(cliGpioLoad(levels, text, len, true)){
+        s_stats.hits++;
+        return;
+    }
+    if(cliGpioRefresh() && cliGpioLoad(levels, text, len, false))
+        return;
+    // Snapshot is busy, caller reads hardware by itself
+    s_stats.direct++;
+    *levels = cliGpioReadHardware();
+    if(text != NULL)
+        *len = cliGpioFormat(text, *levels);
+}
+
+// Returns levels of all pins, bit n is GPIOn
+uint64_t cliGpioReadAll(void){
+    uint64_t levels;
+    cliGpioSnapshot(&levels, NULL, NULL);
+    return levels;
+}
+
+// Writes 'read_gpio -a' table to current session
+void cliGpioPrintTable(void){
+    char text[CLI_GPIO_TABLE_SIZE];
+    uint64_t levels;
+    size_t len;
+    cliGpioSnapshot(&levels, text, &len);
+    cliSessionWrite(text, len);
+}
+
+// Makes current snapshot stale, it must be called after every pin write
+void cliGpioInvalidate(void){
+    __atomic_add_fetch(&s_epoch, 1, __ATOMIC_RELEASE);
+    s_stats.invalidations++;
+}
+
+// Sets time in which readers share one snapshot
+void cliGpioSetCacheWindow(uint32_t us){
+    s_window = us;
+    cliGpioInvalidate();
+}
+
+// Returns time in which readers share one snapshot
+uint32_t cliGpioGetCacheWindow(void){
+    return s_window;
+}
+
+// Returns snapshot cache statistics
+const cliGpioStats_t *cliGpioGetStats(void){
+    return &s_stats;
+}
+
+// Marks a pin as driven by a peripheral, fails if another one owns it
+bool cliGpioClaim(int pin, cliGpioOwner_t owner){
+    if(pin < 0 || pin > CLI_BOARD_MAX_PIN)
+        return false;
+    if(s_owner[pin] != CLI_GPIO_OWNER_NONE && s_owner[pin] != owner)
+        return false;
+    s_owner[pin] = owner;
+    // Table shows owners, so it is formatted again
+    cliGpioInvalidate();
+    return true;
+}
+
+// Gives a pin back, it is ignored if the pin has another owner
+void cliGpioRelease(int pin, cliGpioOwner_t owner){
+    if(pin < 0 || pin > CLI_BOARD_MAX_PIN || s_owner[pin] != owner)
+        return;
+    s_owner[pin] = CLI_GPIO_OWNER_NONE;
+    cliGpioInvalidate();
+}
+
+// Returns peripheral which drives a pin
+cliGpioOwner_t cliGpioGetOwner(int pin){
+    if(pin < 0 || pin > CLI_BOARD_MAX_PIN)
+        return CLI_GPIO_OWNER_NONE;
+    return s_owner[pin];
+}
+
+// Returns name of an owner, it is the command which drives the pin
+const char *cliGpioOwnerName(cliGpioOwner_t owner){
+    switch(owner){
+        case CLI_GPIO_OWNER_PWM:
+            return "pwm";
+        case CLI_GPIO_OWNER_WAVEFORM:
+            return "waveform";
+        case CLI_GPIO_OWNER_I2C:
+            return "i2c";
+        case CLI_GPIO_OWNER_SPI:
+            return "spi";
+        case CLI_GPIO_OWNER_UART:
+            return "uart";
+        default:
+            return "none";
+    }
+}
+
+// Checks that a pin is free or owned by 'owner', writes reason to session if it is not
+bool cliGpioReportOwner(int pin, cliGpioOwner_t owner){
+    cliGpioOwner_t current = cliGpioGetOwner(pin);
+    if(current == CLI_GPIO_OWNER_NONE || current == owner)
+        return true;
+    cliSessionPrintf("GPIO %d is driven by %s, stop it first!\n", pin, cliGpioOwnerName(current));
+    return false;
+}
+
+// Peripheral drivers turn input buffer off, it is turned on again so reads show the driven level
+void cliGpioEnableInput(int pin){
+    PIN_INPUT_ENABLE(GPIO_PIN_MUX_REG[pin]);
+    cliGpioInvalidate();
+}
@@ -0,0 +1,52 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLIGpio.h
+*/
+#ifndef _CLIGPIO_H_
+#define _CLIGPIO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Default time in which readers share one snapshot, 0 reads hardware for every request
+#define CLI_GPIO_CACHE_WINDOW_US (1000)
+// Size of pre-formatted 'read_gpio -a' table, it has room for owner names of all peripheral pins
+#define CLI_GPIO_TABLE_SIZE (768)
+// Reader retries before it gives up the snapshot and reads hardware itself
+#define CLI_GPIO_READ_RETRIES (3)
+
+// Peripherals which drive a pin, 'write_gpio' does not touch owned pins
+typedef enum{
+    CLI_GPIO_OWNER_NONE = 0,
+    CLI_GPIO_OWNER_PWM,
+    CLI_GPIO_OWNER_WAVEFORM,
+    CLI_GPIO_OWNER_I2C,
+    CLI_GPIO_OWNER_SPI,
+    CLI_GPIO_OWNER_UART                 // RTS/CTS of console flow control
+}cliGpioOwner_t;
+
+// Snapshot cache statistics
+typedef struct{
+    uint32_t hits;
+    uint32_t refreshes;
+    uint32_t retries;
+    uint32_t direct;
+    uint32_t invalidations;
+}cliGpioStats_t;
+
+uint64_t cliGpioReadAll(void);
+void cliGpioPrintTable(void);
+void cliGpioInvalidate(void);
+void cliGpioSetCacheWindow(uint32_t);
+uint32_t cliGpioGetCacheWindow(void);
+const cliGpioStats_t *cliGpioGetStats(void);
+bool cliGpioClaim(int, cliGpioOwner_t);
+void cliGpioRelease(int, cliGpioOwner_t);
+cliGpioOwner_t cliGpioGetOwner(int);
+const char *cliGpioOwnerName(cliGpioOwner_t);
+bool cliGpioReportOwner(int, cliGpioOwner_t);
+void cliGpioEnableInput(int);
+
+#endif
@@ -0,0 +1,331 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLIJob.c
+*/
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "CLI.h"
+#include "CLISession.h"
+#include "CLIJob.h"
+#include "CLIJson.h"
+
+// TAG for job log functions
+static const char *TAGJOB = "Job";
+// Job table
+static cliJob_t s_jobs[CLI_JOB_MAX];
+// Protects job table, it is never held while a command runs or a session is written
+static SemaphoreHandle_t s_lock;
+static uint8_t s_next_id = 1;
+// Job manager timer, it cancels overdue jobs whether or not they reach a checkpoint
+static esp_timer_handle_t s_watchdog;
+
+// Names of job states
+static const char *cliJobStateName(const cliJob_t *job){
+    switch(job->state){
+        case CLI_JOB_RUNNING:
+            return esp_timer_get_time() > job->deadline ? "overdue" : "running";
+        case CLI_JOB_DONE:
+            return (job->err == ESP_OK && job->ret == 0) ? "done" : "failed";
+        case CLI_JOB_KILLED:
+            return "killed";
+        case CLI_JOB_TIMEOUT:
+            return "timeout";
+        default:
+            return "free";
+    }
+}
+
+// Finds job by id, lock must be held
+static cliJob_t *cliJobFind(int id){
+    for(int i = 0; i < CLI_JOB_MAX; i++){
+        if(s_jobs[i].state != CLI_JOB_FREE && s_jobs[i].id == id)
+            return &s_jobs[i];
+    }
+    return NULL;
+}
+
+// Finds running job of calling task
+static cliJob_t *cliJobSelf(void){
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    for(int i = 0; i < CLI_JOB_MAX; i++){
+        if(s_jobs[i].state == CLI_JOB_RUNNING && s_jobs[i].task == task)
+            return &s_jobs[i];
+    }
+    return NULL;
+}
+
+// Releases slot of a finished job, lock must be held
+static void cliJobFree(cliJob_t *job){
+    cliSessionClose(job->output);
+    job->output = NULL;
+    job->state = CLI_JOB_FREE;
+}
+
+// Job manager timer callback, overdue jobs are cancelled and woken up if they sleep in cliJobSleep()
+static void cliJobWatchdog(void *arg){
+    int64_t now = esp_timer_get_time();
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for(int i = 0; i < CLI_JOB_MAX; i++){
+        cliJob_t *job = &s_jobs[i];
+        if(job->state == CLI_JOB_RUNNING && !job->cancel && now > job->deadline){
+            job->cancel = true;
+            xTaskNotifyGive(job->task);
+        }
+    }
+    xSemaphoreGive(s_lock);
+}
+
+// Worker task, it runs one command line and keeps its output until the job is waited
+static void cliJobTask(void *pvParameters){
+    cliJob_t *job = pvParameters;
+    cliSessionSetCurrent(job->output);
+    job->err = cliRunCommand(job->output, job->line, &job->ret);
+    cliCommandControl(job->err, job->ret);
+    cliSessionSetCurrent(NULL);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    job->end = esp_timer_get_time();
+    if(job->cancel)
+        job->state = job->end > job->deadline ? CLI_JOB_TIMEOUT : CLI_JOB_KILLED;
+    else
+        job->state = CLI_JOB_DONE;
+    job->task = NULL;
+    // Notice is taken from the slot, 'wait' of owner may free it as soon as lock is given
+    int id = job->id;
+    const char *state = cliJobStateName(job);
+    uint32_t ms = (job->end - job->start) / 1000;
+    cliSession_t *owner = job->owner;
+    uint32_t ownerId = job->ownerId;
+    // Nobody is left to wait for the job if owner is gone
+    bool orphan = !owner->used || owner->id != ownerId;
+    if(orphan)
+        cliJobFree(job);
+    xSemaphoreGive(job->done);
+    xSemaphoreGive(s_lock);
+
+    if(orphan)
+        ESP_LOGI(TAGJOB, "Job %d dropped, owner session closed", id);
+    // Owner is notified without job table lock, a slow peer must not block other jobs
+    cliSessionLock(owner);
+    if(!orphan && owner->used && owner->id == ownerId){
+        cliSessionEventBegin(owner);
+        if(owner->format == CLI_SESSION_FORMAT_JSON){
+            cliJson_t json;
+            cliJsonBeginEvent(&json, owner);
+            cliJsonString(&json, "event", "job");
+            cliJsonInt(&json, "id", id);
+            cliJsonString(&json, "state", state);
+            cliJsonUint(&json, "ms", ms);
+            cliJsonEnd(&json);
+        }
+        else{
+            char notice[48];
+            int len = snprintf(notice, sizeof(notice), "[job %d] %s (%u ms)\n", id, state, ms);
+            cliSessionWriteRaw(owner, notice, len);
+        }
+        cliSessionEventEnd(owner);
+    }
+    cliSessionUnlock(owner);
+    vTaskDelete(NULL);
+}
+
+// Checks whether line ends with '&' or '&<timeout ms>', the suffix is removed from line
+bool cliJobIsBackground(char *line, uint32_t *timeoutMs){
+    char *end = line + strlen(line);
+    while(end > line && isspace((unsigned char)end[-1]))
+        end--;
+    char *amp = end;
+    while(amp > line && isdigit((unsigned char)amp[-1]))
+        amp--;
+    if(amp == line || amp[-1] != '&')
+        return false;
+    // '&' in a quoted argument is not a job suffix
+    int quotes = 0;
+    for(char *c = line; c < amp - 1; c++){
+        if(*c == '"')
+            quotes++;
+    }
+    if(quotes % 2)
+        return false;
+    *timeoutMs = amp < end ? strtoul(amp, NULL, 10) : 0;
+    if(*timeoutMs == 0)
+        *timeoutMs = CLI_JOB_DEFAULT_TIMEOUT_MS;
+    amp[-1] = 0;
+    return true;
+}
+
+// Starts line on a worker task, returns job id or -1 if there is no free slot
+int cliJobStart(cliSession_t *owner, const char *line, uint32_t timeoutMs){
+    if(s_lock == NULL)
+        s_lock = xSemaphoreCreateMutex();
+    if(s_watchdog == NULL){
+        const esp_timer_create_args_t args = {
+            .callback = cliJobWatchdog,
+            .name = "cli_job_watchdog"
+        };
+        if(esp_timer_create(&args, &s_watchdog) != ESP_OK || esp_timer_start_periodic(s_watchdog, CLI_JOB_WATCHDOG_MS * 1000) != ESP_OK){
+            ESP_LOGE(TAGJOB, "Unable to start job watchdog!");
+            s_watchdog = NULL;
+            return -1;
+        }
+    }
+    int id = -1;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for(int i = 0; i < CLI_JOB_MAX; i++){
+        cliJob_t *job = &s_jobs[i];
+        if(job->state != CLI_JOB_FREE)
+            continue;
+        SemaphoreHandle_t done = job->done;
+        memset(job, 0, sizeof(*job));
+        job->done = done != NULL ? done : xSemaphoreCreateBinary();
+        job->output = cliSessionOpen(CLI_SESSION_BUFFER, -1);
+        if(job->done == NULL || job->output == NULL){
+            cliSessionClose(job->output);
+            break;
+        }
+        xSemaphoreTake(job->done, 0);
+        job->id = s_next_id++;
+        if(s_next_id == 0)
+            s_next_id = 1;
+        strlcpy(job->line, line, sizeof(job->line));
+        job->owner = owner;
+        job->ownerId = owner->id;
+        job->start = esp_timer_get_time();
+        job->deadline = job->start + (int64_t)timeoutMs * 1000;
+        job->state = CLI_JOB_RUNNING;
+        // Task handle is stored before the task runs, checkpoints find their job by it
+        if(xTaskCreate(cliJobTask, "cli_job", CLI_JOB_TASK_STACK, job, CLI_JOB_TASK_PRIORITY, &job->task) != pdPASS){
+            ESP_LOGE(TAGJOB, "Unable to create job task!");
+            cliJobFree(job);
+            break;
+        }
+        id = job->id;
+        break;
+    }
+    xSemaphoreGive(s_lock);
+    return id;
+}
+
+// Cancellation point for commands which run long. Returns true if the job is killed or its timeout is
+// expired, command must stop then.
+bool cliJobCheckpoint(void){
+    if(s_lock == NULL)
+        return false;
+    cliJob_t *job = cliJobSelf();
+    if(job == NULL)
+        return false;
+    if(esp_timer_get_time() > job->deadline)
+        job->cancel = true;
+    return job->cancel;
+}
+
+// Sleeps in a running command with command lock released, so other tasks can run commands meanwhile.
+// Command arguments (argv and argument tables) must be copied before, other commands overwrite them.
+// A job is woken up as soon as it is killed or overdue. Returns true if the command must stop then.
+bool cliJobSleep(uint32_t ms){
+    cliJob_t *job = s_lock != NULL ? cliJobSelf() : NULL;
+    int depth = cliCommandUnlock();
+    if(job == NULL)
+        vTaskDelay(pdMS_TO_TICKS(ms));
+    else{
+        TickType_t start = xTaskGetTickCount();
+        TickType_t limit = pdMS_TO_TICKS(ms);
+        while(!job->cancel && xTaskGetTickCount() - start < limit)
+            ulTaskNotifyTake(pdTRUE, limit - (xTaskGetTickCount() - start));
+    }
+    cliCommandLock(depth);
+    return cliJobCheckpoint();
+}
+
+// Returns true if calling task runs a background job
+bool cliJobIsCurrent(void){
+    return s_lock != NULL && cliJobSelf() != NULL;
+}
+
+// Requests cancellation of a running job or discards a finished one, returns -1 if there is no such job
+int cliJobKill(int id){
+    if(s_lock == NULL)
+        return -1;
+    int err = -1;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    cliJob_t *job = cliJobFind(id);
+    if(job != NULL){
+        if(job->state == CLI_JOB_RUNNING){
+            job->cancel = true;
+            xTaskNotifyGive(job->task);
+        }
+        else
+            cliJobFree(job);
+        err = 0;
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+// Waits for a job and prints its output to current session. Returns 0 when the job is finished and
+// waited, 1 if it still runs after timeoutMs and -1 if there is no such job.
+int cliJobWait(int id, uint32_t timeoutMs){
+    if(s_lock == NULL)
+        return -1;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    cliJob_t *job = cliJobFind(id);
+    if(job == NULL){
+        xSemaphoreGive(s_lock);
+        return -1;
+    }
+    if(job->state == CLI_JOB_RUNNING){
+        SemaphoreHandle_t done = job->done;
+        xSemaphoreGive(s_lock);
+        // Job may need the command lock to finish
+        int depth = cliCommandUnlock();
+        if(xSemaphoreTake(done, pdMS_TO_TICKS(timeoutMs)) == pdTRUE)
+            xSemaphoreGive(done);
+        cliCommandLock(depth);
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        // Another session may have waited for it meanwhile
+        job = cliJobFind(id);
+        if(job == NULL){
+            xSemaphoreGive(s_lock);
+            return -1;
+        }
+        if(job->state == CLI_JOB_RUNNING){
+            xSemaphoreGive(s_lock);
+            return 1;
+        }
+    }
+    cliSessionPrintf("[job %d] %s (%u ms)\n", job->id, cliJobStateName(job),
+                     (uint32_t)((job->end - job->start) / 1000));
+    cliSessionWrite(job->output->txBuffer, job->output->txLen);
+    if(job->output->truncated)
+        cliSessionPrintf("...\n");
+    cliJobFree(job);
+    xSemaphoreGive(s_lock);
+    return 0;
+}
+
+// Prints job table to current session
+void cliJobList(void){
+    cliSessionPrintf("ID  STATE    TIME(ms)  TIMEOUT(ms)  OUTPUT  COMMAND\n");
+    if(s_lock == NULL)
+        return;
+    int64_t now = esp_timer_get_time();
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for(int i = 0; i < CLI_JOB_MAX; i++){
+        cliJob_t *job = &s_jobs[i];
+        if(job->state == CLI_JOB_FREE)
+            continue;
+        int64_t end = job->state == CLI_JOB_RUNNING ? now : job->end;
+        cliSessionPrintf("%-3d %-8s %-9u %-12u %-7u %s\n", job->id, cliJobStateName(job),
+                         (uint32_t)((end - job->start) / 1000), (uint32_t)((job->deadline - job->start) / 1000),
+                         (unsigned)job->output->txLen, job->line);
+    }
+    xSemaphoreGive(s_lock);
+}
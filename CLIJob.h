@@ -0,0 +1,67 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLIJob.h
+*/
+#ifndef _CLIJOB_H_
+#define _CLIJOB_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "CLISession.h"
+
+// Maximum number of background jobs, finished jobs keep their slot until they are waited
+#define CLI_JOB_MAX (4)
+// Command line length of a job
+#define CLI_JOB_LINE_LEN (128)
+// Timeout of a job if it is not given after '&'
+#define CLI_JOB_DEFAULT_TIMEOUT_MS (60000)
+// Default time which 'wait' blocks
+#define CLI_JOB_WAIT_MS (30000)
+// Period of job manager timer which cancels overdue jobs
+#define CLI_JOB_WATCHDOG_MS (100)
+// Worker task settings
+#define CLI_JOB_TASK_STACK (4096)
+#define CLI_JOB_TASK_PRIORITY (4)
+
+// Job states
+typedef enum{
+    CLI_JOB_FREE = 0,
+    CLI_JOB_RUNNING,
+    CLI_JOB_DONE,
+    CLI_JOB_KILLED,
+    CLI_JOB_TIMEOUT
+}cliJobState_t;
+
+// Background job
+typedef struct{
+    cliJobState_t state;
+    uint8_t id;
+    char line[CLI_JOB_LINE_LEN];
+    TaskHandle_t task;
+    SemaphoreHandle_t done;
+    // Output is kept until the job is waited
+    cliSession_t *output;
+    cliSession_t *owner;
+    uint32_t ownerId;
+    int64_t start;
+    int64_t end;
+    int64_t deadline;
+    volatile bool cancel;
+    esp_err_t err;
+    int ret;
+}cliJob_t;
+
+bool cliJobIsBackground(char*, uint32_t*);
+int cliJobStart(cliSession_t*, const char*, uint32_t);
+bool cliJobCheckpoint(void);
+bool cliJobSleep(uint32_t);
+bool cliJobIsCurrent(void);
+int cliJobKill(int);
+int cliJobWait(int, uint32_t);
+void cliJobList(void);
+
+#endif
@@ -0,0 +1,276 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLIJson.c
+*/
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "CLISession.h"
+#include "CLIJson.h"
+
+// Writes a literal to the session
+static void cliJsonRaw(cliSession_t *session, const char *text){
+    cliSessionWriteRaw(session, text, strlen(text));
+}
+
+// Writes bytes as contents of a JSON string, safe runs are written at once
+static void cliJsonEscape(cliSession_t *session, const char *data, size_t len){
+    const char *start = data;
+    for(size_t i = 0; i < len; i++){
+        uint8_t c = data[i];
+        if(c >= 0x20 && c < 0x7F && c != '"' && c != '\\')
+            continue;
+        cliSessionWriteRaw(session, start, data + i - start);
+        char escaped[8] = { '\\' };
+        size_t escapedLen = 2;
+        switch(c){
+            case '"':  escaped[1] = '"'; break;
+            case '\\': escaped[1] = '\\'; break;
+            case '\n': escaped[1] = 'n'; break;
+            case '\r': escaped[1] = 'r'; break;
+            case '\t': escaped[1] = 't'; break;
+            default:   escapedLen = snprintf(escaped, sizeof(escaped), "\\u%04x", c); break;
+        }
+        cliSessionWriteRaw(session, escaped, escapedLen);
+        start = data + i + 1;
+    }
+    cliSessionWriteRaw(session, start, data + len - start);
+}
+
+// Writes separator and key of next member
+static void cliJsonKey(cliJson_t *json, const char *key){
+    uint32_t bit = 1u << json->depth;
+    if(json->first & bit)
+        json->first &= ~bit;
+    else
+        cliJsonRaw(json->session, ",");
+    if(key != NULL && !(json->array & bit)){
+        cliJsonRaw(json->session, "\"");
+        cliJsonEscape(json->session, key, strlen(key));
+        cliJsonRaw(json->session, "\":");
+    }
+}
+
+// Opens a nested object or array
+static void cliJsonOpen(cliJson_t *json, const char *key, bool array){
+    if(json->skipped > 0 || json->depth + 1 >= CLI_JSON_MAX_DEPTH){
+        // Level and its members are left out, matching close calls are counted
+        json->skipped++;
+        json->overflow = true;
+        return;
+    }
+    cliJsonKey(json, key);
+    cliJsonRaw(json->session, array ? "[" : "{");
+    json->depth++;
+    uint32_t bit = 1u << json->depth;
+    json->first |= bit;
+    if(array)
+        json->array |= bit;
+    else
+        json->array &= ~bit;
+}
+
+// Resets writer state for a new top level object
+static void cliJsonReset(cliJson_t *json, cliSession_t *session){
+    json->session = session;
+    json->depth = 0;
+    json->first = 1;
+    json->array = 0;
+    json->skipped = 0;
+    json->overflow = false;
+}
+
+// Starts a structured response, text written before it is closed as its own response
+void cliJsonBegin(cliJson_t *json, cliSession_t *session){
+    cliJsonReset(json, session);
+    if(session->jsonState == CLI_SESSION_JSON_STRING)
+        cliJsonRaw(session, "\"}\n");
+    if(session->jsonState != CLI_SESSION_JSON_IDLE)
+        session->jsonState = CLI_SESSION_JSON_DONE;
+    cliJsonRaw(session, "{");
+}
+
+// Starts an event of another task, it is not a response so response state of the session is not touched
+void cliJsonBeginEvent(cliJson_t *json, cliSession_t *session){
+    cliJsonReset(json, session);
+    cliJsonRaw(session, "{");
+}
+
+// Closes open levels and the response, a response which lost levels reports it
+void cliJsonEnd(cliJson_t *json){
+    json->skipped = 0;
+    while(json->depth > 0)
+        cliJsonClose(json);
+    if(json->overflow){
+        json->overflow = false;
+        cliJsonObject(json, "error");
+        cliJsonInt(json, "code", CLI_ERROR_INTERNAL);
+        cliJsonString(json, "name", cliErrorName(CLI_ERROR_INTERNAL));
+        cliJsonString(json, "reason", "depth");
+        cliJsonClose(json);
+    }
+    cliJsonRaw(json->session, "}\n");
+}
+
+// Opens a nested object, key is ignored in arrays
+void cliJsonObject(cliJson_t *json, const char *key){
+    cliJsonOpen(json, key, false);
+}
+
+// Opens a nested array, key is ignored in arrays
+void cliJsonArray(cliJson_t *json, const char *key){
+    cliJsonOpen(json, key, true);
+}
+
+// Closes innermost object or array
+void cliJsonClose(cliJson_t *json){
+    if(json->skipped > 0){
+        json->skipped--;
+        return;
+    }
+    if(json->depth == 0)
+        return;
+    bool array = json->array & (1u << json->depth);
+    json->depth--;
+    cliJsonRaw(json->session, array ? "]" : "}");
+}
+
+// Writes a string member
+void cliJsonString(cliJson_t *json, const char *key, const char *value){
+    cliJsonStringN(json, key, value, strlen(value));
+}
+
+// Writes a string member of given length, it may contain any byte
+void cliJsonStringN(cliJson_t *json, const char *key, const char *value, size_t len){
+    if(json->skipped > 0)
+        return;
+    cliJsonKey(json, key);
+    cliJsonRaw(json->session, "\"");
+    cliJsonEscape(json->session, value, len);
+    cliJsonRaw(json->session, "\"");
+}
+
+// Writes bytes as a hex string member, digits need no escaping so they are written in chunks
+void cliJsonHex(cliJson_t *json, const char *key, const uint8_t *data, size_t len){
+    static const char digits[] = "0123456789abcdef";
+    char text[64];
+    size_t n = 0;
+    if(json->skipped > 0)
+        return;
+    cliJsonKey(json, key);
+    cliJsonRaw(json->session, "\"");
+    for(size_t i = 0; i < len; i++){
+        text[n++] = digits[data[i] >> 4];
+        text[n++] = digits[data[i] & 0x0F];
+        if(n == sizeof(text)){
+            cliSessionWriteRaw(json->session, text, n);
+            n = 0;
+        }
+    }
+    cliSessionWriteRaw(json->session, text, n);
+    cliJsonRaw(json->session, "\"");
+}
+
+// Writes a signed number member
+void cliJsonInt(cliJson_t *json, const char *key, int64_t value){
+    char text[24];
+    if(json->skipped > 0)
+        return;
+    cliJsonKey(json, key);
+    cliSessionWriteRaw(json->session, text, snprintf(text, sizeof(text), "%" PRId64, value));
+}
+
+// Writes an unsigned number member
+void cliJsonUint(cliJson_t *json, const char *key, uint64_t value){
+    char text[24];
+    if(json->skipped > 0)
+        return;
+    cliJsonKey(json, key);
+    cliSessionWriteRaw(json->session, text, snprintf(text, sizeof(text), "%" PRIu64, value));
+}
+
+// Writes a boolean member
+void cliJsonBool(cliJson_t *json, const char *key, bool value){
+    if(json->skipped > 0)
+        return;
+    cliJsonKey(json, key);
+    cliJsonRaw(json->session, value ? "true" : "false");
+}
+
+// Returns true if current session wants JSON responses
+bool cliJsonEnabled(void){
+    cliSession_t *session = cliSessionGetCurrent();
+    return session != NULL && session->format == CLI_SESSION_FORMAT_JSON;
+}
+
+// Wraps text output of a command into "output" member, session lock must be held
+void cliJsonWrapText(cliSession_t *session, const char *data, size_t len){
+    if(session->jsonState == CLI_SESSION_JSON_PENDING){
+        cliJsonRaw(session, "{\"output\":\"");
+        session->jsonState = CLI_SESSION_JSON_STRING;
+    }
+    cliJsonEscape(session, data, len);
+}
+
+// Returns name of an error code
+const char *cliErrorName(cliError_t code){
+    switch(code){
+        case CLI_ERROR_NONE:            return "none";
+        case CLI_ERROR_UNKNOWN_COMMAND: return "unknown_command";
+        case CLI_ERROR_COMMAND_FAILED:  return "command_failed";
+        case CLI_ERROR_NO_RESOURCE:     return "no_resource";
+        case CLI_ERROR_RATE_LIMITED:    return "rate_limited";
+        default:                        return "internal";
+    }
+}
+
+// Writes error member
+static void cliJsonError(cliJson_t *json, cliError_t code, esp_err_t err, int ret){
+    cliJsonObject(json, "error");
+    cliJsonInt(json, "code", code);
+    cliJsonString(json, "name", cliErrorName(code));
+    if(code == CLI_ERROR_COMMAND_FAILED){
+        cliJsonInt(json, "ret", ret);
+        cliJsonString(json, "esp_err", esp_err_to_name(ret));
+    }
+    else if(code == CLI_ERROR_INTERNAL)
+        cliJsonString(json, "esp_err", esp_err_to_name(err));
+    cliJsonClose(json);
+}
+
+// Completes JSON response of a command with its result, text sessions are not touched
+void cliJsonFinishResponse(cliSession_t *session, esp_err_t err, int ret){
+    if(session == NULL || session->format != CLI_SESSION_FORMAT_JSON || session->jsonState == CLI_SESSION_JSON_IDLE)
+        return;
+    cliSessionLock(session);
+    cliError_t code = CLI_ERROR_NONE;
+    if(err == ESP_ERR_NOT_FOUND)
+        code = CLI_ERROR_UNKNOWN_COMMAND;
+    else if(err == ESP_OK && ret != ESP_OK)
+        code = CLI_ERROR_COMMAND_FAILED;
+    else if(err != ESP_OK && err != ESP_ERR_INVALID_ARG)
+        code = CLI_ERROR_INTERNAL;
+
+    cliJson_t json = { .session = session };
+    if(session->jsonState == CLI_SESSION_JSON_STRING){
+        // Top level object of wrapped text is still open
+        cliJsonRaw(session, "\"");
+        if(code != CLI_ERROR_NONE)
+            cliJsonError(&json, code, err, ret);
+        cliJsonEnd(&json);
+    }
+    else if(code != CLI_ERROR_NONE){
+        json.first = 1;
+        cliJsonRaw(session, "{");
+        cliJsonError(&json, code, err, ret);
+        cliJsonEnd(&json);
+    }
+    else if(session->jsonState == CLI_SESSION_JSON_PENDING && err != ESP_ERR_INVALID_ARG){
+        // Command succeeded without output, empty command line gets no response like in text format
+        cliJsonRaw(session, "{\"ok\":true}\n");
+    }
+    session->jsonState = CLI_SESSION_JSON_IDLE;
+    cliSessionUnlock(session);
+}
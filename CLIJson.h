@@ -0,0 +1,67 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLIJson.h
+*/
+#ifndef _CLIJSON_H_
+#define _CLIJSON_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "CLISession.h"
+
+// Deepest nesting of objects and arrays
+#define CLI_JSON_MAX_DEPTH (16)
+
+/* JSON responses are written straight into the coalescing buffer of the session, one JSON value per line:
+ *   structured response  : written by command with cliJson functions, e.g. {"pins":[{"pin":0,"level":1},...]}
+ *   text response        : {"output":"<text of command>"}, text is escaped while it is written
+ *   no output            : {"ok":true}
+ *   error                : {"output":"...","error":{"code":<code>,"name":"<name>",...}}
+ *                          a structured response is followed by {"error":{...}} on its own line
+ * Bytes outside of printable ASCII are written as \u00XX. Binary streams are refused on JSON sessions, since
+ * their readers expect raw bytes. Levels deeper than CLI_JSON_MAX_DEPTH are left out with their members and
+ * the response ends with "error":{"code":<internal>,"name":"internal","reason":"depth"}.
+ * The writer allocates nothing. Text which commands print with cliSessionPrintf() is formatted in a 256 byte
+ * stack buffer before it is escaped, only longer lines take a heap buffer for the call. */
+
+// Structured error codes of JSON responses
+typedef enum{
+    CLI_ERROR_NONE = 0,
+    CLI_ERROR_UNKNOWN_COMMAND,
+    CLI_ERROR_COMMAND_FAILED,
+    CLI_ERROR_INTERNAL,
+    CLI_ERROR_NO_RESOURCE,
+    CLI_ERROR_RATE_LIMITED
+}cliError_t;
+
+// Streaming JSON writer, it has no buffer of its own
+typedef struct{
+    cliSession_t *session;
+    uint8_t depth;
+    uint32_t first;         // bit n is set while level n has no member yet
+    uint32_t array;         // bit n is set if level n is an array
+    uint8_t skipped;        // Open levels beyond CLI_JSON_MAX_DEPTH, they are not written
+    bool overflow;
+}cliJson_t;
+
+void cliJsonBegin(cliJson_t*, cliSession_t*);
+void cliJsonBeginEvent(cliJson_t*, cliSession_t*);
+void cliJsonEnd(cliJson_t*);
+void cliJsonObject(cliJson_t*, const char*);
+void cliJsonArray(cliJson_t*, const char*);
+void cliJsonClose(cliJson_t*);
+void cliJsonString(cliJson_t*, const char*, const char*);
+void cliJsonStringN(cliJson_t*, const char*, const char*, size_t);
+void cliJsonHex(cliJson_t*, const char*, const uint8_t*, size_t);
+void cliJsonInt(cliJson_t*, const char*, int64_t);
+void cliJsonUint(cliJson_t*, const char*, uint64_t);
+void cliJsonBool(cliJson_t*, const char*, bool);
+bool cliJsonEnabled(void);
+void cliJsonWrapText(cliSession_t*, const char*, size_t);
+void cliJsonFinishResponse(cliSession_t*, esp_err_t, int);
+const char *cliErrorName(cliError_t);
+
+#endif
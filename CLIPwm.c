@@ -0,0 +1,150 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLIPwm.c
+*/
+#include <stdio.h>
+#include "esp_log.h"
+#include "driver/ledc.h"
+#include "driver/gpio.h"
+
+#include "CLIGpio.h"
+#include "CLIPwm.h"
+
+// TAG for PWM log functions
+static const char *TAGPWM = "PWM";
+
+// Outputs of channels, channel n uses timer n
+static cliPwm_t s_pwm[CLI_PWM_CHANNELS] = { [0 ... CLI_PWM_CHANNELS - 1] = { .pin = -1 } };
+
+// Low speed mode exists on every target, its duty and divider updates wait for timer overflow
+#define CLI_PWM_MODE (LEDC_LOW_SPEED_MODE)
+
+// Returns duty in counter ticks, full duty keeps output high
+static uint32_t cliPwmTicks(const cliPwm_t *pwm){
+    return ((uint64_t)pwm->duty << pwm->bits) / CLI_PWM_DUTY_FULL;
+}
+
+// Configures timer and channel, pin is connected to channel output
+static esp_err_t cliPwmHardwareStart(int channel, const cliPwm_t *pwm){
+    ledc_timer_config_t timer = {
+        .speed_mode = CLI_PWM_MODE,
+        .duty_resolution = pwm->bits,
+        .timer_num = channel,
+        .freq_hz = pwm->hz,
+        .clk_cfg = LEDC_USE_APB_CLK,
+    };
+    esp_err_t err = ledc_timer_config(&timer);
+    if(err != ESP_OK)
+        return err;
+    ledc_channel_config_t config = {
+        .gpio_num = pwm->pin,
+        .speed_mode = CLI_PWM_MODE,
+        .channel = channel,
+        .intr_type = LEDC_INTR_DISABLE,
+        .timer_sel = channel,
+        .duty = cliPwmTicks(pwm),
+        .hpoint = 0,
+    };
+    return ledc_channel_config(&config);
+}
+
+// Changes frequency and duty of a running channel, both take effect at end of current period
+static esp_err_t cliPwmHardwareUpdate(int channel, const cliPwm_t *pwm, bool frequency){
+    esp_err_t err = ESP_OK;
+    if(frequency)
+        err = ledc_set_freq(CLI_PWM_MODE, channel, pwm->hz);
+    if(err == ESP_OK)
+        err = ledc_set_duty(CLI_PWM_MODE, channel, cliPwmTicks(pwm));
+    if(err == ESP_OK)
+        err = ledc_update_duty(CLI_PWM_MODE, channel);
+    return err;
+}
+
+// Stops channel at a level, GPIO output gets the same level before it takes the pin, so there is no edge
+static void cliPwmHardwareStop(int channel, int pin, uint32_t level){
+    ledc_stop(CLI_PWM_MODE, channel, level);
+    gpio_set_level(pin, level);
+    gpio_set_direction(pin, GPIO_MODE_INPUT_OUTPUT);
+}
+
+// Returns highest duty resolution whose counter still runs at the frequency
+static uint8_t cliPwmBits(uint32_t hz){
+    uint8_t bits = 1;
+    while(bits < CLI_PWM_MAX_BITS && ((uint64_t)hz << (bits + 1)) <= CLI_PWM_CLOCK_HZ)
+        bits++;
+    return bits;
+}
+
+// Returns channel which drives a pin, or -1
+static int cliPwmFind(int pin){
+    for(int i = 0; i < CLI_PWM_CHANNELS; i++){
+        if(s_pwm[i].pin == pin)
+            return i;
+    }
+    return -1;
+}
+
+// Starts PWM on a pin, a running output of the pin is configured again
+esp_err_t cliPwmStart(int pin, uint32_t hz, uint16_t duty){
+    if(hz < CLI_PWM_MIN_HZ || hz > CLI_PWM_MAX_HZ || duty > CLI_PWM_DUTY_FULL)
+        return ESP_ERR_INVALID_ARG;
+    int channel = cliPwmFind(pin);
+    if(channel < 0)
+        channel = cliPwmFind(-1);
+    if(channel < 0)
+        return ESP_ERR_NO_MEM;
+    if(!cliGpioClaim(pin, CLI_GPIO_OWNER_PWM))
+        return ESP_ERR_INVALID_STATE;
+    cliPwm_t pwm = { .pin = pin, .hz = hz, .duty = duty, .bits = cliPwmBits(hz) };
+    esp_err_t err = cliPwmHardwareStart(channel, &pwm);
+    if(err != ESP_OK){
+        ESP_LOGE(TAGPWM, "Unable to start PWM on GPIO %d: %s", pin, esp_err_to_name(err));
+        // Channel which was running keeps its pin, its state is unknown so it is stopped
+        if(s_pwm[channel].pin == pin)
+            cliPwmHardwareStop(channel, pin, 0);
+        s_pwm[channel].pin = -1;
+        cliGpioRelease(pin, CLI_GPIO_OWNER_PWM);
+        return err;
+    }
+    s_pwm[channel] = pwm;
+    cliGpioEnableInput(pin);
+    return ESP_OK;
+}
+
+// Changes frequency and duty of a running output without restarting its period
+esp_err_t cliPwmUpdate(int pin, uint32_t hz, uint16_t duty){
+    int channel = cliPwmFind(pin);
+    if(channel < 0)
+        return ESP_ERR_NOT_FOUND;
+    if(hz < CLI_PWM_MIN_HZ || hz > CLI_PWM_MAX_HZ || duty > CLI_PWM_DUTY_FULL)
+        return ESP_ERR_INVALID_ARG;
+    cliPwm_t pwm = s_pwm[channel];
+    // Divider has 10 integer bits, counter of start resolution must fit it
+    uint64_t counter = (uint64_t)hz << pwm.bits;
+    if(counter > CLI_PWM_CLOCK_HZ || counter * 1024 <= CLI_PWM_CLOCK_HZ)
+        return ESP_ERR_INVALID_SIZE;
+    pwm.hz = hz;
+    pwm.duty = duty;
+    esp_err_t err = cliPwmHardwareUpdate(channel, &pwm, hz != s_pwm[channel].hz);
+    if(err != ESP_OK)
+        return err;
+    s_pwm[channel] = pwm;
+    return ESP_OK;
+}
+
+// Stops output of a pin, pin stays at the level as a GPIO output
+esp_err_t cliPwmStop(int pin, uint32_t level){
+    int channel = cliPwmFind(pin);
+    if(channel < 0)
+        return ESP_ERR_NOT_FOUND;
+    cliPwmHardwareStop(channel, pin, level);
+    s_pwm[channel].pin = -1;
+    cliGpioRelease(pin, CLI_GPIO_OWNER_PWM);
+    return ESP_OK;
+}
+
+// Returns output of a channel
+const cliPwm_t *cliPwmGet(int channel){
+    return &s_pwm[channel];
+}
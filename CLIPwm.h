@@ -0,0 +1,41 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLIPwm.h
+*/
+#ifndef _CLIPWM_H_
+#define _CLIPWM_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// LEDC channels given to 'pwm', every channel has its own timer so frequencies are independent
+#define CLI_PWM_CHANNELS (4)
+// LEDC timers count APB clock
+#define CLI_PWM_CLOCK_HZ (80000000)
+// Duty resolution is the highest one which fits the frequency, up to this limit
+#define CLI_PWM_MAX_BITS (16)
+// Frequency limits, LEDC divider has 10 integer bits and counter needs at least 1 bit
+#define CLI_PWM_MIN_HZ (2)
+#define CLI_PWM_MAX_HZ (CLI_PWM_CLOCK_HZ / 2)
+// Duty is given in 1/100 percent
+#define CLI_PWM_DUTY_FULL (10000)
+
+/* Duty and frequency updates are latched by LEDC at the end of the running period, so an update never
+ * makes a short or a long pulse. Frequency updates keep duty resolution of start, a frequency which
+ * does not fit it needs a new start. Stop holds the pin at a level and gives it back to GPIO. */
+
+// Output of an LEDC channel
+typedef struct{
+    int pin;                    // -1 when channel is free
+    uint32_t hz;
+    uint16_t duty;
+    uint8_t bits;
+}cliPwm_t;
+
+esp_err_t cliPwmStart(int, uint32_t, uint16_t);
+esp_err_t cliPwmUpdate(int, uint32_t, uint16_t);
+esp_err_t cliPwmStop(int, uint32_t);
+const cliPwm_t *cliPwmGet(int);
+
+#endif
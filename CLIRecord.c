@@ -0,0 +1,297 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLIRecord.c
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "CLISession.h"
+#include "CLIConfig.h"
+#include "CLIRecord.h"
+
+// TAG for record log functions
+static const char *TAGRECORD = "Record";
+
+// Longest encoded head of an entry, it is every field before the line
+#define CLI_RECORD_HEAD_MAX (1 + 5 + 1 + 10 + 10 + 5 + 5 + 5)
+// Longest encoded tail of an entry, it is every field between the line and kept response
+#define CLI_RECORD_TAIL_MAX (5 + 5 + 4)
+
+// Log and its state, entries are only appended so a dump can copy them while recording goes on
+static uint8_t *s_log;
+static size_t s_size;
+static size_t s_used;
+static uint32_t s_lines;
+static uint32_t s_dropped;
+static cliRecordState_t s_state;
+static int64_t s_last;
+// Protects log and line in progress, output of other tasks can come while a line runs
+static SemaphoreHandle_t s_lock;
+
+// Line in progress, one line is recorded at a time
+static cliSession_t *volatile s_current;
+static uint32_t s_session;
+static int64_t s_started;
+static size_t s_line_len;
+static char s_line[CLI_SESSION_RX_SIZE];
+static size_t s_response_len;
+static uint32_t s_hash;
+static uint8_t s_response[CLI_RECORD_RESPONSE_MAX];
+
+// Writes LEB128 varint of up to 64 bits, returns its length
+static size_t cliRecordPutVarint(uint8_t *out, uint64_t value){
+    size_t n = 0;
+    do{
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        out[n++] = byte | (value ? 0x80 : 0);
+    }while(value);
+    return n;
+}
+
+// Writes a signed value as zigzag varint, small negative error codes stay short
+static size_t cliRecordPutSigned(uint8_t *out, int32_t value){
+    return cliRecordPutVarint(out, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+// Writes little endian integer
+static void cliRecordPut(uint8_t *out, uint32_t value, size_t len){
+    for(size_t i = 0; i < len; i++)
+        out[i] = (value >> (8 * i)) & 0xFF;
+}
+
+// Allocates a log of 'kb' KB and starts recording, previous log is dropped
+esp_err_t cliRecordStart(size_t kb){
+    if(kb == 0 || kb > CLI_RECORD_MAX_KB)
+        return ESP_ERR_INVALID_ARG;
+    if(s_lock == NULL)
+        s_lock = xSemaphoreCreateMutex();
+    uint8_t *log = malloc(kb * 1024);
+    if(log == NULL){
+        ESP_LOGE(TAGRECORD, "No memory for %u KB log!", (unsigned)kb);
+        return ESP_ERR_NO_MEM;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    free(s_log);
+    s_log = log;
+    s_size = kb * 1024;
+    s_used = 0;
+    s_lines = 0;
+    s_dropped = 0;
+    s_last = esp_timer_get_time();
+    s_state = CLI_RECORD_RUNNING;
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+// Stops recording, log is kept for download
+void cliRecordStop(void){
+    if(s_lock == NULL)
+        return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if(s_state == CLI_RECORD_RUNNING)
+        s_state = CLI_RECORD_STOPPED;
+    xSemaphoreGive(s_lock);
+}
+
+// Stops recording and frees log
+void cliRecordClear(void){
+    if(s_lock == NULL)
+        return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    free(s_log);
+    s_log = NULL;
+    s_size = 0;
+    s_used = 0;
+    s_lines = 0;
+    s_dropped = 0;
+    s_state = CLI_RECORD_IDLE;
+    xSemaphoreGive(s_lock);
+}
+
+// Returns recorder status
+void cliRecordGetStatus(cliRecordStatus_t *status){
+    status->state = s_state;
+    status->size = s_size;
+    status->used = s_used;
+    status->lines = s_lines;
+    status->dropped = s_dropped;
+}
+
+// Returns name of a recorder state
+const char *cliRecordStateName(cliRecordState_t state){
+    switch(state){
+        case CLI_RECORD_RUNNING:
+            return "running";
+        case CLI_RECORD_FULL:
+            return "full";
+        case CLI_RECORD_STOPPED:
+            return "stopped";
+        default:
+            return "idle";
+    }
+}
+
+// Skips spaces and returns length of the word after them, start is moved to the word
+static size_t cliRecordWord(const char **start){
+    const char *text = *start;
+    while(*text == ' ' || *text == '\t')
+        text++;
+    *start = text;
+    size_t len = 0;
+    while(text[len] != 0 && text[len] != ' ' && text[len] != '\t')
+        len++;
+    return len;
+}
+
+// Copies a line into the log, value of a secret key in 'config set <key> <value>' is masked
+static size_t cliRecordCopyLine(char *out, size_t size, const char *line){
+    const char *text = line;
+    size_t len = cliRecordWord(&text);
+    if(len == 6 && strncmp(text, "config", 6) == 0){
+        text += len;
+        len = cliRecordWord(&text);
+        if(len == 3 && strncmp(text, "set", 3) == 0){
+            text += len;
+            len = cliRecordWord(&text);
+            char key[16];
+            if(len > 0 && len < sizeof(key)){
+                memcpy(key, text, len);
+                key[len] = 0;
+                int index = cliConfigFind(key);
+                text += len;
+                if(index >= 0 && cliConfigSchema(index)->secret && cliRecordWord(&text) > 0){
+                    size_t head = text - line;
+                    if(head + 3 > size)
+                        head = size - 3;
+                    memcpy(out, line, head);
+                    memcpy(out + head, "***", 3);
+                    return head + 3;
+                }
+            }
+        }
+    }
+    len = strnlen(line, size);
+    memcpy(out, line, len);
+    return len;
+}
+
+// Starts recording a line, returns true if cliRecordEnd() must be called after it runs
+bool cliRecordBegin(cliSession_t *session, const char *line){
+    if(s_state != CLI_RECORD_RUNNING && s_state != CLI_RECORD_FULL)
+        return false;
+    // Recorder's own lines would record the log into itself
+    if(strncmp(line, "record", 6) == 0 && (line[6] == ' ' || line[6] == 0))
+        return false;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    // A full log or a line of another task which is still running makes this one dropped
+    if(s_state != CLI_RECORD_RUNNING || s_current != NULL){
+        if(s_state == CLI_RECORD_RUNNING || s_state == CLI_RECORD_FULL)
+            s_dropped++;
+        xSemaphoreGive(s_lock);
+        return false;
+    }
+    s_session = session != NULL ? session->id : 0;
+    s_line_len = cliRecordCopyLine(s_line, sizeof(s_line), line);
+    s_response_len = 0;
+    s_hash = 2166136261u;
+    s_started = esp_timer_get_time();
+    s_current = session;
+    xSemaphoreGive(s_lock);
+    return true;
+}
+
+// Returns true if output of a session belongs to the line in progress
+bool cliRecordCapturing(const cliSession_t *session){
+    return session != NULL && s_current == session;
+}
+
+// Hashes and keeps head of a response of the line in progress
+void cliRecordOutput(const cliSession_t *session, const char *data, size_t len){
+    if(!cliRecordCapturing(session))
+        return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if(s_current == session){
+        for(size_t i = 0; i < len; i++){
+            s_hash ^= (uint8_t)data[i];
+            s_hash *= 16777619u;
+        }
+        if(s_response_len < sizeof(s_response)){
+            size_t keep = sizeof(s_response) - s_response_len;
+            memcpy(s_response + s_response_len, data, len < keep ? len : keep);
+        }
+        s_response_len += len;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+// Appends line in progress to log with its execution time and result
+void cliRecordEnd(esp_err_t err, int ret){
+    int64_t now = esp_timer_get_time();
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    cliSession_t *session = s_current;
+    s_current = NULL;
+    // Log may be stopped or cleared while the line was running
+    if(s_state != CLI_RECORD_RUNNING || s_log == NULL){
+        xSemaphoreGive(s_lock);
+        return;
+    }
+    size_t kept = s_response_len < sizeof(s_response) ? s_response_len : sizeof(s_response);
+    uint8_t head[CLI_RECORD_HEAD_MAX];
+    uint8_t tail[CLI_RECORD_TAIL_MAX];
+    size_t headLen = 0;
+    size_t tailLen = 0;
+    head[headLen++] = 'E';
+    headLen += cliRecordPutVarint(head + headLen, s_session);
+    head[headLen++] = session != NULL ? session->transport : 0;
+    headLen += cliRecordPutVarint(head + headLen, s_started - s_last);
+    headLen += cliRecordPutVarint(head + headLen, now - s_started);
+    headLen += cliRecordPutSigned(head + headLen, err);
+    headLen += cliRecordPutSigned(head + headLen, ret);
+    headLen += cliRecordPutVarint(head + headLen, s_line_len);
+    tailLen += cliRecordPutVarint(tail + tailLen, s_response_len);
+    tailLen += cliRecordPutVarint(tail + tailLen, kept);
+    cliRecordPut(tail + tailLen, s_hash, 4);
+    tailLen += 4;
+    size_t len = headLen + s_line_len + tailLen + kept;
+    if(s_used + len > s_size){
+        // Log keeps a gapless head of traffic, so replay of it is meaningful
+        s_state = CLI_RECORD_FULL;
+        s_dropped++;
+        xSemaphoreGive(s_lock);
+        return;
+    }
+    uint8_t *out = s_log + s_used;
+    memcpy(out, head, headLen);
+    memcpy(out + headLen, s_line, s_line_len);
+    memcpy(out + headLen + s_line_len, tail, tailLen);
+    memcpy(out + headLen + s_line_len + tailLen, s_response, kept);
+    s_used += len;
+    s_lines++;
+    s_last = s_started;
+    xSemaphoreGive(s_lock);
+}
+
+// Writes header and entries of log to current session
+void cliRecordDump(void){
+    uint8_t header[15] = { 'R', 'H', CLI_RECORD_VERSION };
+    size_t used = 0;
+    if(s_lock != NULL){
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        cliRecordPut(header + 3, s_lines, 4);
+        cliRecordPut(header + 7, s_dropped, 4);
+        used = s_used;
+        xSemaphoreGive(s_lock);
+    }
+    cliRecordPut(header + 11, used, 4);
+    cliSessionWrite((const char *)header, sizeof(header));
+    // Entries up to 'used' are not changed any more, log itself is freed only by a command
+    if(used)
+        cliSessionWrite((const char *)s_log, used);
+}
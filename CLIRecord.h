@@ -0,0 +1,66 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLIRecord.h
+*/
+#ifndef _CLIRECORD_H_
+#define _CLIRECORD_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#include "CLISession.h"
+
+// Log size which is allocated by 'record start', it can be given in KB up to the limit
+#define CLI_RECORD_DEFAULT_KB (16)
+#define CLI_RECORD_MAX_KB (128)
+// Response bytes kept per line, longer responses keep their length and hash only
+#define CLI_RECORD_RESPONSE_MAX (512)
+// Log format version which is written in header
+#define CLI_RECORD_VERSION (1)
+
+/* Every line which is run by cliExecuteLine() (serial console and TCP), by a REQUEST frame, by a UDP
+ * datagram or by an 'every' period is recorded with its session, start time, execution time and response.
+ * Datagrams and 'every' runs belong to buffer sessions. A background job is recorded as the line which
+ * starts it, output it collects later is not. Lines of 'record' command are not recorded, so a log can be
+ * downloaded while recording. One line is recorded at a time, a line of another task which starts
+ * meanwhile is counted as dropped.
+ * Log is binary, integers are little endian, 'varint' is LEB128 of up to 64 bits (10 bytes):
+ *   Header : 'R' 'H' | version (1) | lines (4) | dropped lines (4) | length of entries (4)
+ *   Entry  : 'E' | session id (varint) | transport (1) | start delta us (varint) | execution us (varint)
+ *            | status (zigzag varint) | command return (zigzag varint) | line length (varint) | line
+ *            | response length (varint) | kept length (varint) | response FNV-1a hash (4) | kept response
+ * Start delta is time since start of previous line, first one counts from record start. Recording stops
+ * when log is full, later lines are counted as dropped. */
+
+// Recorder states
+typedef enum{
+    CLI_RECORD_IDLE = 0,
+    CLI_RECORD_RUNNING,
+    CLI_RECORD_FULL,
+    CLI_RECORD_STOPPED
+}cliRecordState_t;
+
+// Recorder status
+typedef struct{
+    cliRecordState_t state;
+    size_t size;
+    size_t used;
+    uint32_t lines;
+    uint32_t dropped;
+}cliRecordStatus_t;
+
+esp_err_t cliRecordStart(size_t);
+void cliRecordStop(void);
+void cliRecordClear(void);
+void cliRecordGetStatus(cliRecordStatus_t*);
+const char *cliRecordStateName(cliRecordState_t);
+bool cliRecordBegin(cliSession_t*, const char*);
+void cliRecordEnd(esp_err_t, int);
+bool cliRecordCapturing(const cliSession_t*);
+void cliRecordOutput(const cliSession_t*, const char*, size_t);
+void cliRecordDump(void);
+
+#endif
@@ -0,0 +1,285 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLISched.c
+*/
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "CLI.h"
+#include "CLISession.h"
+#include "CLISched.h"
+#include "CLIJson.h"
+#include "CLIRecord.h"
+
+// TAG for scheduler log functions
+static const char *TAGSCHED = "Scheduler";
+// Job table
+static cliSchedJob_t s_jobs[CLI_SCHED_MAX_JOBS];
+// Timer wheel, every slot is a list of jobs linked by their index
+static int8_t s_slots[CLI_SCHED_WHEEL_SLOTS];
+// Wheel tick counter
+static uint32_t s_tick = 0;
+// Protects job table and wheel, it is never held while a command runs
+static SemaphoreHandle_t s_lock;
+static TaskHandle_t s_task;
+// Output of running job is collected here
+static cliSession_t *s_buffer;
+static uint8_t s_next_id = 1;
+// CPU accounting
+static uint8_t s_cap = CLI_SCHED_CPU_CAP_PERCENT;
+static int64_t s_window_start;
+static uint64_t s_window_busy;
+static uint8_t s_last_load;
+
+// Puts job into the slot which is reached after delay ticks, lock must be held
+static void cliSchedInsert(int index, uint32_t delay){
+    cliSchedJob_t *job = &s_jobs[index];
+    if(delay == 0)
+        delay = 1;
+    job->slot = (s_tick + delay) % CLI_SCHED_WHEEL_SLOTS;
+    job->rounds = (delay - 1) / CLI_SCHED_WHEEL_SLOTS;
+    job->next = s_slots[job->slot];
+    s_slots[job->slot] = index;
+}
+
+// Removes job from its slot, lock must be held
+static void cliSchedUnlink(int index){
+    int8_t *link = &s_slots[s_jobs[index].slot];
+    while(*link >= 0){
+        if(*link == index){
+            *link = s_jobs[index].next;
+            return;
+        }
+        link = &s_jobs[*link].next;
+    }
+}
+
+// FNV-1a hash of job output
+static uint32_t cliSchedHash(const char *data, size_t len){
+    uint32_t hash = 2166136261u;
+    for(size_t i = 0; i < len; i++){
+        hash ^= (uint8_t)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Frees a job whose owner session is closed, session lock of owner must be held
+static bool cliSchedOrphan(cliSchedJob_t *job){
+    cliSession_t *owner = job->owner;
+    if(owner->used && owner->id == job->ownerId)
+        return false;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    job->used = false;
+    xSemaphoreGive(s_lock);
+    ESP_LOGI(TAGSCHED, "Job %d cancelled, owner session closed", job->id);
+    return true;
+}
+
+// Runs one job and pushes its output to owner session if it changed
+static void cliSchedRunJob(cliSchedJob_t *job){
+    // Owner is checked before every run, output of a job may never change and so never be pushed
+    cliSessionLock(job->owner);
+    bool orphan = cliSchedOrphan(job);
+    cliSessionUnlock(job->owner);
+    if(orphan)
+        return;
+    // Jobs are deferred to next period when CPU budget of current window is spent
+    uint64_t budget = (uint64_t)CLI_SCHED_CPU_WINDOW_MS * 1000 * s_cap / 100;
+    if(s_window_busy >= budget){
+        job->deferred++;
+        return;
+    }
+
+    s_buffer->txLen = 0;
+    s_buffer->truncated = false;
+    // Only run time of the command is charged, not the time it waits for commands of other sessions
+    cliCommandLock(1);
+    int64_t start = esp_timer_get_time();
+    bool recording = cliRecordBegin(s_buffer, job->line);
+    int ret;
+    esp_err_t err = cliRunCommand(s_buffer, job->line, &ret);
+    cliCommandControl(err, ret);
+    if(recording)
+        cliRecordEnd(err, ret);
+    uint64_t busy = esp_timer_get_time() - start;
+    cliCommandUnlock();
+    job->busyUs += busy;
+    s_window_busy += busy;
+    uint32_t hash = cliSchedHash(s_buffer->txBuffer, s_buffer->txLen);
+    job->runs++;
+
+    // Skip the push when output is same as last pushed one
+    if(job->hasHash && job->lastHash == hash)
+        job->unchanged++;
+    else{
+        cliSession_t *owner = job->owner;
+        cliSessionLock(owner);
+        // Owner may disconnect while the command runs
+        if(cliSchedOrphan(job)){
+            cliSessionUnlock(owner);
+            return;
+        }
+        cliSessionEventBegin(owner);
+        if(owner->format == CLI_SESSION_FORMAT_JSON){
+            cliJson_t json;
+            cliJsonBeginEvent(&json, owner);
+            cliJsonString(&json, "event", "every");
+            cliJsonInt(&json, "id", job->id);
+            cliJsonStringN(&json, "output", s_buffer->txBuffer, s_buffer->txLen);
+            cliJsonBool(&json, "truncated", s_buffer->truncated);
+            cliJsonEnd(&json);
+        }
+        else{
+            char header[24];
+            int len = snprintf(header, sizeof(header), "[every %d]\n", job->id);
+            cliSessionWriteRaw(owner, header, len);
+            cliSessionWriteRaw(owner, s_buffer->txBuffer, s_buffer->txLen);
+            if(s_buffer->truncated)
+                cliSessionWriteRaw(owner, "...\n", 4);
+        }
+        cliSessionEventEnd(owner);
+        cliSessionUnlock(owner);
+        job->lastHash = hash;
+        job->hasHash = true;
+    }
+}
+
+// Scheduler task, it advances the wheel every tick
+static void cliSchedTask(void *pvParameters){
+    cliSessionSetCurrent(s_buffer);
+    s_window_start = esp_timer_get_time();
+    TickType_t last = xTaskGetTickCount();
+    while(1){
+        vTaskDelayUntil(&last, pdMS_TO_TICKS(CLI_SCHED_TICK_MS));
+        int due[CLI_SCHED_MAX_JOBS];
+        int count = 0;
+
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_tick++;
+        int64_t now = esp_timer_get_time();
+        if(now - s_window_start >= CLI_SCHED_CPU_WINDOW_MS * 1000){
+            s_last_load = s_window_busy * 100 / (now - s_window_start);
+            s_window_busy = 0;
+            s_window_start = now;
+        }
+        // Collect due jobs, they are run without lock so 'every' can be used meanwhile
+        int8_t *link = &s_slots[s_tick % CLI_SCHED_WHEEL_SLOTS];
+        while(*link >= 0){
+            cliSchedJob_t *job = &s_jobs[*link];
+            if(job->rounds > 0){
+                job->rounds--;
+                link = &job->next;
+                continue;
+            }
+            due[count++] = *link;
+            job->running = true;
+            *link = job->next;
+        }
+        xSemaphoreGive(s_lock);
+
+        for(int i = 0; i < count; i++){
+            cliSchedJob_t *job = &s_jobs[due[i]];
+            if(job->used)
+                cliSchedRunJob(job);
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            job->running = false;
+            if(job->used)
+                cliSchedInsert(due[i], job->periodTicks);
+            xSemaphoreGive(s_lock);
+        }
+    }
+}
+
+// Starts scheduler task on first use
+static bool cliSchedStart(void){
+    if(s_task != NULL)
+        return true;
+    s_buffer = cliSessionOpen(CLI_SESSION_BUFFER, -1);
+    if(s_buffer == NULL)
+        return false;
+    s_lock = xSemaphoreCreateMutex();
+    memset(s_slots, -1, sizeof(s_slots));
+    if(xTaskCreate(cliSchedTask, "cli_sched", CLI_SCHED_TASK_STACK, NULL, CLI_SCHED_TASK_PRIORITY, &s_task) != pdPASS){
+        ESP_LOGE(TAGSCHED, "Unable to create scheduler task!");
+        return false;
+    }
+    return true;
+}
+
+// Adds a periodic job, returns its id or -1 if table is full
+int cliSchedAdd(cliSession_t *owner, uint32_t periodMs, const char *line){
+    if(!cliSchedStart())
+        return -1;
+    int id = -1;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for(int i = 0; i < CLI_SCHED_MAX_JOBS; i++){
+        cliSchedJob_t *job = &s_jobs[i];
+        if(job->used || job->running)
+            continue;
+        memset(job, 0, sizeof(*job));
+        job->used = true;
+        job->id = s_next_id++;
+        if(s_next_id == 0)
+            s_next_id = 1;
+        strlcpy(job->line, line, sizeof(job->line));
+        job->periodTicks = (periodMs + CLI_SCHED_TICK_MS - 1) / CLI_SCHED_TICK_MS;
+        job->owner = owner;
+        job->ownerId = owner->id;
+        cliSchedInsert(i, job->periodTicks);
+        id = job->id;
+        break;
+    }
+    xSemaphoreGive(s_lock);
+    return id;
+}
+
+// Cancels a job, returns -1 if there is no job with given id
+int cliSchedCancel(int id){
+    if(s_task == NULL)
+        return -1;
+    int err = -1;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for(int i = 0; i < CLI_SCHED_MAX_JOBS; i++){
+        cliSchedJob_t *job = &s_jobs[i];
+        if(!job->used || job->id != id)
+            continue;
+        // Running job is not in the wheel, scheduler drops it after the run
+        if(!job->running)
+            cliSchedUnlink(i);
+        job->used = false;
+        err = 0;
+        break;
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+// Sets share of CPU time which jobs may use
+void cliSchedSetCap(uint8_t percent){
+    s_cap = percent;
+}
+
+// Prints job table to current session
+void cliSchedList(void){
+    cliSessionPrintf("ID  PERIOD(ms)  RUNS  UNCHANGED  DEFERRED  AVG(us)  COMMAND\n");
+    if(s_task != NULL){
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        for(int i = 0; i < CLI_SCHED_MAX_JOBS; i++){
+            cliSchedJob_t *job = &s_jobs[i];
+            if(!job->used)
+                continue;
+            cliSessionPrintf("%-3d %-11u %-5u %-10u %-9u %-8u %s\n", job->id, job->periodTicks * CLI_SCHED_TICK_MS,
+                             job->runs, job->unchanged, job->deferred,
+                             job->runs ? (uint32_t)(job->busyUs / job->runs) : 0, job->line);
+        }
+        xSemaphoreGive(s_lock);
+    }
+    cliSessionPrintf("Scheduler CPU: %u%% (cap %u%%)\n", s_last_load, s_cap);
+}
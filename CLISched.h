@@ -0,0 +1,58 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLISched.h
+*/
+#ifndef _CLISCHED_H_
+#define _CLISCHED_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "CLISession.h"
+
+// Maximum number of periodic jobs
+#define CLI_SCHED_MAX_JOBS (8)
+// Timer wheel resolution and size, periods longer than one turn wait extra rounds
+#define CLI_SCHED_TICK_MS (10)
+#define CLI_SCHED_WHEEL_SLOTS (64)
+// Command line length of a job
+#define CLI_SCHED_LINE_LEN (128)
+// Shortest period of a job
+#define CLI_SCHED_MIN_PERIOD_MS (50)
+// Default share of CPU time which jobs may use in a window
+#define CLI_SCHED_CPU_CAP_PERCENT (20)
+#define CLI_SCHED_CPU_WINDOW_MS (1000)
+// Scheduler task settings
+#define CLI_SCHED_TASK_STACK (4096)
+#define CLI_SCHED_TASK_PRIORITY (5)
+
+// Periodic job
+typedef struct{
+    bool used;
+    uint8_t id;
+    char line[CLI_SCHED_LINE_LEN];
+    uint32_t periodTicks;
+    // Wheel position
+    uint16_t slot;
+    uint32_t rounds;
+    int8_t next;
+    bool running;
+    // Session which receives the results
+    cliSession_t *owner;
+    uint32_t ownerId;
+    // Hash of last pushed output
+    uint32_t lastHash;
+    bool hasHash;
+    // Statistics
+    uint32_t runs;
+    uint32_t unchanged;
+    uint32_t deferred;
+    uint64_t busyUs;
+}cliSchedJob_t;
+
+int cliSchedAdd(cliSession_t*, uint32_t, const char*);
+int cliSchedCancel(int);
+void cliSchedSetCap(uint8_t);
+void cliSchedList(void);
+
+#endif
@@ -0,0 +1,533 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLISession.c
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "lwip/sockets.h"
+#include "driver/uart.h"
+
+#include "CLI.h"
+#include "CLISession.h"
+#include "CLIFrame.h"
+#include "CLIUart.h"
+#include "CLIJson.h"
+#include "CLIConfig.h"
+#include "CLIRecord.h"
+
+// TAG for ESP TCP log functions
+static const char *TAGTCP = "TCP Application";
+// Session table
+static cliSession_t s_sessions[CLI_SESSION_MAX];
+// Session which each command running task writes to
+static struct{
+    TaskHandle_t task;
+    cliSession_t *session;
+}s_bindings[CLI_SESSION_TASK_MAX];
+// Protects session table and task bindings
+static SemaphoreHandle_t s_table_lock;
+// Id of next opened session, so stale references to a reused slot can be detected
+static uint32_t s_next_id = 1;
+
+// Creates locks, must be called before any task uses sessions
+void cliSessionInit(void){
+    s_table_lock = xSemaphoreCreateMutex();
+    for(int i = 0; i < CLI_SESSION_MAX; i++)
+        s_sessions[i].lock = xSemaphoreCreateRecursiveMutex();
+}
+
+// Opens a session for given transport, fd is ignored for UART
+cliSession_t *cliSessionOpen(cliSessionTransport_t transport, int fd){
+    xSemaphoreTake(s_table_lock, portMAX_DELAY);
+    for(int i = 0; i < CLI_SESSION_MAX; i++){
+        cliSession_t *session = &s_sessions[i];
+        if(session->used)
+            continue;
+        SemaphoreHandle_t lock = session->lock;
+        memset(session, 0, sizeof(*session));
+        session->lock = lock;
+        session->used = true;
+        session->id = s_next_id++;
+        session->transport = transport;
+        session->fd = fd;
+        session->flushTimerMs = cliConfigGet(CLI_CONFIG_FLUSH_TIMER);
+        session->txLimit = transport == CLI_SESSION_TCP ? cliConfigGet(CLI_CONFIG_TX_COALESCE) : sizeof(session->txBuffer);
+        xSemaphoreGive(s_table_lock);
+        cliSessionSetPolicy(session, transport == CLI_SESSION_TCP ? CLI_SESSION_DEFAULT_POLICY : CLI_SESSION_POLICY_DEFAULT);
+        // Network clients are rate limited, serial console and server side sessions are not
+        if(transport == CLI_SESSION_TCP)
+            cliSessionSetRate(session, cliConfigGet(CLI_CONFIG_RATE_COMMANDS), cliConfigGet(CLI_CONFIG_RATE_BYTES));
+        return session;
+    }
+    xSemaphoreGive(s_table_lock);
+    ESP_LOGE(TAGTCP, "No free session!");
+    return NULL;
+}
+
+// Closes a session, pending output is dropped because peer is already gone
+void cliSessionClose(cliSession_t *session){
+    if(session == NULL)
+        return;
+    cliSessionLock(session);
+    xSemaphoreTake(s_table_lock, portMAX_DELAY);
+    for(int i = 0; i < CLI_SESSION_TASK_MAX; i++){
+        if(s_bindings[i].session == session){
+            s_bindings[i].task = NULL;
+            s_bindings[i].session = NULL;
+        }
+    }
+    session->used = false;
+    session->fd = -1;
+    session->txLen = 0;
+    free(session->eventBuffer);
+    session->eventBuffer = NULL;
+    session->eventLen = 0;
+    xSemaphoreGive(s_table_lock);
+    cliSessionUnlock(session);
+}
+
+// Returns session in given slot of session table, it may be unused
+cliSession_t *cliSessionAt(int index){
+    if(index < 0 || index >= CLI_SESSION_MAX)
+        return NULL;
+    return &s_sessions[index];
+}
+
+// Returns the session which the running command of calling task writes to
+cliSession_t *cliSessionGetCurrent(void){
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    for(int i = 0; i < CLI_SESSION_TASK_MAX; i++){
+        if(s_bindings[i].task == task)
+            return s_bindings[i].session;
+    }
+    return NULL;
+}
+
+// Sets the session which next commands of calling task write to
+void cliSessionSetCurrent(cliSession_t *session){
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    int free = -1;
+    xSemaphoreTake(s_table_lock, portMAX_DELAY);
+    for(int i = 0; i < CLI_SESSION_TASK_MAX; i++){
+        if(s_bindings[i].task == task){
+            // Unbound entries are released, worker tasks come and go
+            s_bindings[i].session = session;
+            if(session == NULL)
+                s_bindings[i].task = NULL;
+            xSemaphoreGive(s_table_lock);
+            return;
+        }
+        if(free < 0 && s_bindings[i].task == NULL)
+            free = i;
+    }
+    if(session == NULL){
+        xSemaphoreGive(s_table_lock);
+        return;
+    }
+    if(free >= 0){
+        s_bindings[free].task = task;
+        s_bindings[free].session = session;
+    }
+    else
+        ESP_LOGE(TAGTCP, "No free task binding!");
+    xSemaphoreGive(s_table_lock);
+}
+
+// Takes session lock, writers from different tasks are serialized by it
+void cliSessionLock(cliSession_t *session){
+    xSemaphoreTakeRecursive(session->lock, portMAX_DELAY);
+}
+
+// Gives session lock
+void cliSessionUnlock(cliSession_t *session){
+    xSemaphoreGiveRecursive(session->lock);
+}
+
+// Returns printable name of a policy
+const char *cliSessionPolicyName(cliSessionPolicy_t policy){
+    switch(policy){
+        case CLI_SESSION_POLICY_LOW_LATENCY: return "latency";
+        case CLI_SESSION_POLICY_THROUGHPUT:  return "throughput";
+        default:                             return "default";
+    }
+}
+
+// Returns printable name of a transport
+const char *cliSessionTransportName(cliSessionTransport_t transport){
+    switch(transport){
+        case CLI_SESSION_UART:  return "uart";
+        case CLI_SESSION_TCP:   return "tcp";
+        case CLI_SESSION_FRAME: return "frame";
+        default:                return "buffer";
+    }
+}
+
+// Returns printable name of an output format
+const char *cliSessionFormatName(cliSessionFormat_t format){
+    return format == CLI_SESSION_FORMAT_JSON ? "json" : "text";
+}
+
+// Returns true if session carries binary output unchanged. Serial line mode translates line endings, JSON
+// sessions escape output and buffer sessions of jobs keep only one MSS of it
+bool cliSessionIsBinary(const cliSession_t *session){
+    return session != NULL && (session->transport == CLI_SESSION_TCP || session->transport == CLI_SESSION_FRAME) &&
+           session->format == CLI_SESSION_FORMAT_TEXT;
+}
+
+// Returns true if client sent input which is not received yet, a closed TCP peer counts as input.
+// Input is only peeked, so it is run as next command after the streaming command returns
+bool cliSessionHasInput(const cliSession_t *session){
+    if(session == NULL)
+        return false;
+    if(session->transport == CLI_SESSION_TCP){
+        char c;
+        return recv(session->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) >= 0;
+    }
+    if(session->transport == CLI_SESSION_FRAME){
+        size_t available = 0;
+        uart_get_buffered_data_len(UART_PORT, &available);
+        return available > 0;
+    }
+    return false;
+}
+
+// Applies a policy to the session and its socket options
+int cliSessionSetPolicy(cliSession_t *session, cliSessionPolicy_t policy){
+    if(session == NULL)
+        return -1;
+    // Pending bytes belong to the old policy
+    if(session->txLen > 0)
+        cliSessionFlush(session, CLI_SESSION_FLUSH_END);
+    session->policy = policy;
+    if(session->transport != CLI_SESSION_TCP)
+        return 0;
+
+    // Nagle is disabled just for low latency, throughput mode relies on it for the timer-flushed tail
+    int noDelay = (policy == CLI_SESSION_POLICY_LOW_LATENCY) ? 1 : 0;
+    if(setsockopt(session->fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay)) != 0){
+        ESP_LOGE(TAGTCP, "Unable to set TCP_NODELAY: errno %d", errno);
+        return -1;
+    }
+    return 0;
+}
+
+// Sends raw bytes to the socket, partial sends are completed
+static void cliSessionSend(cliSession_t *session, const char *data, size_t len){
+    while(len > 0){
+        int sent = send(session->fd, data, len, 0);
+        if(sent < 0){
+            ESP_LOGE(TAGTCP, "Error occurred during sending: errno %d", errno);
+            session->stats.txErrors++;
+            return;
+        }
+        session->stats.txCalls++;
+        session->stats.txBytes += sent;
+        data += sent;
+        len -= sent;
+    }
+}
+
+// Sends the coalescing buffer of the session
+void cliSessionFlush(cliSession_t *session, cliSessionFlushReason_t reason){
+    if(session == NULL)
+        return;
+    if(session->transport == CLI_SESSION_UART){
+        fflush(stdout);
+        return;
+    }
+    // Buffer sessions are read by their owner
+    if(session->transport == CLI_SESSION_BUFFER)
+        return;
+    cliSessionLock(session);
+    if(session->txLen == 0){
+        cliSessionUnlock(session);
+        return;
+    }
+    if(session->transport == CLI_SESSION_FRAME){
+        // Output is longer than one frame, framed loop sends the final part with status
+        cliFrameSend(CLI_FRAME_RESPONSE_MORE, session->frameSeq, (const uint8_t *)session->txBuffer, session->txLen);
+        session->stats.txBytes += session->txLen;
+    }
+    else{
+        ESP_LOGI(TAGTCP, "Sending %d bytes with TCP Protocol", session->txLen);
+        cliSessionSend(session, session->txBuffer, session->txLen);
+    }
+    session->txLen = 0;
+    session->stats.flushes[reason]++;
+    cliSessionUnlock(session);
+}
+
+// Appends output of a staged event to event buffer, an event which does not fit is dropped as a whole
+static void cliSessionStage(cliSession_t *session, const char *data, size_t len){
+    if(session->eventOverflow)
+        return;
+    if(session->eventBuffer == NULL)
+        session->eventBuffer = malloc(CLI_SESSION_EVENT_SIZE);
+    if(session->eventBuffer == NULL || len > CLI_SESSION_EVENT_SIZE - session->eventLen){
+        session->eventOverflow = true;
+        return;
+    }
+    memcpy(session->eventBuffer + session->eventLen, data, len);
+    session->eventLen += len;
+}
+
+// Returns true if session writes frames to UART, console session does so while framed mode is on
+static bool cliSessionIsFramed(const cliSession_t *session){
+    return session->transport == CLI_SESSION_FRAME || (session->transport == CLI_SESSION_UART && cliFrameIsActive());
+}
+
+// Writes bytes to given session through its coalescing buffer, text is not wrapped for JSON sessions
+void cliSessionWriteRaw(cliSession_t *session, const char *data, size_t len){
+    if(session == NULL){
+        ESP_LOGE(TAGTCP, "No Connection!");
+        return;
+    }
+    // Staged event is collected, it is not a part of a command response
+    if(session->eventTask != NULL && session->eventTask == xTaskGetCurrentTaskHandle()){
+        cliSessionStage(session, data, len);
+        return;
+    }
+    session->stats.outBytes += len;
+    cliRecordOutput(session, data, len);
+    if(session->transport == CLI_SESSION_UART){
+        fwrite(data, 1, len, stdout);
+        return;
+    }
+    cliSessionLock(session);
+    // Response bytes are charged to byte bucket, a large response makes the bucket negative
+    if(session->rate.bytesPerSec != 0)
+        session->rate.byteTokens -= (int64_t)len * 1000;
+    while(len > 0){
+        size_t space = session->txLen < session->txLimit ? session->txLimit - session->txLen : 0;
+        if(space == 0){
+            // Buffer sessions keep the head of the output
+            if(session->transport == CLI_SESSION_BUFFER){
+                session->truncated = true;
+                break;
+            }
+            cliSessionFlush(session, CLI_SESSION_FLUSH_FULL);
+            continue;
+        }
+        size_t chunk = len < space ? len : space;
+        if(session->txLen == 0)
+            session->pendingSince = esp_timer_get_time();
+        memcpy(session->txBuffer + session->txLen, data, chunk);
+        session->txLen += chunk;
+        data += chunk;
+        len -= chunk;
+    }
+    cliSessionUnlock(session);
+}
+
+// Writes bytes to given session, text output of a command is wrapped when session format is JSON
+void cliSessionWriteTo(cliSession_t *session, const char *data, size_t len){
+    if(session != NULL && (session->jsonState == CLI_SESSION_JSON_PENDING || session->jsonState == CLI_SESSION_JSON_STRING)){
+        cliSessionLock(session);
+        cliJsonWrapText(session, data, len);
+        cliSessionUnlock(session);
+        return;
+    }
+    cliSessionWriteRaw(session, data, len);
+}
+
+// Writes bytes to current session
+void cliSessionWrite(const char *data, size_t len){
+    cliSessionWriteTo(cliSessionGetCurrent(), data, len);
+}
+
+// Formatted write to current session, text is formatted in place of the coalescing buffer when it fits
+void cliSessionPrintf(const char *fmt, ...){
+    cliSession_t *session = cliSessionGetCurrent();
+    va_list args;
+    if(session == NULL){
+        ESP_LOGE(TAGTCP, "No Connection!");
+        return;
+    }
+    // Text which is wrapped in JSON must be escaped and recorded text must be seen by the recorder,
+    // so neither can be formatted in place
+    bool wrap = session->jsonState == CLI_SESSION_JSON_PENDING || session->jsonState == CLI_SESSION_JSON_STRING ||
+                cliRecordCapturing(session);
+    if(session->transport == CLI_SESSION_UART && !wrap){
+        va_start(args, fmt);
+        vprintf(fmt, args);
+        va_end(args);
+        return;
+    }
+
+    cliSessionLock(session);
+    bool direct = !wrap;
+    size_t space = direct && session->txLen < session->txLimit ? session->txLimit - session->txLen : 0;
+    va_start(args, fmt);
+    int len = vsnprintf(direct ? session->txBuffer + session->txLen : NULL, space, fmt, args);
+    va_end(args);
+    if(direct && len >= 0 && (size_t)len < space){
+        if(session->txLen == 0)
+            session->pendingSince = esp_timer_get_time();
+        session->txLen += len;
+    }
+    else if(len >= 0){
+        // Text does not fit in the remaining space or must be escaped, format it in a scratch buffer first
+        char scratch[256];
+        char *text = (size_t)len < sizeof(scratch) ? scratch : malloc(len + 1);
+        if(text != NULL){
+            va_start(args, fmt);
+            vsnprintf(text, len + 1, fmt, args);
+            va_end(args);
+            cliSessionWriteTo(session, text, len);
+            if(text != scratch)
+                free(text);
+        }
+    }
+    cliSessionUnlock(session);
+}
+
+// Called when a command finished, flushes according to session policy
+void cliSessionEndResponse(cliSession_t *session){
+    if(session == NULL)
+        return;
+    session->stats.commands++;
+    // Events which arrived during the response follow it
+    cliSessionLock(session);
+    session->busy = false;
+    if(session->eventLen > 0 && session->eventTask == NULL){
+        cliSessionWriteRaw(session, session->eventBuffer, session->eventLen);
+        session->eventLen = 0;
+    }
+    cliSessionUnlock(session);
+    // Throughput policy keeps the tail until buffer is full or timer expires
+    if(session->policy == CLI_SESSION_POLICY_THROUGHPUT && session->transport == CLI_SESSION_TCP)
+        return;
+    cliSessionFlush(session, CLI_SESSION_FLUSH_END);
+}
+
+// Marks start of a command response, events of other tasks are held until cliSessionEndResponse()
+void cliSessionBeginResponse(cliSession_t *session){
+    if(session == NULL)
+        return;
+    cliSessionLock(session);
+    session->busy = true;
+    cliSessionUnlock(session);
+}
+
+// Returns true if an event would land in the middle of an open response of the session
+static bool cliSessionIsBusy(const cliSession_t *session){
+    return session->busy || session->jsonState != CLI_SESSION_JSON_IDLE;
+}
+
+/* Starts output of another task on a session, e.g. a job notice or an 'every' push. Session lock must be
+ * held until cliSessionEventEnd(). Framed links get the event as EVENT frames, so it is collected first;
+ * text between frames would be taken into the next frame and break its CRC. An event which arrives while
+ * a response is open is collected too and held until the response ends, so a JSON line or text response
+ * is never split by it. The serial console erases its prompt line while the user edits a line. */
+void cliSessionEventBegin(cliSession_t *session){
+    session->eventStart = session->eventLen;
+    session->eventOverflow = false;
+    bool staged = cliSessionIsFramed(session) || cliSessionIsBusy(session);
+    session->eventTask = staged ? xTaskGetCurrentTaskHandle() : NULL;
+    session->eventErased = !staged && cliConsoleAsyncBegin(session);
+}
+
+// Ends output which is started by cliSessionEventBegin() and sends it unless a response is open
+void cliSessionEventEnd(cliSession_t *session){
+    if(session->eventTask != NULL){
+        session->eventTask = NULL;
+        if(session->eventOverflow){
+            session->eventLen = session->eventStart;
+            session->stats.eventsDropped++;
+        }
+        if(session->eventLen == 0)
+            return;
+        if(cliSessionIsFramed(session))
+            cliFrameSendEvent(session->eventBuffer, session->eventLen);
+        else if(cliSessionIsBusy(session))
+            return;
+        else
+            cliSessionWriteRaw(session, session->eventBuffer, session->eventLen);
+        session->eventLen = 0;
+        return;
+    }
+    cliConsoleAsyncEnd(session->eventErased);
+    if(session->policy != CLI_SESSION_POLICY_THROUGHPUT)
+        cliSessionFlush(session, CLI_SESSION_FLUSH_END);
+}
+
+// Called after every receive, accounts bytes and re-arms quick-ack for low latency policy
+void cliSessionAfterReceive(cliSession_t *session, size_t len){
+    if(session == NULL)
+        return;
+    session->stats.rxBytes += len;
+#ifdef TCP_QUICKACK
+    // lwIP has no delayed ack option, quick-ack is only available on hosts which support it
+    if(session->policy == CLI_SESSION_POLICY_LOW_LATENCY && session->transport == CLI_SESSION_TCP){
+        int quickAck = 1;
+        setsockopt(session->fd, IPPROTO_TCP, TCP_QUICKACK, &quickAck, sizeof(quickAck));
+    }
+#endif
+}
+
+// Returns remaining milliseconds until pending bytes must be flushed, -1 if nothing is pending
+int cliSessionPendingTimeout(cliSession_t *session){
+    if(session == NULL || session->transport != CLI_SESSION_TCP || session->txLen == 0)
+        return -1;
+    int64_t elapsed = (esp_timer_get_time() - session->pendingSince) / 1000;
+    if(elapsed >= session->flushTimerMs)
+        return 0;
+    return (int)(session->flushTimerMs - elapsed);
+}
+
+// Sets rate limits of a session, 0 means unlimited. Buckets start full
+void cliSessionSetRate(cliSession_t *session, uint32_t commandsPerSec, uint32_t bytesPerSec){
+    cliSessionLock(session);
+    session->rate.commandsPerSec = commandsPerSec;
+    session->rate.bytesPerSec = bytesPerSec;
+    session->rate.commandTokens = (int64_t)commandsPerSec * CLI_SESSION_RATE_BURST_MS;
+    session->rate.byteTokens = (int64_t)bytesPerSec * CLI_SESSION_RATE_BURST_MS;
+    session->rate.lastRefill = esp_timer_get_time();
+    cliSessionUnlock(session);
+}
+
+// Adds tokens for elapsed time, rate per second is rate thousandths per millisecond
+static void cliSessionRefill(cliSessionRate_t *rate){
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed = now - rate->lastRefill;
+    rate->lastRefill = now;
+    rate->commandTokens += elapsed * rate->commandsPerSec / 1000;
+    if(rate->commandTokens > (int64_t)rate->commandsPerSec * CLI_SESSION_RATE_BURST_MS)
+        rate->commandTokens = (int64_t)rate->commandsPerSec * CLI_SESSION_RATE_BURST_MS;
+    rate->byteTokens += elapsed * rate->bytesPerSec / 1000;
+    if(rate->byteTokens > (int64_t)rate->bytesPerSec * CLI_SESSION_RATE_BURST_MS)
+        rate->byteTokens = (int64_t)rate->bytesPerSec * CLI_SESSION_RATE_BURST_MS;
+}
+
+// Takes one command from the buckets. Returns 0 if command may run, otherwise milliseconds until it may
+int cliSessionRateCheck(cliSession_t *session){
+    if(session == NULL)
+        return 0;
+    cliSessionLock(session);
+    cliSessionRate_t *rate = &session->rate;
+    cliSessionRefill(rate);
+    int64_t wait = 0;
+    if(rate->commandsPerSec != 0 && rate->commandTokens < 1000)
+        wait = (1000 - rate->commandTokens + rate->commandsPerSec - 1) / rate->commandsPerSec;
+    if(rate->bytesPerSec != 0 && rate->byteTokens <= 0){
+        int64_t byteWait = (-rate->byteTokens + rate->bytesPerSec) / rate->bytesPerSec;
+        if(byteWait > wait)
+            wait = byteWait;
+    }
+    if(wait == 0){
+        if(rate->commandsPerSec != 0)
+            rate->commandTokens -= 1000;
+    }
+    else
+        session->stats.limited++;
+    cliSessionUnlock(session);
+    return (int)wait;
+}
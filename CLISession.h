@@ -0,0 +1,160 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLISession.h
+*/
+#ifndef _CLISESSION_H_
+#define _CLISESSION_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+// Maximum number of sessions which can be open at the same time, TCP clients share them with jobs and UDP
+#define CLI_SESSION_MAX (12)
+// Maximum number of tasks which run commands, each one is bound to its current session
+#define CLI_SESSION_TASK_MAX (8)
+// Coalescing buffer size, it is equal to default lwIP TCP MSS so a full buffer is exactly one segment
+#define CLI_SESSION_MSS (1436)
+// Receive buffer of stream sessions, it is equal to console line length
+#define CLI_SESSION_RX_SIZE (256)
+// Flush timer for throughput policy in milliseconds
+#define CLI_SESSION_FLUSH_TIMER_MS (20)
+// Policy which is applied to every new TCP session
+#define CLI_SESSION_DEFAULT_POLICY (CLI_SESSION_POLICY_DEFAULT)
+// Default rate limits of network sessions, 0 means unlimited
+#define CLI_SESSION_RATE_COMMANDS (20)
+#define CLI_SESSION_RATE_BYTES (32768)
+// Depth of token buckets as time of rate, bursts up to it are accepted
+#define CLI_SESSION_RATE_BURST_MS (2000)
+// Events of other tasks which are collected before they are sent, e.g. for an EVENT frame or while a
+// response of the session is open. An 'every' push of a full buffer session fits with its header
+#define CLI_SESSION_EVENT_SIZE (2048)
+
+// Transport types of a session
+typedef enum{
+    CLI_SESSION_UART = 0,
+    CLI_SESSION_TCP,
+    CLI_SESSION_FRAME,
+    CLI_SESSION_BUFFER              // Output is kept in txBuffer, used for server side command runs
+}cliSessionTransport_t;
+
+// Flush/latency policies of a session
+typedef enum{
+    CLI_SESSION_POLICY_DEFAULT = 0,     // lwIP default options, response flushed at end of command
+    CLI_SESSION_POLICY_LOW_LATENCY,     // TCP_NODELAY + quick-ack, response flushed at end of command
+    CLI_SESSION_POLICY_THROUGHPUT       // Nagle on, writes coalesced up to MSS or flush timer
+}cliSessionPolicy_t;
+
+// Reasons for a flush, used for statistics
+typedef enum{
+    CLI_SESSION_FLUSH_END = 0,          // End of response
+    CLI_SESSION_FLUSH_FULL,             // Coalescing buffer reached MSS
+    CLI_SESSION_FLUSH_TIMER,            // Flush timer expired
+    CLI_SESSION_FLUSH_REASON_COUNT
+}cliSessionFlushReason_t;
+
+// Output formats of a session
+typedef enum{
+    CLI_SESSION_FORMAT_TEXT = 0,
+    CLI_SESSION_FORMAT_JSON
+}cliSessionFormat_t;
+
+// JSON response state of running command
+typedef enum{
+    CLI_SESSION_JSON_IDLE = 0,          // Text session or no command runs
+    CLI_SESSION_JSON_PENDING,           // Nothing written yet, text output is wrapped when it comes
+    CLI_SESSION_JSON_STRING,            // Text output is escaped into "output" string
+    CLI_SESSION_JSON_DONE               // Command wrote a structured response
+}cliSessionJson_t;
+
+// Per session statistics
+typedef struct{
+    uint32_t commands;
+    uint32_t rxBytes;
+    uint32_t txBytes;
+    uint32_t txCalls;
+    uint32_t txErrors;
+    uint32_t flushes[CLI_SESSION_FLUSH_REASON_COUNT];
+    uint32_t outBytes;              // Bytes written by commands, before coalescing
+    uint32_t limited;               // Lines answered with "rate limited"
+    uint32_t eventsDropped;         // Events which did not fit in event buffer
+}cliSessionStats_t;
+
+// Token buckets of a session for commands and response bytes, tokens are kept in thousandths
+typedef struct{
+    uint32_t commandsPerSec;
+    uint32_t bytesPerSec;
+    int64_t commandTokens;
+    int64_t byteTokens;
+    int64_t lastRefill;
+}cliSessionRate_t;
+
+// Session structure, one for every connected client
+typedef struct{
+    bool used;
+    uint32_t id;
+    SemaphoreHandle_t lock;
+    cliSessionTransport_t transport;
+    int fd;
+    uint16_t frameSeq;
+    cliSessionPolicy_t policy;
+    uint32_t flushTimerMs;
+    int64_t pendingSince;
+    cliSessionFormat_t format;
+    cliSessionJson_t jsonState;
+    bool busy;                      // A command response is open, events are held until it ends
+    // Peer address and received bytes which are not a complete line yet
+    char peer[16];
+    size_t rxLen;
+    bool rxDiscard;                 // Rest of a line which did not fit is dropped up to its end
+    char rxBuffer[CLI_SESSION_RX_SIZE];
+    // Rate limiting and fair scheduling state
+    cliSessionRate_t rate;
+    int32_t deficit;
+    size_t txLen;
+    size_t txLimit;                 // Coalesced bytes which trigger a send
+    bool truncated;
+    char txBuffer[CLI_SESSION_MSS];
+    // Events of other tasks (job notices, 'every' pushes), they are collected here while staged
+    TaskHandle_t eventTask;         // Task whose writes are staged, NULL while no event is staged
+    bool eventErased;               // Console prompt is erased for the event
+    bool eventOverflow;
+    size_t eventStart;
+    size_t eventLen;
+    char *eventBuffer;              // Allocated when first event is staged
+    cliSessionStats_t stats;
+}cliSession_t;
+
+void cliSessionInit(void);
+cliSession_t *cliSessionOpen(cliSessionTransport_t, int);
+void cliSessionClose(cliSession_t*);
+cliSession_t *cliSessionAt(int);
+cliSession_t *cliSessionGetCurrent(void);
+void cliSessionSetCurrent(cliSession_t*);
+int cliSessionSetPolicy(cliSession_t*, cliSessionPolicy_t);
+const char *cliSessionPolicyName(cliSessionPolicy_t);
+const char *cliSessionFormatName(cliSessionFormat_t);
+bool cliSessionIsBinary(const cliSession_t*);
+bool cliSessionHasInput(const cliSession_t*);
+void cliSessionLock(cliSession_t*);
+void cliSessionUnlock(cliSession_t*);
+void cliSessionWrite(const char*, size_t);
+void cliSessionWriteTo(cliSession_t*, const char*, size_t);
+void cliSessionWriteRaw(cliSession_t*, const char*, size_t);
+void cliSessionPrintf(const char*, ...) __attribute__((format(printf, 1, 2)));
+void cliSessionFlush(cliSession_t*, cliSessionFlushReason_t);
+void cliSessionBeginResponse(cliSession_t*);
+void cliSessionEndResponse(cliSession_t*);
+void cliSessionEventBegin(cliSession_t*);
+void cliSessionEventEnd(cliSession_t*);
+void cliSessionAfterReceive(cliSession_t*, size_t);
+int cliSessionPendingTimeout(cliSession_t*);
+void cliSessionSetRate(cliSession_t*, uint32_t, uint32_t);
+int cliSessionRateCheck(cliSession_t*);
+const char *cliSessionTransportName(cliSessionTransport_t);
+
+#endif
@@ -33,24 +33,31 @@
 
 #include "CLI.h"
 #include "CLISocket.h"
+#include "CLISession.h"
+#include "CLIConfig.h"
 
-// This value (sock) is using for multiple source file so I defined it by extern keyword in other source files. Extern from CLI.h
-extern int sock;
 // TAG for ESP Wifi log functions
 static const char *TAGWIFI = "Wifi Station";
 // TAG for ESP TCP log functions
 static const char *TAGTCP = "TCP Application";
+// Listening socket of TCP server
+static int s_listen_sock = -1;
+// Session slot which starts next scheduling round
+static int s_next_slot = 0;
 // FreeRTOS event group to signal when we are connected
 static EventGroupHandle_t s_wifi_event_group;
 // Retry number for wifi connect
 static int s_retry_num = 0;
+// Wi-Fi event handlers, registered from start until association ends
+static esp_event_handler_instance_t s_instance_any_id;
+static esp_event_handler_instance_t s_instance_got_ip;
 
 // Event handler for wifi connect
 void cliSocketEventHandler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data){
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
         esp_wifi_connect();
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        if (s_retry_num < ESP_MAXIMUM_RETRY) {
+        if (s_retry_num < cliConfigGet(CLI_CONFIG_WIFI_RETRY)) {
             esp_wifi_connect();
             s_retry_num++;
             ESP_LOGI(TAGWIFI, "retry to connect to the AP");
@@ -66,8 +73,8 @@ void cliSocketEventHandler(void* arg, esp_event_base_t event_base, int32_t event
     }
 }
 
-// Wifi init function for connection
-void cliSocketWifiInit(void){
+// Wifi init function, it starts association and returns, cliSocketWifiWait waits for its result
+void cliSocketWifiStart(void){
     s_wifi_event_group = xEventGroupCreate();
 
     ESP_ERROR_CHECK(esp_netif_init());
@@ -78,27 +85,31 @@ void cliSocketWifiInit(void){
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
-    esp_event_handler_instance_t instance_any_id;
-    esp_event_handler_instance_t instance_got_ip;
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &cliSocketEventHandler, NULL, &instance_any_id));
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &cliSocketEventHandler, NULL, &instance_got_ip));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &cliSocketEventHandler, NULL, &s_instance_any_id));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &cliSocketEventHandler, NULL, &s_instance_got_ip));
 
     wifi_config_t wifi_config = {
         .sta = {
-            .ssid = ESP_WIFI_SSID,
-            .password = ESP_WIFI_PASS,
             /* Setting a password implies station will connect to all security modes including WEP/WPA.
              * However these modes are deprecated and not advisable to be used. Incase your Access point
              * doesn't support WPA2, these mode can be enabled by commenting below line */
 	     .threshold.authmode = WIFI_AUTH_WPA2_PSK,
         },
     };
+    // Network name and password come from configuration store
+    strlcpy((char *)wifi_config.sta.ssid, cliConfigGetString(CLI_CONFIG_WIFI_SSID), sizeof(wifi_config.sta.ssid));
+    strlcpy((char *)wifi_config.sta.password, cliConfigGetString(CLI_CONFIG_WIFI_PASS), sizeof(wifi_config.sta.password));
+    if(wifi_config.sta.password[0] == 0)
+        wifi_config.sta.threshold.authmode = WIFI_AUTH_OPEN;
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA) );
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config) );
     ESP_ERROR_CHECK(esp_wifi_start() );
 
     ESP_LOGI(TAGWIFI, "wifi_init_sta finished.");
+}
 
+// Waits until Wifi is connected or retries are used up
+void cliSocketWifiWait(void){
     /* Waiting until either the connection is established (WIFI_CONNECTED_BIT) or connection failed for the maximum
      * number of re-tries (WIFI_FAIL_BIT). The bits are set by cliSocketEventHandler() (see above) */
     EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
@@ -110,31 +121,224 @@ void cliSocketWifiInit(void){
     /* xEventGroupWaitBits() returns the bits before the call returned, hence we can test which event actually
      * happened. */
     if (bits & WIFI_CONNECTED_BIT) {
-        ESP_LOGI(TAGWIFI, "connected to ap SSID:%s password:%s", ESP_WIFI_SSID, ESP_WIFI_PASS);
+        ESP_LOGI(TAGWIFI, "connected to ap SSID:%s", cliConfigGetString(CLI_CONFIG_WIFI_SSID));
     } 
     else if (bits & WIFI_FAIL_BIT) {
-        ESP_LOGI(TAGWIFI, "Failed to connect to SSID:%s, password:%s", ESP_WIFI_SSID, ESP_WIFI_PASS);
+        ESP_LOGI(TAGWIFI, "Failed to connect to SSID:%s", cliConfigGetString(CLI_CONFIG_WIFI_SSID));
     } 
     else {
         ESP_LOGE(TAGWIFI, "UNEXPECTED EVENT");
     }
 
     /* The event will not be processed after unregister */
-    ESP_ERROR_CHECK(esp_event_handler_instance_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, instance_got_ip));
-    ESP_ERROR_CHECK(esp_event_handler_instance_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, instance_any_id));
+    ESP_ERROR_CHECK(esp_event_handler_instance_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, s_instance_got_ip));
+    ESP_ERROR_CHECK(esp_event_handler_instance_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, s_instance_any_id));
     vEventGroupDelete(s_wifi_event_group);
 }
 
 // Start screen function for TCP protocol, it prints the menu
 void cliSocketInitTCPScreen(void){
-    strcpy(transmittedBuffer, "\n========== ESP32 Console Project =========="
-                              "\nTo Seeing All Registered Command Type 'help'"
-                              "\n============================================");
-    size_t size = strlen(transmittedBuffer);
-    int err = send(sock, transmittedBuffer, size, 0);
-    if(err < 0)
-        ESP_LOGE(TAGTCP, "Error occurred during sending!");
+    cliSessionPrintf("\n========== ESP32 Console Project =========="
+                     "\nTo Seeing All Registered Command Type 'help'"
+                     "\n============================================");
+    cliSessionFlush(cliSessionGetCurrent(), CLI_SESSION_FLUSH_END);
+}
+
+// Returns true if session is a connected TCP client
+static bool cliSocketIsClient(cliSession_t *session){
+    return session->used && session->transport == CLI_SESSION_TCP;
+}
+
+// Returns true if receive buffer has a complete line or it is full
+static bool cliSocketHasLine(cliSession_t *session){
+    if(session->rxLen == sizeof(session->rxBuffer))
+        return true;
+    for(size_t i = 0; i < session->rxLen; i++){
+        if(session->rxBuffer[i] == '\n' || session->rxBuffer[i] == '\r')
+            return true;
+    }
+    return false;
+}
+
+// Takes first complete line from receive buffer, empty lines of CR LF pairs are skipped
+static bool cliSocketNextLine(cliSession_t *session, char *line){
+    size_t i = 0;
+    while(i < session->rxLen){
+        if(session->rxBuffer[i] != '\n' && session->rxBuffer[i] != '\r'){
+            i++;
+            continue;
+        }
+        memcpy(line, session->rxBuffer, i);
+        line[i] = 0;
+        session->rxLen -= i + 1;
+        memmove(session->rxBuffer, session->rxBuffer + i + 1, session->rxLen);
+        if(i > 0)
+            return true;
+        i = 0;
+    }
+    return false;
 }
 
+// Drops received bytes up to the end of a line which did not fit in receive buffer
+static void cliSocketDiscard(cliSession_t *session){
+    for(size_t i = 0; i < session->rxLen; i++){
+        if(session->rxBuffer[i] == '\n' || session->rxBuffer[i] == '\r'){
+            session->rxLen -= i + 1;
+            memmove(session->rxBuffer, session->rxBuffer + i + 1, session->rxLen);
+            session->rxDiscard = false;
+            return;
+        }
+    }
+    session->rxLen = 0;
+}
 
+// Closes a client which is disconnected
+static void cliSocketDrop(cliSession_t *session){
+    int fd = session->fd;
+    cliSessionClose(session);
+    shutdown(fd, 0);
+    close(fd);
+}
+
+// Accepts a client, it is refused if all client slots are used
+static void cliSocketAccept(int clients){
+    struct sockaddr_in source_addr;
+    socklen_t addr_len = sizeof(source_addr);
+    int fd = accept(s_listen_sock, (struct sockaddr *)&source_addr, &addr_len);
+    if(fd < 0){
+        ESP_LOGE(TAGTCP, "Unable to accept connection: errno %d", errno);
+        return;
+    }
+    cliSession_t *session = clients < cliConfigGet(CLI_CONFIG_MAX_CLIENTS) ? cliSessionOpen(CLI_SESSION_TCP, fd) : NULL;
+    if(session == NULL){
+        const char *busy = "Too many clients, try again later!\n";
+        send(fd, busy, strlen(busy), 0);
+        shutdown(fd, 0);
+        close(fd);
+        return;
+    }
+    // Convert ip address to string
+    inet_ntoa_r(source_addr.sin_addr.s_addr, session->peer, sizeof(session->peer) - 1);
+    ESP_LOGI(TAGTCP, "Socket Accepted IP Address: %s", session->peer);
+    // Prints menu to new client
+    cliSession_t *previous = cliSessionGetCurrent();
+    cliSessionSetCurrent(session);
+    cliSocketInitTCPScreen();
+    cliSessionSetCurrent(previous);
+}
 
+// Receives available bytes of a client into its session
+static void cliSocketReceive(cliSession_t *session){
+    size_t space = sizeof(session->rxBuffer) - session->rxLen;
+    if(space == 0)
+        return;
+    int len = recv(session->fd, session->rxBuffer + session->rxLen, space, MSG_DONTWAIT);
+    if(len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return;
+    if(len < 0){
+        ESP_LOGE(TAGTCP, "Error occurred during receiving: errno %d", errno);
+        cliSocketDrop(session);
+    }
+    else if(len == 0){
+        ESP_LOGI(TAGTCP, "Connection closed ( %s )", session->peer);
+        cliSocketDrop(session);
+    }
+    else{
+        ESP_LOGI(TAGTCP, "Received %d bytes from %s", len, session->peer);
+        session->rxLen += len;
+        cliSessionAfterReceive(session, len);
+        if(session->rxDiscard)
+            cliSocketDiscard(session);
+    }
+}
+
+// Starts serving clients of a listening socket
+void cliSocketServerStart(int listenSock){
+    s_listen_sock = listenSock;
+}
+
+// Waits for new clients, received bytes and flush timers of throughput policy
+void cliSocketPoll(void){
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    FD_SET(s_listen_sock, &readSet);
+    int maxFd = s_listen_sock;
+    int timeout = -1;
+    int clients = 0;
+    for(int i = 0; i < CLI_SESSION_MAX; i++){
+        cliSession_t *session = cliSessionAt(i);
+        if(!cliSocketIsClient(session))
+            continue;
+        clients++;
+        FD_SET(session->fd, &readSet);
+        if(session->fd > maxFd)
+            maxFd = session->fd;
+        int pending = cliSessionPendingTimeout(session);
+        if(pending >= 0 && (timeout < 0 || pending < timeout))
+            timeout = pending;
+        // Lines which are left from last round are scheduled without waiting
+        if(cliSocketHasLine(session))
+            timeout = 0;
+    }
+    struct timeval tv = { .tv_sec = timeout / 1000, .tv_usec = (timeout % 1000) * 1000 };
+    int count = select(maxFd + 1, &readSet, NULL, NULL, timeout >= 0 ? &tv : NULL);
+    if(count < 0){
+        ESP_LOGE(TAGTCP, "Error occurred during select: errno %d", errno);
+        vTaskDelay(pdMS_TO_TICKS(100));
+        return;
+    }
+    for(int i = 0; i < CLI_SESSION_MAX; i++){
+        cliSession_t *session = cliSessionAt(i);
+        if(cliSocketIsClient(session) && cliSessionPendingTimeout(session) == 0)
+            cliSessionFlush(session, CLI_SESSION_FLUSH_TIMER);
+    }
+    if(count == 0)
+        return;
+    for(int i = 0; i < CLI_SESSION_MAX; i++){
+        cliSession_t *session = cliSessionAt(i);
+        if(cliSocketIsClient(session) && FD_ISSET(session->fd, &readSet))
+            cliSocketReceive(session);
+    }
+    if(FD_ISSET(s_listen_sock, &readSet))
+        cliSocketAccept(clients);
+}
+
+/* Runs complete lines of clients with deficit round robin. Every client with lines gets a quantum of
+ * response bytes in a round and runs lines while its deficit is positive. Cost of a line is known after
+ * it runs, so the deficit may become negative and the client waits next rounds until it is paid. A
+ * client spamming large responses gets the same share of the link as an interactive one.
+ * Scheduling is per command: lines of all clients run one after another on this task, so a command
+ * which runs long (top, capture, adc_stream, bus delays) delays every other client until it returns. */
+void cliSocketSchedule(void){
+    static char line[CLI_SESSION_RX_SIZE];
+    for(int n = 0; n < CLI_SESSION_MAX; n++){
+        cliSession_t *session = cliSessionAt((s_next_slot + n) % CLI_SESSION_MAX);
+        if(!cliSocketIsClient(session))
+            continue;
+        if(!cliSocketHasLine(session)){
+            // Idle client keeps no credit
+            if(session->deficit > 0)
+                session->deficit = 0;
+            continue;
+        }
+        uint32_t id = session->id;
+        session->deficit += cliConfigGet(CLI_CONFIG_DRR_QUANTUM);
+        while(session->used && session->id == id && session->deficit > 0){
+            cliSessionSetCurrent(session);
+            uint32_t written = session->stats.outBytes;
+            if(cliSocketNextLine(session, line))
+                cliExecuteLine(line);
+            else if(session->rxLen == sizeof(session->rxBuffer)){
+                // Line does not fit in receive buffer, it is dropped up to its end so its tail is not run
+                session->rxLen = 0;
+                session->rxDiscard = true;
+                cliSessionPrintf("Command is too long!\n");
+                cliSessionEndResponse(session);
+            }
+            else
+                break;
+            session->deficit -= CLI_SOCKET_COMMAND_COST + (int32_t)(session->stats.outBytes - written);
+        }
+    }
+    s_next_slot = (s_next_slot + 1) % CLI_SESSION_MAX;
+}
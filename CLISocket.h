@@ -6,7 +6,7 @@
 #ifndef _CLISOCKET_H_
 #define _CLISOCKET_H_
 
-// For connect wifi just change SSID and Password macros
+// Default Wi-Fi settings, they can be changed at runtime with 'config set'
 #define ESP_WIFI_SSID      "YourSSID"
 #define ESP_WIFI_PASS      "YourPassword"
 #define ESP_MAXIMUM_RETRY  100
@@ -17,8 +17,19 @@
 #define WIFI_CONNECTED_BIT BIT0
 #define WIFI_FAIL_BIT      BIT1
 
+// Maximum number of TCP clients which are served at the same time, 'max_clients' can lower it
+#define CLI_SOCKET_MAX_CLIENTS (4)
+// Response bytes which a client may get in one scheduling round
+#define CLI_SOCKET_DRR_QUANTUM (1436)
+// Cost of running a command in addition to its response bytes
+#define CLI_SOCKET_COMMAND_COST (64)
+
 void cliSocketEventHandler(void*, esp_event_base_t, int32_t, void*);
-void cliSocketWifiInit(void);
+void cliSocketWifiStart(void);
+void cliSocketWifiWait(void);
 void cliSocketInitTCPScreen(void);
+void cliSocketServerStart(int);
+void cliSocketPoll(void);
+void cliSocketSchedule(void);
 
 #endif
@@ -0,0 +1,421 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLITop.c
+*/
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "CLISession.h"
+#include "CLIJson.h"
+#include "CLIJob.h"
+#include "CLITop.h"
+
+// Firmware reads FreeRTOS run time stats, host build reads /proc
+#if defined(ESP_PLATFORM) && !CONFIG_IDF_TARGET_LINUX
+#define CLI_TOP_PROC (0)
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "lwip/stats.h"
+#else
+#define CLI_TOP_PROC (1)
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#endif
+
+// Counters of all tasks at one moment
+typedef struct{
+    int64_t wall;                           // microseconds
+    uint32_t time;                          // run time counter, it wraps
+    uint32_t idle[CLI_TOP_MAX_CORES];       // run time counter of idle task of every core
+    uint8_t cores;
+    uint16_t taskCount;
+    uint16_t count;
+    cliTopTask_t tasks[CLI_TOP_MAX_TASKS];
+    uint32_t runTime[CLI_TOP_MAX_TASKS];
+}cliTopSnapshot_t;
+
+// Buffers are used by one 'top' at a time, they are too large for job stacks
+static cliTopSnapshot_t s_snapshots[2];
+static cliTopSample_t s_sample;
+static bool s_busy = false;
+
+#if !CLI_TOP_PROC
+
+// Returns short name of a task state
+static const char *cliTopStateName(eTaskState state){
+    switch(state){
+        case eRunning:   return "run";
+        case eReady:     return "ready";
+        case eBlocked:   return "block";
+        case eSuspended: return "susp";
+        case eDeleted:   return "del";
+        default:         return "?";
+    }
+}
+
+// Takes run time counters of all tasks
+static bool cliTopTake(cliTopSnapshot_t *snapshot){
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+    // Room for tasks which are created meanwhile, uxTaskGetSystemState fails if array is short
+    UBaseType_t size = uxTaskGetNumberOfTasks() + 4;
+    TaskStatus_t *status = malloc(size * sizeof(TaskStatus_t));
+    if(status == NULL)
+        return false;
+    uint32_t total;
+    UBaseType_t count = uxTaskGetSystemState(status, size, &total);
+    snapshot->wall = esp_timer_get_time();
+    snapshot->time = total;
+    snapshot->cores = portNUM_PROCESSORS;
+    snapshot->taskCount = count;
+    snapshot->count = 0;
+    memset(snapshot->idle, 0, sizeof(snapshot->idle));
+    for(UBaseType_t i = 0; i < count; i++){
+        for(int core = 0; core < portNUM_PROCESSORS; core++){
+            if(status[i].xHandle == xTaskGetIdleTaskHandleForCPU(core))
+                snapshot->idle[core] = status[i].ulRunTimeCounter;
+        }
+        if(snapshot->count == CLI_TOP_MAX_TASKS)
+            continue;
+        cliTopTask_t *task = &snapshot->tasks[snapshot->count];
+        strlcpy(task->name, status[i].pcTaskName, sizeof(task->name));
+        task->id = status[i].xTaskNumber;
+        task->priority = status[i].uxCurrentPriority;
+        BaseType_t affinity = xTaskGetAffinity(status[i].xHandle);
+        task->core = affinity == tskNO_AFFINITY ? -1 : affinity;
+        task->state = cliTopStateName(status[i].eCurrentState);
+        // Stack is counted in bytes by ESP-IDF
+        task->stackFree = status[i].usStackHighWaterMark;
+        snapshot->runTime[snapshot->count++] = status[i].ulRunTimeCounter;
+    }
+    free(status);
+    return count > 0;
+#else
+    return false;
+#endif
+}
+
+// Reads heap and lwIP pool usage
+static void cliTopSystem(cliTopSample_t *sample){
+    sample->freeHeap = esp_get_free_heap_size();
+    sample->minFreeHeap = esp_get_minimum_free_heap_size();
+    sample->largestBlock = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    sample->poolCount = 0;
+#if LWIP_STATS && MEMP_STATS
+    // Every socket holds a netconn, so NETCONN usage is socket usage
+    static const struct{
+        const char *name;
+        memp_t type;
+    }pools[] = {
+        { "PBUF_POOL", MEMP_PBUF_POOL },
+        { "PBUF", MEMP_PBUF },
+        { "NETCONN", MEMP_NETCONN },
+        { "TCP_PCB", MEMP_TCP_PCB },
+        { "UDP_PCB", MEMP_UDP_PCB }
+    };
+    for(int i = 0; i < sizeof(pools) / sizeof(pools[0]) && i < CLI_TOP_MAX_POOLS; i++){
+        const struct stats_mem *stats = lwip_stats.memp[pools[i].type];
+        if(stats == NULL)
+            continue;
+        cliTopPool_t *pool = &sample->pools[sample->poolCount++];
+        pool->name = pools[i].name;
+        pool->used = stats->used;
+        pool->max = stats->max;
+        pool->avail = stats->avail;
+    }
+#endif
+}
+
+#else
+
+// Returns monotonic time in microseconds
+static int64_t cliTopNow(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+// Returns short name of a /proc task state
+static const char *cliTopStateName(char state){
+    switch(state){
+        case 'R': return "run";
+        case 'S':
+        case 'D': return "block";
+        case 'T':
+        case 't': return "susp";
+        case 'Z':
+        case 'X': return "del";
+        default:  return "?";
+    }
+}
+
+// Reads idle time of every core from /proc/stat
+static void cliTopCores(cliTopSnapshot_t *snapshot, long hz){
+    FILE *file = fopen("/proc/stat", "r");
+    snapshot->cores = 0;
+    if(file == NULL)
+        return;
+    char line[256];
+    while(fgets(line, sizeof(line), file) != NULL && snapshot->cores < CLI_TOP_MAX_CORES){
+        unsigned long long idle, iowait;
+        // First line is sum of all cores
+        if(strncmp(line, "cpu", 3) != 0 || line[3] < '0' || line[3] > '9' ||
+           sscanf(line + 3, "%*u %*u %*u %*u %llu %llu", &idle, &iowait) != 2)
+            continue;
+        snapshot->idle[snapshot->cores++] = (uint32_t)((idle + iowait) * 1000000 / hz);
+    }
+    fclose(file);
+}
+
+// Takes CPU time of all threads of the process
+static bool cliTopTake(cliTopSnapshot_t *snapshot){
+    long hz = sysconf(_SC_CLK_TCK);
+    DIR *dir = opendir("/proc/self/task");
+    if(dir == NULL || hz <= 0){
+        if(dir != NULL)
+            closedir(dir);
+        return false;
+    }
+    snapshot->wall = cliTopNow();
+    snapshot->time = (uint32_t)snapshot->wall;
+    snapshot->taskCount = 0;
+    snapshot->count = 0;
+    struct dirent *entry;
+    while((entry = readdir(dir)) != NULL){
+        if(entry->d_name[0] == '.')
+            continue;
+        snapshot->taskCount++;
+        if(snapshot->count == CLI_TOP_MAX_TASKS)
+            continue;
+        char path[64], line[512];
+        snprintf(path, sizeof(path), "/proc/self/task/%s/stat", entry->d_name);
+        FILE *file = fopen(path, "r");
+        if(file == NULL)
+            continue;
+        bool got = fgets(line, sizeof(line), file) != NULL;
+        fclose(file);
+        // Thread name may have spaces and parentheses, fields start after the last ')'
+        char *nameStart = got ? strchr(line, '(') : NULL;
+        char *nameEnd = got ? strrchr(line, ')') : NULL;
+        char state;
+        unsigned long utime, stime;
+        long priority;
+        if(nameStart == NULL || nameEnd == NULL || nameEnd < nameStart ||
+           sscanf(nameEnd + 2, "%c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu %*d %*d %ld",
+                  &state, &utime, &stime, &priority) != 4)
+            continue;
+        cliTopTask_t *task = &snapshot->tasks[snapshot->count];
+        size_t len = nameEnd - nameStart - 1;
+        if(len >= sizeof(task->name))
+            len = sizeof(task->name) - 1;
+        memcpy(task->name, nameStart + 1, len);
+        task->name[len] = 0;
+        task->id = strtoul(entry->d_name, NULL, 10);
+        task->priority = priority;
+        task->core = -1;
+        task->state = cliTopStateName(state);
+        task->stackFree = 0;
+        snapshot->runTime[snapshot->count++] = (uint32_t)((unsigned long long)(utime + stime) * 1000000 / hz);
+    }
+    closedir(dir);
+    cliTopCores(snapshot, hz);
+    return snapshot->count > 0;
+}
+
+// Reads available memory and socket usage of the host
+static void cliTopSystem(cliTopSample_t *sample){
+    static uint32_t minFree = UINT32_MAX;
+    char line[128];
+    sample->freeHeap = 0;
+    sample->largestBlock = 0;
+    sample->poolCount = 0;
+    FILE *file = fopen("/proc/meminfo", "r");
+    if(file != NULL){
+        unsigned long long kb;
+        while(fgets(line, sizeof(line), file) != NULL){
+            if(sscanf(line, "MemAvailable: %llu kB", &kb) == 1){
+                sample->freeHeap = kb * 1024 > UINT32_MAX ? UINT32_MAX : kb * 1024;
+                break;
+            }
+        }
+        fclose(file);
+    }
+    if(sample->freeHeap < minFree)
+        minFree = sample->freeHeap;
+    sample->minFreeHeap = minFree;
+    // Host has no fixed pools, only usage is known
+    file = fopen("/proc/net/sockstat", "r");
+    if(file != NULL){
+        unsigned used;
+        while(fgets(line, sizeof(line), file) != NULL && sample->poolCount < CLI_TOP_MAX_POOLS){
+            const char *name = NULL;
+            if(sscanf(line, "sockets: used %u", &used) == 1)
+                name = "sockets";
+            else if(sscanf(line, "TCP: inuse %u", &used) == 1)
+                name = "TCP";
+            else if(sscanf(line, "UDP: inuse %u", &used) == 1)
+                name = "UDP";
+            if(name == NULL)
+                continue;
+            cliTopPool_t *pool = &sample->pools[sample->poolCount++];
+            pool->name = name;
+            pool->used = used;
+            pool->max = 0;
+            pool->avail = 0;
+        }
+        fclose(file);
+    }
+}
+
+#endif
+
+// Waits one interval, returns false if job is cancelled meanwhile
+static bool cliTopWait(uint32_t intervalMs){
+    for(uint32_t waited = 0; waited < intervalMs; waited += CLI_TOP_POLL_MS){
+        uint32_t step = intervalMs - waited < CLI_TOP_POLL_MS ? intervalMs - waited : CLI_TOP_POLL_MS;
+        // Command lock is released while sleeping, abort is checked after it is taken back
+        if(cliJobSleep(step))
+            return false;
+    }
+    return true;
+}
+
+// Computes shares of the interval between two snapshots, tasks are sorted by cpu
+static void cliTopCompare(const cliTopSnapshot_t *first, const cliTopSnapshot_t *last, cliTopSample_t *sample){
+    uint32_t elapsed = last->time - first->time;
+    if(elapsed == 0)
+        elapsed = 1;
+    sample->intervalMs = (last->wall - first->wall) / 1000;
+    sample->cores = last->cores;
+    for(int core = 0; core < last->cores; core++){
+        uint32_t idle = last->idle[core] - first->idle[core];
+        sample->coreLoad[core] = idle >= elapsed ? 0 : 1000 - (uint64_t)idle * 1000 / elapsed;
+    }
+    sample->taskCount = last->taskCount;
+    sample->shown = last->count;
+    for(int i = 0; i < last->count; i++){
+        uint32_t run = last->runTime[i];
+        // Task which is created in the interval has run since its creation
+        for(int j = 0; j < first->count; j++){
+            if(first->tasks[j].id == last->tasks[i].id){
+                run -= first->runTime[j];
+                break;
+            }
+        }
+        cliTopTask_t task = last->tasks[i];
+        task.cpu = (uint64_t)run * 1000 / elapsed;
+        int k = i;
+        while(k > 0 && sample->tasks[k - 1].cpu < task.cpu){
+            sample->tasks[k] = sample->tasks[k - 1];
+            k--;
+        }
+        sample->tasks[k] = task;
+    }
+}
+
+// Samples all tasks over an interval
+static cliTopStatus_t cliTopMeasure(cliTopSample_t *sample, uint32_t intervalMs){
+    if(!cliTopTake(&s_snapshots[0]))
+        return CLI_TOP_UNSUPPORTED;
+    if(!cliTopWait(intervalMs))
+        return CLI_TOP_ABORTED;
+    if(!cliTopTake(&s_snapshots[1]))
+        return CLI_TOP_UNSUPPORTED;
+    cliTopCompare(&s_snapshots[0], &s_snapshots[1], sample);
+    cliTopSystem(sample);
+    return CLI_TOP_OK;
+}
+
+// Prints a sample to current session
+static void cliTopPrint(const cliTopSample_t *sample){
+    if(cliJsonEnabled()){
+        cliJson_t json;
+        cliJsonBegin(&json, cliSessionGetCurrent());
+        cliJsonUint(&json, "interval_ms", sample->intervalMs);
+        cliJsonArray(&json, "cores");
+        for(int core = 0; core < sample->cores; core++)
+            cliJsonUint(&json, NULL, sample->coreLoad[core]);
+        cliJsonClose(&json);
+        cliJsonObject(&json, "heap");
+        cliJsonUint(&json, "free", sample->freeHeap);
+        cliJsonUint(&json, "min_free", sample->minFreeHeap);
+        cliJsonUint(&json, "largest_block", sample->largestBlock);
+        cliJsonClose(&json);
+        cliJsonArray(&json, "pools");
+        for(int i = 0; i < sample->poolCount; i++){
+            cliJsonObject(&json, NULL);
+            cliJsonString(&json, "name", sample->pools[i].name);
+            cliJsonUint(&json, "used", sample->pools[i].used);
+            cliJsonUint(&json, "max", sample->pools[i].max);
+            cliJsonUint(&json, "avail", sample->pools[i].avail);
+            cliJsonClose(&json);
+        }
+        cliJsonClose(&json);
+        cliJsonUint(&json, "task_count", sample->taskCount);
+        cliJsonArray(&json, "tasks");
+        for(int i = 0; i < sample->shown; i++){
+            const cliTopTask_t *task = &sample->tasks[i];
+            cliJsonObject(&json, NULL);
+            cliJsonUint(&json, "id", task->id);
+            cliJsonString(&json, "name", task->name);
+            cliJsonUint(&json, "priority", task->priority);
+            cliJsonInt(&json, "core", task->core);
+            cliJsonString(&json, "state", task->state);
+            cliJsonUint(&json, "cpu", task->cpu);
+            cliJsonUint(&json, "stack_free", task->stackFree);
+            cliJsonClose(&json);
+        }
+        cliJsonEnd(&json);
+        return;
+    }
+    cliSessionPrintf("Interval: %u ms, Tasks: %u\n", sample->intervalMs, sample->taskCount);
+    for(int core = 0; core < sample->cores; core++)
+        cliSessionPrintf("%sCPU%d: %u.%u%%", core ? ", " : "", core, sample->coreLoad[core] / 10, sample->coreLoad[core] % 10);
+    cliSessionPrintf("\nHeap: %u B free, %u B min free, %u B largest block\n",
+                     sample->freeHeap, sample->minFreeHeap, sample->largestBlock);
+    if(sample->poolCount){
+        cliSessionPrintf("lwIP:");
+        for(int i = 0; i < sample->poolCount; i++){
+            const cliTopPool_t *pool = &sample->pools[i];
+            if(pool->avail)
+                cliSessionPrintf(" %s %u/%u (max %u)", pool->name, pool->used, pool->avail, pool->max);
+            else
+                cliSessionPrintf(" %s %u", pool->name, pool->used);
+        }
+        cliSessionPrintf("\n");
+    }
+    cliSessionPrintf("ID     Name             Pri  Core  State   CPU%%   Stack\n");
+    for(int i = 0; i < sample->shown; i++){
+        const cliTopTask_t *task = &sample->tasks[i];
+        char core[4] = "-";
+        if(task->core >= 0)
+            snprintf(core, sizeof(core), "%d", task->core);
+        cliSessionPrintf("%-6u %-16s %-4u %-5s %-7s %3u.%u  %u\n", task->id, task->name, task->priority, core,
+                         task->state, task->cpu / 10, task->cpu % 10, task->stackFree);
+    }
+}
+
+// Prints count samples of given interval, 0 count runs until job is killed
+cliTopStatus_t cliTopRun(uint32_t intervalMs, uint32_t count){
+    if(s_busy)
+        return CLI_TOP_BUSY;
+    s_busy = true;
+    cliTopStatus_t status = CLI_TOP_OK;
+    for(uint32_t n = 0; count == 0 || n < count; n++){
+        status = cliTopMeasure(&s_sample, intervalMs);
+        if(status != CLI_TOP_OK)
+            break;
+        if(n > 0 && !cliJsonEnabled())
+            cliSessionPrintf("\n");
+        cliTopPrint(&s_sample);
+        // Every refresh is sent when it is complete
+        cliSessionFlush(cliSessionGetCurrent(), CLI_SESSION_FLUSH_END);
+    }
+    s_busy = false;
+    return status;
+}
@@ -0,0 +1,74 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLITop.h
+*/
+#ifndef _CLITOP_H_
+#define _CLITOP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Most tasks in one sample, uxTaskGetSystemState fails if the system has more
+#define CLI_TOP_MAX_TASKS (32)
+// Most cores which are reported
+#define CLI_TOP_MAX_CORES (8)
+// Most lwIP pools which are reported
+#define CLI_TOP_MAX_POOLS (6)
+// Task name length, it is configMAX_TASK_NAME_LEN of ESP-IDF
+#define CLI_TOP_NAME_LEN (16)
+// Default and shortest sample interval
+#define CLI_TOP_INTERVAL_MS (1000)
+#define CLI_TOP_MIN_INTERVAL_MS (100)
+// Longest time sampler sleeps, it checks job cancellation after that
+#define CLI_TOP_POLL_MS (100)
+
+/* CPU shares are given in permille of one core, so a busy task on a dual core chip is 1000 and sum of all
+ * tasks is up to 1000 * cores. Firmware needs CONFIG_FREERTOS_USE_TRACE_FACILITY and
+ * CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS, host build samples threads of the process from /proc. */
+
+// Task of a sample
+typedef struct{
+    char name[CLI_TOP_NAME_LEN];
+    uint32_t id;
+    uint32_t priority;
+    int8_t core;                // -1 if task may run on any core
+    const char *state;
+    uint32_t cpu;               // permille of one core
+    uint32_t stackFree;         // lowest free stack in bytes, 0 if it is unknown
+}cliTopTask_t;
+
+// lwIP memory pool usage
+typedef struct{
+    const char *name;
+    uint32_t used;
+    uint32_t max;               // high water mark
+    uint32_t avail;             // pool size, 0 if it is unknown
+}cliTopPool_t;
+
+// Result of one sample interval
+typedef struct{
+    uint32_t intervalMs;
+    uint8_t cores;
+    uint16_t coreLoad[CLI_TOP_MAX_CORES];   // permille
+    uint16_t taskCount;                     // tasks in system, tasks array may hold less
+    uint16_t shown;
+    cliTopTask_t tasks[CLI_TOP_MAX_TASKS];  // sorted by cpu
+    uint32_t freeHeap;
+    uint32_t minFreeHeap;
+    uint32_t largestBlock;
+    uint8_t poolCount;
+    cliTopPool_t pools[CLI_TOP_MAX_POOLS];
+}cliTopSample_t;
+
+// Result of a 'top' run
+typedef enum{
+    CLI_TOP_OK = 0,
+    CLI_TOP_UNSUPPORTED,
+    CLI_TOP_BUSY,
+    CLI_TOP_ABORTED
+}cliTopStatus_t;
+
+cliTopStatus_t cliTopRun(uint32_t, uint32_t);
+
+#endif
@@ -4,9 +4,66 @@
 * File   : CLIUart.c
 */
 #include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
 #include "driver/gpio.h"
 #include "driver/uart.h"
+#include "CLIGpio.h"
 #include "CLIUart.h"
+#include "CLIConfig.h"
+
+// TAG for UART log functions
+static const char *TAGUART = "UART";
+// Driver event queue
+static QueueHandle_t s_uart_queue;
+// Given by event task when new data is received
+static SemaphoreHandle_t s_rx_ready;
+// Current baud rate and flow control state
+static uint32_t s_baud_rate = UART_BAUD_RATE;
+static bool s_flow_ctrl = UART_HW_FLOWCTRL;
+// Driver event statistics
+static cliUartStats_t s_stats;
+
+// Event task, it drains the driver event queue and recovers from overflow
+static void cliUartEventTask(void *pvParameters){
+    uart_event_t event;
+    while(1){
+        if(xQueueReceive(s_uart_queue, &event, portMAX_DELAY) != pdTRUE)
+            continue;
+        switch(event.type){
+            case UART_DATA:
+                s_stats.dataEvents++;
+                s_stats.rxBytes += event.size;
+                xSemaphoreGive(s_rx_ready);
+                break;
+            case UART_FIFO_OVF:
+                // Reader could not keep up, drop everything and start clean
+                s_stats.fifoOverflows++;
+                uart_flush_input(UART_PORT);
+                xQueueReset(s_uart_queue);
+                break;
+            case UART_BUFFER_FULL:
+                s_stats.bufferFull++;
+                uart_flush_input(UART_PORT);
+                xQueueReset(s_uart_queue);
+                break;
+            case UART_FRAME_ERR:
+                s_stats.frameErrors++;
+                break;
+            case UART_PARITY_ERR:
+                s_stats.parityErrors++;
+                break;
+            case UART_BREAK:
+                s_stats.breaks++;
+                break;
+            default:
+                break;
+        }
+    }
+}
 
 // Uart config function
 void cliUartConfig(void){
@@ -14,12 +71,14 @@ void cliUartConfig(void){
     int err = 0;
     // Uart configuration 
     uart_config_t uart_config = {
-        .baud_rate = UART_BAUD_RATE,
+        .baud_rate = cliConfigGet(CLI_CONFIG_UART_BAUD),
         .data_bits = UART_DATA_8_BITS,
         .parity    = UART_PARITY_DISABLE,
         .stop_bits = UART_STOP_BITS_1,
-        .flow_ctrl  = UART_HW_FLOWCTRL_DISABLE
+        .flow_ctrl  = UART_HW_FLOWCTRL ? UART_HW_FLOWCTRL_CTS_RTS : UART_HW_FLOWCTRL_DISABLE,
+        .rx_flow_ctrl_thresh = UART_RX_FLOW_THRESH
     };
+    s_baud_rate = uart_config.baud_rate;
     // Uart parameters configuration function
     err = uart_param_config(UART_PORT, &uart_config);
     if(err == ESP_OK)
@@ -27,17 +86,121 @@ void cliUartConfig(void){
     else
         printf(">UART Configuration Fail!\n");
     // Uart set pins function
-    err = uart_set_pin(UART_PORT, UART_TX_PIN, UART_RX_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    err = uart_set_pin(UART_PORT, UART_TX_PIN, UART_RX_PIN,
+                       UART_HW_FLOWCTRL ? UART_RTS_PIN : UART_PIN_NO_CHANGE,
+                       UART_HW_FLOWCTRL ? UART_CTS_PIN : UART_PIN_NO_CHANGE);
+    if(err == ESP_OK && UART_HW_FLOWCTRL){
+        cliGpioClaim(UART_RTS_PIN, CLI_GPIO_OWNER_UART);
+        cliGpioClaim(UART_CTS_PIN, CLI_GPIO_OWNER_UART);
+    }
     if(err == ESP_OK)
         printf(">UART Set Pin Successful!\n");
     else
         printf(">UART Set Pin Fail!\n");
-    // Uart driver intallation function
-    err = uart_driver_install(UART_PORT, UART_READ_BUF_SIZE, 0, 0, NULL, 0);
+    // Uart driver intallation function, TX ring lets writers return before bytes drain
+    err = uart_driver_install(UART_PORT, cliConfigGet(CLI_CONFIG_UART_RX_BUF), UART_WRITE_BUF_SIZE, UART_EVENT_QUEUE_SIZE, &s_uart_queue, 0);
     if(err == ESP_OK)
         printf(">UART Driver Install Successful!\n");
-    else
-        printf(">UART Driver Install Fail!\n");    
+    else{
+        printf(">UART Driver Install Fail!\n");
+        return;
+    }
+    // Event task for driver event queue
+    s_rx_ready = xSemaphoreCreateBinary();
+    xTaskCreate(cliUartEventTask, "uart_event", 2048, NULL, 12, NULL);
+}
+
+// Returns current baud rate
+uint32_t cliUartGetBaudRate(void){
+    return s_baud_rate;
+}
+
+// Returns true if hardware flow control is on
+bool cliUartGetFlowControl(void){
+    return s_flow_ctrl;
+}
+
+// Returns driver event statistics
+const cliUartStats_t *cliUartGetStats(void){
+    return &s_stats;
+}
+
+// Waits until event task reports received data, returns false on timeout
+bool cliUartWaitData(uint32_t timeoutMs){
+    return xSemaphoreTake(s_rx_ready, pdMS_TO_TICKS(timeoutMs)) == pdTRUE;
+}
+
+// Switches to new baud rate and waits for the host to send a line ending at new rate.
+// Returns 0 if confirmed, 1 if old rate is restored and -1 on invalid rate
+int cliUartNegotiateBaudRate(uint32_t baudRate){
+    if(baudRate < UART_BAUD_MIN || baudRate > UART_BAUD_MAX)
+        return -1;
+    uint32_t oldRate = s_baud_rate;
+    // Announcement must leave the line at old rate
+    fflush(stdout);
+    uart_wait_tx_done(UART_PORT, pdMS_TO_TICKS(1000));
+    if(uart_set_baudrate(UART_PORT, baudRate) != ESP_OK)
+        return -1;
+    uart_flush_input(UART_PORT);
+
+    // Host confirms with CR or LF at new rate, any other byte is a mismatch symptom and ignored
+    TickType_t start = xTaskGetTickCount();
+    TickType_t limit = pdMS_TO_TICKS(UART_BAUD_CONFIRM_MS);
+    uint8_t byte;
+    while(xTaskGetTickCount() - start < limit){
+        TickType_t left = limit - (xTaskGetTickCount() - start);
+        if(uart_read_bytes(UART_PORT, &byte, 1, left) == 1 && (byte == '\r' || byte == '\n')){
+            s_baud_rate = baudRate;
+            ESP_LOGI(TAGUART, "Baud rate changed to %u", baudRate);
+            return 0;
+        }
+    }
+    // Fall back to the last working rate
+    uart_set_baudrate(UART_PORT, oldRate);
+    uart_flush_input(UART_PORT);
+    ESP_LOGW(TAGUART, "Baud rate %u not confirmed, restored %u", baudRate, oldRate);
+    return 1;
+}
+
+// Turns RTS/CTS hardware flow control on or off, returns 1 if a pin is driven by another peripheral
+int cliUartSetFlowControl(bool enable){
+    if(enable == s_flow_ctrl)
+        return 0;
+    esp_err_t err;
+    if(enable){
+        if(!cliGpioClaim(UART_RTS_PIN, CLI_GPIO_OWNER_UART))
+            return 1;
+        if(!cliGpioClaim(UART_CTS_PIN, CLI_GPIO_OWNER_UART)){
+            cliGpioRelease(UART_RTS_PIN, CLI_GPIO_OWNER_UART);
+            return 1;
+        }
+        uart_wait_tx_done(UART_PORT, pdMS_TO_TICKS(1000));
+        err = uart_set_pin(UART_PORT, UART_TX_PIN, UART_RX_PIN, UART_RTS_PIN, UART_CTS_PIN);
+        if(err == ESP_OK)
+            err = uart_set_hw_flow_ctrl(UART_PORT, UART_HW_FLOWCTRL_CTS_RTS, UART_RX_FLOW_THRESH);
+        if(err != ESP_OK){
+            cliGpioRelease(UART_RTS_PIN, CLI_GPIO_OWNER_UART);
+            cliGpioRelease(UART_CTS_PIN, CLI_GPIO_OWNER_UART);
+        }
+    }
+    else{
+        uart_wait_tx_done(UART_PORT, pdMS_TO_TICKS(1000));
+        err = uart_set_hw_flow_ctrl(UART_PORT, UART_HW_FLOWCTRL_DISABLE, UART_RX_FLOW_THRESH);
+        // UART_PIN_NO_CHANGE would leave RTS/CTS routed to UART, give them back to GPIO. Pins are
+        // only touched when flow control owned them, so outputs of other commands are kept
+        if(err == ESP_OK)
+            err = gpio_reset_pin(UART_RTS_PIN);
+        if(err == ESP_OK)
+            err = gpio_reset_pin(UART_CTS_PIN);
+        if(err == ESP_OK){
+            cliGpioRelease(UART_RTS_PIN, CLI_GPIO_OWNER_UART);
+            cliGpioRelease(UART_CTS_PIN, CLI_GPIO_OWNER_UART);
+        }
+    }
+    if(err != ESP_OK)
+        return -1;
+    s_flow_ctrl = enable;
+    return 0;
 }
 
 // Start screen function for UART protocol, it prints the menu
@@ -6,13 +6,49 @@
 #ifndef _CLIUART_H_
 #define _CLIUART_H_
 
+#include <stdint.h>
+#include <stdbool.h>
+
 #define UART_PORT          (0)
 #define UART_RX_PIN        (3)
 #define UART_TX_PIN        (1)
+#define UART_RTS_PIN       (22)
+#define UART_CTS_PIN       (19)
 #define UART_BAUD_RATE     (115200)
-#define UART_READ_BUF_SIZE (256)
+#define UART_READ_BUF_SIZE (1024)
+
+// TX ring buffer size, writes return immediately while the ring has space
+#define UART_WRITE_BUF_SIZE (4096)
+// Driver event queue length
+#define UART_EVENT_QUEUE_SIZE (20)
+// Set as 1 to start with RTS/CTS hardware flow control
+#define UART_HW_FLOWCTRL (0)
+// RX FIFO level which deasserts RTS when hardware flow control is on
+#define UART_RX_FLOW_THRESH (122)
+// Baud rate limits for 'baud' command
+#define UART_BAUD_MIN (9600)
+#define UART_BAUD_MAX (3000000)
+// Time given to the host to confirm a new baud rate, otherwise old rate is restored
+#define UART_BAUD_CONFIRM_MS (3000)
+
+// UART driver event statistics
+typedef struct{
+    uint32_t dataEvents;
+    uint32_t rxBytes;
+    uint32_t fifoOverflows;
+    uint32_t bufferFull;
+    uint32_t frameErrors;
+    uint32_t parityErrors;
+    uint32_t breaks;
+}cliUartStats_t;
 
 void cliUartConfig(void);
 void cliUartInitUARTScreen(void);
+uint32_t cliUartGetBaudRate(void);
+int cliUartNegotiateBaudRate(uint32_t);
+int cliUartSetFlowControl(bool);
+bool cliUartGetFlowControl(void);
+bool cliUartWaitData(uint32_t);
+const cliUartStats_t *cliUartGetStats(void);
 
 #endif
\ No newline at end of file
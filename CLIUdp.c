@@ -0,0 +1,247 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLIUdp.c
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+
+#include "CLI.h"
+#include "CLISession.h"
+#include "CLIConfig.h"
+#include "CLIRecord.h"
+#include "CLIUdp.h"
+
+// TAG for UDP log functions
+static const char *TAGUDP = "UDP Application";
+// Sequence window of a sender
+typedef struct{
+    bool used;
+    uint32_t addr;
+    uint16_t port;
+    uint32_t newest;
+    uint32_t window;     // bit n is set if newest - n is received
+    int64_t lastSeen;
+}cliUdpPeer_t;
+
+static cliUdpPeer_t s_peers[CLI_UDP_MAX_PEERS];
+static cliUdpStats_t s_stats;
+static int s_sock = -1;
+// Output of datagram commands is collected here and sent as one reply
+static cliSession_t *s_buffer;
+
+// Finds sender in peer table, least recently seen peer is replaced for a new sender
+static cliUdpPeer_t *cliUdpPeer(const struct sockaddr_in *addr){
+    cliUdpPeer_t *oldest = &s_peers[0];
+    for(int i = 0; i < CLI_UDP_MAX_PEERS; i++){
+        cliUdpPeer_t *peer = &s_peers[i];
+        if(peer->used && peer->addr == addr->sin_addr.s_addr && peer->port == addr->sin_port)
+            return peer;
+        if(!peer->used || (oldest->used && peer->lastSeen < oldest->lastSeen))
+            oldest = peer;
+    }
+    memset(oldest, 0, sizeof(*oldest));
+    oldest->addr = addr->sin_addr.s_addr;
+    oldest->port = addr->sin_port;
+    return oldest;
+}
+
+// Checks sequence against sender window. Returns 1 for new, 0 for duplicate and -1 for stale datagram
+static int cliUdpAccept(cliUdpPeer_t *peer, uint32_t seq){
+    int64_t now = esp_timer_get_time();
+    int32_t diff = (int32_t)(seq - peer->newest);
+    // Restarted sender begins again with low sequences, they are not late datagrams of the old run
+    if(peer->used && (now - peer->lastSeen > (int64_t)CLI_UDP_PEER_IDLE_MS * 1000 || diff < -CLI_UDP_PEER_RESTART_GAP))
+        peer->used = false;
+    peer->lastSeen = now;
+    if(!peer->used){
+        peer->used = true;
+        peer->newest = seq;
+        peer->window = 1;
+        return 1;
+    }
+    if(diff > 0){
+        peer->window = diff < 32 ? (peer->window << diff) | 1 : 1;
+        peer->newest = seq;
+        return 1;
+    }
+    if(diff > -32 && (peer->window & (1u << -diff)))
+        return 0;
+    // Late datagram, a newer one is already applied
+    return -1;
+}
+
+// Takes next command line of a datagram. A ';' in double quotes belongs to the argument, escapes are
+// skipped like the console argument splitter does
+static char *cliUdpNextLine(char **cursor){
+    char *line = *cursor;
+    if(line == NULL)
+        return NULL;
+    bool quoted = false;
+    for(char *c = line; *c; c++){
+        if(*c == '\\' && c[1] != 0 && c[1] != '\r' && c[1] != '\n'){
+            c++;
+            continue;
+        }
+        if(*c == '"')
+            quoted = !quoted;
+        else if(*c == '\r' || *c == '\n' || (*c == ';' && !quoted)){
+            *c = 0;
+            *cursor = c + 1;
+            return line;
+        }
+    }
+    *cursor = NULL;
+    return line;
+}
+
+// Runs every command line of a datagram
+static int cliUdpRunCommands(char *text){
+    int count = 0;
+    char *cursor = text;
+    for(char *line = cliUdpNextLine(&cursor); line != NULL; line = cliUdpNextLine(&cursor)){
+        while(*line == ' ')
+            line++;
+        if(*line == 0)
+            continue;
+        bool recording = cliRecordBegin(s_buffer, line);
+        // Datagrams of all senders share the buckets of the buffer session
+        int retryMs = cliSessionRateCheck(s_buffer);
+        if(retryMs > 0){
+            cliCommandRateLimited(retryMs);
+            if(recording)
+                cliRecordEnd(ESP_ERR_INVALID_STATE, 0);
+            continue;
+        }
+        int ret;
+        esp_err_t err = cliRunCommand(s_buffer, line, &ret);
+        cliCommandControl(err, ret);
+        if(recording)
+            cliRecordEnd(err, ret);
+        count++;
+    }
+    s_stats.commands += count;
+    return count;
+}
+
+// Sends collected output to the sender
+static void cliUdpReply(const struct sockaddr_in *addr, const char *header, int headerLen){
+    static char reply[CLI_UDP_MAX_DATAGRAM + 32];
+    size_t len = 0;
+    if(headerLen > 0){
+        memcpy(reply, header, headerLen);
+        len = headerLen;
+    }
+    size_t body = s_buffer->txLen;
+    if(body > sizeof(reply) - len)
+        body = sizeof(reply) - len;
+    memcpy(reply + len, s_buffer->txBuffer, body);
+    len += body;
+    if(len == 0)
+        return;
+    if(sendto(s_sock, reply, len, 0, (const struct sockaddr *)addr, sizeof(*addr)) < 0){
+        ESP_LOGE(TAGUDP, "Error occurred during sending: errno %d", errno);
+        s_stats.errors++;
+    }
+}
+
+// Handles one datagram
+static void cliUdpHandle(char *data, const struct sockaddr_in *addr){
+    s_buffer->txLen = 0;
+    s_buffer->truncated = false;
+    s_buffer->stats.rxBytes += strlen(data);
+
+    // Plain datagram, output is replied
+    if(data[0] != '@'){
+        cliUdpRunCommands(data);
+        cliUdpReply(addr, NULL, 0);
+        return;
+    }
+
+    char *end;
+    uint32_t seq = strtoul(data + 1, &end, 10);
+    bool ack = *end == '!';
+    if(ack)
+        end++;
+    int verdict = cliUdpAccept(cliUdpPeer(addr), seq);
+    char header[32];
+    if(verdict < 0){
+        s_stats.stale++;
+        if(ack)
+            cliUdpReply(addr, header, snprintf(header, sizeof(header), "@%u stale\n", seq));
+        return;
+    }
+    if(verdict == 0){
+        // Sender did not get the ack, repeat it without running commands again
+        s_stats.duplicates++;
+        if(ack){
+            s_stats.acks++;
+            cliUdpReply(addr, header, snprintf(header, sizeof(header), "@%u dup\n", seq));
+        }
+        return;
+    }
+    int count = cliUdpRunCommands(end);
+    if(ack){
+        s_stats.acks++;
+        cliUdpReply(addr, header, snprintf(header, sizeof(header), "@%u ok %d\n", seq, count));
+    }
+}
+
+// UDP task, it serves datagrams independently of the TCP client
+static void cliUdpTask(void *pvParameters){
+    static char datagram[CLI_UDP_MAX_DATAGRAM + 1];
+    cliSessionSetCurrent(s_buffer);
+    while(1){
+        struct sockaddr_in source;
+        socklen_t sourceLen = sizeof(source);
+        int len = recvfrom(s_sock, datagram, CLI_UDP_MAX_DATAGRAM, 0, (struct sockaddr *)&source, &sourceLen);
+        if(len < 0){
+            ESP_LOGE(TAGUDP, "Error occurred during receiving: errno %d", errno);
+            s_stats.errors++;
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
+        datagram[len] = 0;
+        s_stats.datagrams++;
+        cliUdpHandle(datagram, &source);
+    }
+}
+
+// Creates UDP socket and its task, Wi-Fi must be connected
+void cliUdpStart(void){
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(cliConfigGet(CLI_CONFIG_UDP_PORT)),
+        .sin_addr.s_addr = htonl(INADDR_ANY)
+    };
+    s_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if(s_sock < 0){
+        ESP_LOGE(TAGUDP, "Unable to create socket: errno %d", errno);
+        return;
+    }
+    if(bind(s_sock, (struct sockaddr *)&addr, sizeof(addr)) != 0){
+        ESP_LOGE(TAGUDP, "Socket unable to bind: errno %d", errno);
+        close(s_sock);
+        return;
+    }
+    s_buffer = cliSessionOpen(CLI_SESSION_BUFFER, -1);
+    if(s_buffer == NULL){
+        close(s_sock);
+        return;
+    }
+    cliSessionSetRate(s_buffer, cliConfigGet(CLI_CONFIG_RATE_COMMANDS), cliConfigGet(CLI_CONFIG_RATE_BYTES));
+    xTaskCreate(cliUdpTask, "cli_udp", CLI_UDP_TASK_STACK, NULL, CLI_UDP_TASK_PRIORITY, NULL);
+    s_stats.port = cliConfigGet(CLI_CONFIG_UDP_PORT);
+    ESP_LOGI(TAGUDP, "Socket bound on port %u", s_stats.port);
+}
+
+// Returns UDP statistics
+const cliUdpStats_t *cliUdpGetStats(void){
+    return &s_stats;
+}
@@ -0,0 +1,49 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLIUdp.h
+*/
+#ifndef _CLIUDP_H_
+#define _CLIUDP_H_
+
+#include <stdint.h>
+
+// UDP port for datagram commands
+#define CLI_UDP_PORT (3334)
+// Largest accepted datagram
+#define CLI_UDP_MAX_DATAGRAM (1024)
+// Number of senders whose sequence window is tracked
+#define CLI_UDP_MAX_PEERS (4)
+// A sender which is silent this long or jumps back this far starts a new sequence window, e.g. after
+// it restarts on the same source port
+#define CLI_UDP_PEER_IDLE_MS (30000)
+#define CLI_UDP_PEER_RESTART_GAP (1024)
+// UDP task settings
+#define CLI_UDP_TASK_STACK (4096)
+#define CLI_UDP_TASK_PRIORITY (configMAX_PRIORITIES - 2)
+
+/* Datagram format, one or more command lines separated by '\n' or ';':
+ *   <command>[;<command>...]               reply with output of commands
+ *   @<seq> <command>[;<command>...]        sequenced, no reply (fire-and-forget)
+ *   @<seq>! <command>[;<command>...]       sequenced, reply with "@<seq> ok <count>\n" and output
+ * A ';' in a double quoted argument is not a separator, a line ending always is.
+ * A sequenced datagram which is not newer than the newest one of its sender is dropped, since a late
+ * GPIO write must not undo a newer one. Duplicates which request an ack are acked again. A sender which
+ * was silent for CLI_UDP_PEER_IDLE_MS or whose sequence is more than CLI_UDP_PEER_RESTART_GAP behind its
+ * newest one is taken as restarted, its datagram starts a new window. */
+
+// UDP transport statistics
+typedef struct{
+    uint16_t port;                  // Bound port, 0 until socket is bound
+    uint32_t datagrams;
+    uint32_t commands;
+    uint32_t duplicates;
+    uint32_t stale;
+    uint32_t acks;
+    uint32_t errors;
+}cliUdpStats_t;
+
+void cliUdpStart(void);
+const cliUdpStats_t *cliUdpGetStats(void);
+
+#endif
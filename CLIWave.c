@@ -0,0 +1,223 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLIWave.c
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/rmt.h"
+#include "driver/gpio.h"
+
+#include "CLIGpio.h"
+#include "CLIWave.h"
+
+// TAG for waveform log functions
+static const char *TAGWAVE = "Waveform";
+
+// Sequences of channels
+static cliWave_t s_wave[CLI_WAVE_CHANNELS] = { [0 ... CLI_WAVE_CHANNELS - 1] = { .pin = -1 } };
+// Parsed list and its items, commands are serialized so one list exists at a time
+static uint32_t s_phases[CLI_WAVE_MAX_PHASES];
+static uint32_t s_items[CLI_WAVE_MAX_ITEMS];
+
+// RMT channel of a waveform channel, they are apart so each one can take its memory blocks
+#define CLI_WAVE_RMT(channel) ((rmt_channel_t)((channel) * CLI_WAVE_MEM_BLOCKS))
+
+// Driver is installed at first start and kept, so a pass which is ended never waits for install
+static bool s_installed[CLI_WAVE_CHANNELS];
+
+// Configures channel and loads sequence into its memory, transmission starts at once
+static esp_err_t cliWaveHardwareStart(int channel, const cliWave_t *wave){
+    rmt_config_t config = RMT_DEFAULT_CONFIG_TX(wave->pin, CLI_WAVE_RMT(channel));
+    config.clk_div = CLI_WAVE_CLK_DIV;
+    config.mem_block_num = CLI_WAVE_MEM_BLOCKS;
+    config.tx_config.loop_en = wave->repeat == 0;
+    config.tx_config.idle_output_en = true;
+    config.tx_config.idle_level = wave->idle;
+    esp_err_t err = rmt_config(&config);
+    if(err == ESP_OK && !s_installed[channel]){
+        err = rmt_driver_install(CLI_WAVE_RMT(channel), 0, 0);
+        s_installed[channel] = err == ESP_OK;
+    }
+    if(err == ESP_OK)
+        err = rmt_write_items(CLI_WAVE_RMT(channel), (const rmt_item32_t *)s_items, wave->items, false);
+    return err;
+}
+
+// Lets running pass reach its end marker, loop is turned off first so the pass is the last one
+static void cliWaveHardwareEnd(int channel, const cliWave_t *wave){
+    rmt_set_tx_loop_mode(CLI_WAVE_RMT(channel), false);
+    int64_t left = wave->passUs;
+    if(wave->repeat){
+        left = wave->started + (int64_t)wave->passUs * wave->repeat - esp_timer_get_time();
+        if(left < 0)
+            left = 0;
+    }
+    if(rmt_wait_tx_done(CLI_WAVE_RMT(channel), pdMS_TO_TICKS(left / 1000 + CLI_WAVE_END_MARGIN_MS)) == ESP_OK)
+        return;
+    // Driver keeps waiting for an end which will not come, it is installed again at next start
+    ESP_LOGE(TAGWAVE, "Sequence on GPIO %d did not end, it is stopped", wave->pin);
+    rmt_tx_stop(CLI_WAVE_RMT(channel));
+    rmt_driver_uninstall(CLI_WAVE_RMT(channel));
+    s_installed[channel] = false;
+}
+
+// GPIO output gets idle level before it takes the pin, so there is no edge
+static void cliWaveHardwareRelease(const cliWave_t *wave){
+    gpio_set_level(wave->pin, wave->idle);
+    gpio_set_direction(wave->pin, GPIO_MODE_INPUT_OUTPUT);
+}
+
+// Parses a duration list into phase lengths in ticks
+static esp_err_t cliWaveParse(const char *list, uint8_t *first, uint16_t *phases){
+    if((list[0] != '0' && list[0] != '1') || list[1] != ':')
+        return ESP_ERR_INVALID_ARG;
+    *first = list[0] - '0';
+    *phases = 0;
+    const char *p = list + 2;
+    while(1){
+        if(!isdigit((unsigned char)*p))
+            return ESP_ERR_INVALID_ARG;
+        char *end;
+        uint64_t ticks = (uint64_t)strtoul(p, &end, 10) * CLI_WAVE_TICKS_PER_US;
+        p = end;
+        if(*p == '.'){
+            if(!isdigit((unsigned char)p[1]))
+                return ESP_ERR_INVALID_ARG;
+            ticks += p[1] - '0';
+            p += 2;
+        }
+        // Zero length would be taken as end marker
+        if(ticks == 0)
+            return ESP_ERR_INVALID_ARG;
+        if(ticks > UINT32_MAX || *phases >= CLI_WAVE_MAX_PHASES)
+            return ESP_ERR_INVALID_SIZE;
+        s_phases[(*phases)++] = ticks;
+        if(*p == 0)
+            return ESP_OK;
+        if(*p++ != ',')
+            return ESP_ERR_INVALID_ARG;
+    }
+}
+
+/* Packs phases into RMT items, an item word is duration (15 bits) and level of two halves. ESP32 RMT
+ * has no loop counter, so repeats are copies of the phases. An odd half count leaves a zero duration
+ * in the last half, it is the end marker. */
+static esp_err_t cliWaveEncode(cliWave_t *wave, uint8_t first){
+    uint32_t copies = wave->repeat ? wave->repeat : 1;
+    uint32_t passTicks = 0;
+    uint32_t half = 0;
+    for(uint32_t copy = 0; copy < copies; copy++){
+        for(uint16_t i = 0; i < wave->phases; i++){
+            uint32_t level = first ^ (i & 1);
+            uint32_t left = s_phases[i];
+            while(left){
+                uint32_t ticks = left < CLI_WAVE_MAX_TICKS ? left : CLI_WAVE_MAX_TICKS;
+                left -= ticks;
+                if(half / 2 >= CLI_WAVE_MAX_ITEMS)
+                    return ESP_ERR_INVALID_SIZE;
+                if(half & 1)
+                    s_items[half / 2] |= (ticks | (level << 15)) << 16;
+                else
+                    s_items[half / 2] = ticks | (level << 15);
+                half++;
+                if(copy == 0)
+                    passTicks += ticks;
+            }
+        }
+    }
+    wave->items = (half + 1) / 2;
+    wave->passUs = (passTicks + CLI_WAVE_TICKS_PER_US - 1) / CLI_WAVE_TICKS_PER_US;
+    wave->idle = !first;
+    return ESP_OK;
+}
+
+// Returns channel which drives a pin, or -1
+static int cliWaveFind(int pin){
+    for(int i = 0; i < CLI_WAVE_CHANNELS; i++){
+        if(s_wave[i].pin == pin)
+            return i;
+    }
+    return -1;
+}
+
+// Encodes a list and starts it on a channel, a running sequence of the channel ends first
+static esp_err_t cliWaveLoad(int channel, cliWave_t *wave, const char *list){
+    uint8_t first;
+    esp_err_t err = cliWaveParse(list, &first, &wave->phases);
+    if(err == ESP_OK)
+        err = cliWaveEncode(wave, first);
+    if(err != ESP_OK)
+        return err;
+    if(s_wave[channel].pin >= 0)
+        cliWaveHardwareEnd(channel, &s_wave[channel]);
+    err = cliWaveHardwareStart(channel, wave);
+    if(err != ESP_OK){
+        ESP_LOGE(TAGWAVE, "Unable to start waveform on GPIO %d: %s", wave->pin, esp_err_to_name(err));
+        // Sequence which was ended is not replaced, its pin is given back
+        if(s_wave[channel].pin >= 0){
+            cliWaveHardwareRelease(&s_wave[channel]);
+            cliGpioRelease(s_wave[channel].pin, CLI_GPIO_OWNER_WAVEFORM);
+            s_wave[channel].pin = -1;
+        }
+        return err;
+    }
+    wave->started = esp_timer_get_time();
+    s_wave[channel] = *wave;
+    // RMT driver turns input off whenever it routes the pin
+    cliGpioEnableInput(wave->pin);
+    return ESP_OK;
+}
+
+// Starts a sequence on a pin, a running sequence of the pin is replaced after its pass
+esp_err_t cliWaveStart(int pin, const char *list, uint32_t repeat){
+    int channel = cliWaveFind(pin);
+    if(channel < 0)
+        channel = cliWaveFind(-1);
+    if(channel < 0)
+        return ESP_ERR_NO_MEM;
+    if(!cliGpioClaim(pin, CLI_GPIO_OWNER_WAVEFORM))
+        return ESP_ERR_INVALID_STATE;
+    cliWave_t wave = { .pin = pin, .repeat = repeat };
+    esp_err_t err = cliWaveLoad(channel, &wave, list);
+    if(err != ESP_OK && s_wave[channel].pin != pin)
+        cliGpioRelease(pin, CLI_GPIO_OWNER_WAVEFORM);
+    return err;
+}
+
+// Replaces sequence of a pin with the same repeat, new one starts when running pass ends
+esp_err_t cliWaveUpdate(int pin, const char *list){
+    int channel = cliWaveFind(pin);
+    if(channel < 0)
+        return ESP_ERR_NOT_FOUND;
+    cliWave_t wave = s_wave[channel];
+    return cliWaveLoad(channel, &wave, list);
+}
+
+// Stops sequence of a pin after its pass, pin stays at idle level as a GPIO output
+esp_err_t cliWaveStop(int pin){
+    int channel = cliWaveFind(pin);
+    if(channel < 0)
+        return ESP_ERR_NOT_FOUND;
+    cliWaveHardwareEnd(channel, &s_wave[channel]);
+    cliWaveHardwareRelease(&s_wave[channel]);
+    s_wave[channel].pin = -1;
+    cliGpioRelease(pin, CLI_GPIO_OWNER_WAVEFORM);
+    return ESP_OK;
+}
+
+// Returns sequence of a channel
+const cliWave_t *cliWaveGet(int channel){
+    return &s_wave[channel];
+}
+
+// Returns false when a finite sequence is played to its end
+bool cliWaveIsRunning(const cliWave_t *wave){
+    if(wave->pin < 0)
+        return false;
+    return wave->repeat == 0 || esp_timer_get_time() < wave->started + (int64_t)wave->passUs * wave->repeat;
+}
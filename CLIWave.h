@@ -0,0 +1,52 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : CLIWave.h
+*/
+#ifndef _CLIWAVE_H_
+#define _CLIWAVE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// RMT channels given to 'waveform', each one takes CLI_WAVE_MEM_BLOCKS of the 8 memory blocks
+#define CLI_WAVE_CHANNELS (2)
+#define CLI_WAVE_MEM_BLOCKS (4)
+// Items which fit memory of a channel, one is kept for end marker. Sequences are played from
+// channel memory only, so there is no refill interrupt which could be late.
+#define CLI_WAVE_MAX_ITEMS (CLI_WAVE_MEM_BLOCKS * 64 - 1)
+// Phases of one duration list, command line can not hold more
+#define CLI_WAVE_MAX_PHASES (128)
+// RMT tick is 0.1 us, APB clock is divided by 8
+#define CLI_WAVE_CLK_DIV (8)
+#define CLI_WAVE_TICKS_PER_US (10)
+// Longest phase of one item half, longer phases take more halves
+#define CLI_WAVE_MAX_TICKS (32767)
+// Time given to a sequence to reach its end marker beyond its length
+#define CLI_WAVE_END_MARGIN_MS (10)
+
+/* A duration list is the first level and lengths of alternating phases in microseconds with up to one
+ * decimal, e.g. "1:10,20,2.5,2.5" is high 10 us, low 20 us, high 2.5 us, low 2.5 us. Pin rests at the
+ * opposite of the first level before and after the sequence. A sequence is played 'repeat' times or,
+ * for repeat 0, in a loop until stop. Update and stop let the running pass reach its end, so no phase
+ * is cut, the pin rests only while the next sequence is loaded. */
+
+// Sequence of an RMT channel
+typedef struct{
+    int pin;                    // -1 when channel is free
+    uint32_t repeat;
+    uint8_t idle;
+    uint16_t phases;
+    uint16_t items;
+    uint32_t passUs;            // Length of one pass
+    int64_t started;
+}cliWave_t;
+
+esp_err_t cliWaveStart(int, const char*, uint32_t);
+esp_err_t cliWaveUpdate(int, const char*);
+esp_err_t cliWaveStop(int);
+const cliWave_t *cliWaveGet(int);
+bool cliWaveIsRunning(const cliWave_t*);
+
+#endif
@@ -26,21 +26,97 @@
 
 // Include CLI library, it includes CLIUart and CLISocket libraries
 #include "CLI.h"
-
-// This value (sock) is using for multiple source file so I defined it by extern keyword in other source files. Extern from CLI.h
-extern int sock;
+#include "CLISession.h"
+#include "CLIFrame.h"
+#include "CLIUdp.h"
+#include "CLISocket.h"
+#include "CLIConfig.h"
+#include "CLIBoot.h"
 
 // TAG for ESP32 log functions
 static const char *TAGESP32 = "ESP32";
 // TAG for ESP TCP log functions
 static const char *TAGTCP = "TCP Application";
 
+// Boot stages, a stage may only depend on stages above it
+enum{
+    BOOT_NVS = 0,
+    BOOT_CORE,
+    BOOT_CONSOLE,
+    BOOT_COMMANDS,
+    BOOT_UART,
+    BOOT_WIFI_START,
+    BOOT_WIFI_CONNECT,
+    BOOT_UDP,
+    BOOT_SERVER,
+    BOOT_COUNT
+};
+
+// Server stage, it listens before Wi-Fi is connected so clients are accepted as soon as there is an IP
+static void boot_server(void){
+    // Create structure for socket init
+    struct sockaddr_in dest_addr;
+
+    // IP version and socket init
+    dest_addr.sin_family = AF_INET;
+    dest_addr.sin_port = htons(cliConfigGet(CLI_CONFIG_TCP_PORT));
+    dest_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    // Create a socket
+    int listen_sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_sock < 0) {
+        ESP_LOGE(TAGTCP, "Unable to create socket: errno %d", errno);
+        goto FINISH;
+    }
+    ESP_LOGI(TAGTCP, "Socket created");
+
+    // Bind socket
+    int err = bind(listen_sock, (struct sockaddr *)&dest_addr, sizeof(dest_addr));
+    if (err != 0) {
+        ESP_LOGE(TAGTCP, "Socket unable to bind: errno %d", errno);
+        goto FINISH;
+    }
+    ESP_LOGI(TAGTCP, "Socket bound on port %u", cliConfigGet(CLI_CONFIG_TCP_PORT));
+
+    // Start socket listening, clients are accepted by cliReadCommand
+    err = listen(listen_sock, CLI_SOCKET_MAX_CLIENTS);
+    if (err != 0) {
+        ESP_LOGE(TAGTCP, "Error occurred during listen: errno %d", errno);
+        goto FINISH;
+    }
+    ESP_LOGI(TAGTCP, "Socket listening");
+    cliSocketServerStart(listen_sock);
+    return;
+
+    //If any error occured about socket come here
+    FINISH:
+    close(listen_sock);
+    esp_restart();
+}
+
+// Boot graph, independent stages run at the same time, e.g. Wi-Fi association and command registration
+static const cliBootStage_t s_boot_stages[BOOT_COUNT] = {
+    [BOOT_NVS]          = { "nvs", cliInitializeNVS, 0, true },
+    [BOOT_CORE]         = { "core", cliCoreInit, 0, true },
+    [BOOT_CONSOLE]      = { "console", cliConsoleInit, 0, true },
+    [BOOT_COMMANDS]     = { "commands", cliRegisterCommands, CLI_BOOT_DEP(BOOT_CONSOLE), true },
+    [BOOT_UART]         = { "uart", cliUartConsoleInit, CLI_BOOT_DEP(BOOT_NVS) | CLI_BOOT_DEP(BOOT_CONSOLE), ENABLE_UART },
+    [BOOT_WIFI_START]   = { "wifi_start", cliSocketWifiStart, CLI_BOOT_DEP(BOOT_NVS), ENABLE_TCP },
+    [BOOT_WIFI_CONNECT] = { "wifi_connect", cliSocketWifiWait, CLI_BOOT_DEP(BOOT_WIFI_START), ENABLE_TCP },
+    [BOOT_UDP]          = { "udp", cliUdpStart, CLI_BOOT_DEP(BOOT_NVS) | CLI_BOOT_DEP(BOOT_CORE) | CLI_BOOT_DEP(BOOT_COMMANDS) |
+                            CLI_BOOT_DEP(BOOT_WIFI_START), ENABLE_TCP && ENABLE_UDP },
+    [BOOT_SERVER]       = { "server", boot_server, CLI_BOOT_DEP(BOOT_NVS) | CLI_BOOT_DEP(BOOT_CORE) | CLI_BOOT_DEP(BOOT_COMMANDS) |
+                            CLI_BOOT_DEP(BOOT_WIFI_START), ENABLE_TCP }
+};
+
 // CLI Task
 static void cli_task(void *pvParameters){
     // If uart is enable:
     if(ENABLE_UART){
-        //UART Init and Config is called in main by cliConsoleInit function
+        //UART Init and Config is done by uart boot stage
         esp_console_register_help_command();
+        // Serial console is a single session which writes to stdout
+        cliSessionSetCurrent(cliSessionOpen(CLI_SESSION_UART, -1));
         cliStartUARTScreen();
         // Control Console for Escape Sequences
         const char *prompt = cliControlConsole();
@@ -53,85 +129,21 @@ static void cli_task(void *pvParameters){
             cliAddCommandHistory(line);
             // Parse and run the command
             cliParseCommand(line);
+            // Machine clients leave line editing until they send an EXIT frame
+            if(cliFrameIsRequested())
+                cliFrameRun();
         }
     }
     // If tcp is enable:
     else if(ENABLE_TCP){
-        // Connect to Wifi
-        cliTCPInit();
-
-        // Create structure for socket init
-        char addr_str[128];
-        int addr_family = (int)pvParameters;
-        struct sockaddr_in dest_addr;
-
-        // IP version and socket init
-        dest_addr.sin_family = AF_INET;
-        dest_addr.sin_port = htons(PORT);
-        dest_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-
-        // Create a socket
-        int listen_sock = socket(AF_INET, SOCK_STREAM, 0);
-        if (listen_sock < 0) {
-            ESP_LOGE(TAGTCP, "Unable to create socket: errno %d", errno);
-            goto FINISH;
-        }
-        ESP_LOGI(TAGTCP, "Socket created");
-
-        // Bind socket
-        int err = bind(listen_sock, (struct sockaddr *)&dest_addr, sizeof(dest_addr));
-        if (err != 0) {
-            ESP_LOGE(TAGTCP, "Socket unable to bind: errno %d", errno);
-            goto FINISH;
-        }
-        ESP_LOGI(TAGTCP, "Socket bound on port %d", PORT);
-
-        // Start socket listening
-        err = listen(listen_sock, 1);
-        if (err != 0) {
-            ESP_LOGE(TAGTCP, "Error occurred during listen: errno %d", errno);
-            goto FINISH;
-        }
-        ESP_LOGI(TAGTCP, "Socket listening");
-
-        struct sockaddr_in source_addr;
-        uint addr_len = sizeof(source_addr);
-        
-        // Accept request which is came from client
-        sock = accept(listen_sock, (struct sockaddr *)&source_addr, &addr_len);
-        if (sock < 0) {
-            ESP_LOGE(TAGTCP, "Unable to accept connection: errno %d", errno);
-            goto FINISH;
-        }
-        
-        // Convert ip address to string
-        inet_ntoa_r(((struct sockaddr_in *)&source_addr)->sin_addr.s_addr, addr_str, sizeof(addr_str) - 1);
-        // Print client IP address
-        ESP_LOGI(TAGTCP, "Socket Accepted IP Address: %s", addr_str);
-        
-        // Prints menu 
-        cliStartTCPScreen();
-        
+        // Wi-Fi, UDP task and listening socket are ready after boot stages
         //While loop for TCP
         while (1) {
-            // Gets command from socket
+            // Accepts clients and gets commands from their sockets
             cliReadCommand(NULL);
-            // Parses command which is came from socket
+            // Runs received commands of all clients in turn
             cliParseCommand(NULL);
-            
-            // Control for socket connection
-            if (sock < 0) {
-                ESP_LOGE(TAGTCP, "Unable to accept connection: errno %d", errno);
-                goto FINISH;
-            }
         }
-        //If any error occured about socket come here
-        FINISH:
-        shutdown(sock, 0);
-        close(sock);
-        close(listen_sock);
-        esp_restart();
-        //vTaskDelete(NULL);  // Task can be deleted if desired
     }
     // If both are disable (uart and tcp):
     else{
@@ -141,13 +153,9 @@ static void cli_task(void *pvParameters){
 }
 
 void app_main(void){
-    // Init NVS
-    cliInitializeNVS();
-    // Console must be initialize for both protocol
-    cliConsoleInit();
-    // Register commands
-    cliRegisterCommands();
+    // Init NVS, console, commands and connection in parallel stages
+    cliBootRun(s_boot_stages, BOOT_COUNT);
 
     // Create CLI Task
     xTaskCreate(cli_task, "cli_task", 4096, NULL, configMAX_PRIORITIES, NULL);
-}
\ No newline at end of file
+}
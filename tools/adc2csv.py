@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+"""
+Project: ESP32 Console Application Project - 2022
+File   : tools/adc2csv.py
+
+Decodes the binary stream of the 'adc_stream' command into a CSV file and
+prints record rate, throughput and dropped records. The stream can be read
+from a file (saved with e.g. nc) or the command can be sent to the board
+directly over TCP.
+
+  adc2csv.py -i adc.bin -o adc.csv
+  adc2csv.py --host 192.168.1.10 --cmd "adc_stream -m 0x300000000 -r 50000 -d 16 -f mean,min,max -n 100000" -o adc.csv
+"""
+import argparse
+import socket
+import struct
+import sys
+import time
+
+STATUS = {0: "ok", 1: "overrun", 2: "error", 3: "aborted"}
+FIELDS = [(1, "mean"), (2, "min"), (4, "max")]
+
+
+class Reader:
+    """Byte reader over a socket or a file"""
+
+    def __init__(self, read):
+        self._read = read
+        self._buf = b""
+        self.total = 0
+
+    def take(self, n):
+        while len(self._buf) < n:
+            chunk = self._read(65536)
+            if not chunk:
+                raise EOFError("stream ended before End block")
+            self._buf += chunk
+            self.total += len(chunk)
+        data, self._buf = self._buf[:n], self._buf[n:]
+        return data
+
+    def seek_header(self):
+        # Anything before the header (banner, echo) is skipped
+        while True:
+            idx = self._buf.find(b"AH\x01")
+            if idx >= 0:
+                self._buf = self._buf[idx + 2:]
+                return
+            self._buf = self._buf[-2:]
+            chunk = self._read(65536)
+            if not chunk:
+                raise EOFError("no adc_stream header in stream")
+            self._buf += chunk
+            self.total += len(chunk)
+
+
+def decode(reader, out):
+    reader.seek_header()
+    _version, mask, rate, decimation, fields, channels, limit = struct.unpack("<BQIHBBI", reader.take(21))
+    pins = [pin for pin in range(64) if mask & (1 << pin)][:channels]
+    names = [name for bit, name in FIELDS if fields & bit]
+    period = decimation / rate
+
+    out.write("record,time_s," + ",".join("gpio%d_%s" % (pin, name) for pin in pins for name in names) + "\n")
+    expected = 0
+    gaps = 0
+    while True:
+        tag = reader.take(2)
+        if tag == b"AE":
+            records, dropped, status = struct.unpack("<IIB", reader.take(9))
+            return records, dropped, gaps, period, STATUS.get(status, str(status))
+        if tag != b"AB":
+            raise ValueError("unexpected block %r" % tag)
+        _sequence, first, _dropped, count = struct.unpack("<IIIH", reader.take(14))
+        if first != expected:
+            gaps += 1
+        payload = reader.take(count * channels * len(names) * 2)
+        values = struct.unpack("<%dH" % (len(payload) // 2), payload)
+        width = channels * len(names)
+        for i in range(count):
+            row = values[i * width:(i + 1) * width]
+            # Mean is in 1/16 LSB
+            text = ["%.4f" % (v / 16) if names[j % len(names)] == "mean" else str(v) for j, v in enumerate(row)]
+            out.write("%d,%.6f,%s\n" % (first + i, (first + i) * period, ",".join(text)))
+        expected = first + count
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode 'adc_stream' stream into CSV")
+    parser.add_argument("-i", "--input", help="binary stream file")
+    parser.add_argument("--host", help="board address, command is sent over TCP")
+    parser.add_argument("--port", type=int, default=3333)
+    parser.add_argument("--cmd", help="adc_stream command line to send")
+    parser.add_argument("-o", "--output", required=True, help="CSV file")
+    args = parser.parse_args()
+
+    if args.host:
+        if not args.cmd:
+            parser.error("--cmd is required with --host")
+        sock = socket.create_connection((args.host, args.port))
+        # Drain welcome banner before sending command
+        time.sleep(0.5)
+        sock.setblocking(False)
+        try:
+            sock.recv(4096)
+        except BlockingIOError:
+            pass
+        sock.setblocking(True)
+        sock.sendall(args.cmd.encode() + b"\n")
+        reader = Reader(sock.recv)
+    elif args.input:
+        reader = Reader(open(args.input, "rb").read)
+    else:
+        parser.error("either --input or --host is required")
+
+    start = time.time()
+    with open(args.output, "w") as out:
+        records, dropped, gaps, period, status = decode(reader, out)
+    elapsed = time.time() - start
+    print("%d records, %d dropped in %d gaps, status: %s" % (records, dropped, gaps, status), file=sys.stderr)
+    if args.host and elapsed > 0:
+        print("%.0f records/s (nominal %.0f), %.1f kB/s" % (records / elapsed, 1 / period, reader.total / elapsed / 1024),
+              file=sys.stderr)
+    return 0 if status == "ok" and dropped == 0 else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+"""
+Project: ESP32 Console Application Project - 2022
+File   : tools/capture2vcd.py
+
+Decodes the binary stream of the 'capture' command into a VCD file.
+The stream can be read from a file (saved with e.g. nc) or the command
+can be sent to the board directly over TCP.
+
+  capture2vcd.py -i capture.bin -o capture.vcd
+  capture2vcd.py --host 192.168.1.10 --cmd "capture -m 0x30 -r 20 -n 100000" -o capture.vcd
+"""
+import argparse
+import socket
+import struct
+import sys
+import time
+
+STATUS = {0: "ok", 1: "overrun", 2: "trigger timeout", 3: "error", 4: "aborted"}
+
+
+class Reader:
+    """Byte reader over a socket or a file"""
+
+    def __init__(self, read):
+        self._read = read
+        self._buf = b""
+
+    def take(self, n):
+        while len(self._buf) < n:
+            chunk = self._read(65536)
+            if not chunk:
+                raise EOFError("stream ended before End block")
+            self._buf += chunk
+        data, self._buf = self._buf[:n], self._buf[n:]
+        return data
+
+    def seek_header(self):
+        # Anything before the header (banner, echo) is skipped
+        while True:
+            idx = self._buf.find(b"CH\x01")
+            if idx >= 0:
+                self._buf = self._buf[idx + 2:]
+                return
+            self._buf = self._buf[-2:]
+            chunk = self._read(65536)
+            if not chunk:
+                raise EOFError("no capture header in stream")
+            self._buf += chunk
+
+
+def varint(data, pos):
+    value = shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+def decode(reader, out):
+    reader.seek_header()
+    _version, mask, period, limit, bits = struct.unpack("<BQIIB", reader.take(18))
+    pins = [pin for pin in range(40) if mask & (1 << pin)]
+    value_bytes = (bits + 7) // 8
+    ids = {pin: chr(33 + i) for i, pin in enumerate(pins)}
+
+    out.write("$timescale 1us $end\n$scope module esp32 $end\n")
+    for pin in pins:
+        out.write("$var wire 1 %s GPIO%d $end\n" % (ids[pin], pin))
+    out.write("$upscope $end\n$enddefinitions $end\n")
+
+    last = None
+    while True:
+        tag = reader.take(2)
+        if tag == b"CE":
+            samples, status = struct.unpack("<IB", reader.take(5))
+            out.write("#%d\n" % (samples * period))
+            return samples, STATUS.get(status, str(status))
+        if tag != b"CB":
+            raise ValueError("unexpected block %r" % tag)
+        index, length = struct.unpack("<IH", reader.take(6))
+        payload = reader.take(length)
+        pos = 0
+        while pos < len(payload):
+            run, pos = varint(payload, pos)
+            value = int.from_bytes(payload[pos:pos + value_bytes], "little")
+            pos += value_bytes
+            if value != last:
+                out.write("#%d\n" % (index * period))
+                for bit, pin in enumerate(pins):
+                    level = (value >> bit) & 1
+                    if last is None or level != (last >> bit) & 1:
+                        out.write("%d%s\n" % (level, ids[pin]))
+                last = value
+            index += run
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode 'capture' stream into VCD")
+    parser.add_argument("-i", "--input", help="binary stream file")
+    parser.add_argument("--host", help="board address, command is sent over TCP")
+    parser.add_argument("--port", type=int, default=3333)
+    parser.add_argument("--cmd", help="capture command line to send")
+    parser.add_argument("-o", "--output", required=True, help="VCD file")
+    args = parser.parse_args()
+
+    if args.host:
+        if not args.cmd:
+            parser.error("--cmd is required with --host")
+        sock = socket.create_connection((args.host, args.port))
+        # Drain welcome banner before sending command
+        time.sleep(0.5)
+        sock.setblocking(False)
+        try:
+            sock.recv(4096)
+        except BlockingIOError:
+            pass
+        sock.setblocking(True)
+        sock.sendall(args.cmd.encode() + b"\n")
+        reader = Reader(sock.recv)
+    elif args.input:
+        reader = Reader(open(args.input, "rb").read)
+    else:
+        parser.error("either --input or --host is required")
+
+    with open(args.output, "w") as out:
+        samples, status = decode(reader, out)
+    print("%d samples, status: %s" % (samples, status), file=sys.stderr)
+    return 0 if status == "ok" else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,401 @@
+#!/usr/bin/env python3
+"""
+Project: ESP32 Console Application Project - 2022
+File   : tools/cli_replay.py
+
+Downloads, prints, replays and compares logs of the 'record' command. A log
+holds every line of every session with its start time, execution time on the
+board and its response, so traffic seen in the field can be driven against a
+board or a Linux host build of the firmware again.
+
+  cli_replay.py dump --host 192.168.1.10 -o field.bin
+  cli_replay.py show field.bin
+  cli_replay.py replay --host 192.168.1.10 field.bin --speed 10 --record new.bin
+  cli_replay.py diff field.bin new.bin
+
+Replay opens one TCP connection for every recorded session and sends its lines
+at their recorded times divided by --speed (0 sends as fast as responses come).
+Responses are compared with the recorded length and hash, execution times of
+the board are compared per command when --record downloads a log of the
+replay. Accelerated replays may hit session rate limits, they can be raised
+with 'config set rate_cmds'.
+Lines of buffer sessions (UDP datagrams and 'every' runs) are shown and
+diffed but not replayed: 'every' runs again from its replayed command and
+datagram replies do not come over TCP.
+"""
+import argparse
+import difflib
+import re
+import select
+import socket
+import struct
+import sys
+import threading
+import time
+
+HEADER = b"RH\x01"
+TRANSPORTS = {0: "uart", 1: "tcp", 2: "frame", 3: "buffer"}
+
+
+class Entry:
+    """One recorded line"""
+
+    def __init__(self, **fields):
+        self.__dict__.update(fields)
+
+    @property
+    def command(self):
+        words = self.line.split()
+        return words[0] if words else ""
+
+
+def fnv1a(data):
+    value = 2166136261
+    for byte in data:
+        value = ((value ^ byte) * 16777619) & 0xFFFFFFFF
+    return value
+
+
+def read_varint(data, pos):
+    """Reads a LEB128 varint of up to 64 bits, times are 64-bit microseconds."""
+    value = 0
+    for shift in range(0, 70, 7):
+        if pos >= len(data):
+            raise ValueError("varint is cut at %d" % pos)
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        if not byte & 0x80:
+            return value, pos
+    raise ValueError("varint is longer than 64 bits at %d" % (pos - 10))
+
+
+def read_signed(data, pos):
+    value, pos = read_varint(data, pos)
+    return (value >> 1) ^ -(value & 1), pos
+
+
+def parse_log(data):
+    """Returns header fields and entries of a log, anything before the header is skipped"""
+    start = data.find(HEADER)
+    if start < 0:
+        raise ValueError("no record log header")
+    _version, lines, dropped, length = struct.unpack_from("<BIII", data, start + 2)
+    pos = start + 15
+    end = pos + length
+    if end > len(data):
+        raise ValueError("log is cut, %d of %d bytes" % (len(data) - pos, length))
+    entries = []
+    now = 0
+    while pos < end:
+        if data[pos] != ord("E"):
+            raise ValueError("unexpected entry tag at %d" % pos)
+        session, pos = read_varint(data, pos + 1)
+        transport = data[pos]
+        delta, pos = read_varint(data, pos + 1)
+        exec_us, pos = read_varint(data, pos)
+        status, pos = read_signed(data, pos)
+        ret, pos = read_signed(data, pos)
+        line_len, pos = read_varint(data, pos)
+        line = data[pos:pos + line_len].decode(errors="replace")
+        pos += line_len
+        response_len, pos = read_varint(data, pos)
+        kept_len, pos = read_varint(data, pos)
+        (response_hash,) = struct.unpack_from("<I", data, pos)
+        pos += 4
+        kept = data[pos:pos + kept_len]
+        pos += kept_len
+        now += delta
+        entries.append(Entry(session=session, transport=TRANSPORTS.get(transport, str(transport)), time_us=now,
+                             exec_us=exec_us, status=status, ret=ret, line=line, response_len=response_len,
+                             response_hash=response_hash, kept=kept))
+    return {"lines": lines, "dropped": dropped}, entries
+
+
+def percentile(values, fraction):
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(fraction * len(ordered)))]
+
+
+def by_command(pairs):
+    """Groups (command, value) pairs into a dictionary of value lists"""
+    groups = {}
+    for command, value in pairs:
+        groups.setdefault(command, []).append(value)
+    return groups
+
+
+def print_distribution(title, groups, unit=1000.0):
+    print("%-16s %6s %9s %9s %9s %9s" % (title, "count", "p50", "p90", "p99", "max"))
+    for command in sorted(groups):
+        values = [v / unit for v in groups[command]]
+        print("%-16s %6d %9.3f %9.3f %9.3f %9.3f" % (command, len(values), percentile(values, 0.5),
+                                                    percentile(values, 0.9), percentile(values, 0.99), max(values)))
+
+
+def compare_distributions(old, new, threshold):
+    """Prints p50/p90 execution time of both logs per command, returns commands which got slower"""
+    print("%-16s %6s %11s %11s %11s %11s %7s" % ("exec ms", "count", "old p50", "new p50", "old p90", "new p90", "ratio"))
+    slower = []
+    for command in sorted(set(old) & set(new)):
+        old_p90 = percentile(old[command], 0.9) / 1000.0
+        new_p90 = percentile(new[command], 0.9) / 1000.0
+        ratio = new_p90 / old_p90 if old_p90 > 0 else 1.0
+        mark = ""
+        # Sub-millisecond commands jitter more than they regress
+        if ratio > threshold and new_p90 - old_p90 > 0.5:
+            slower.append(command)
+            mark = "  <-- slower"
+        print("%-16s %6d %11.3f %11.3f %11.3f %11.3f %7.2f%s" % (
+            command, len(new[command]), percentile(old[command], 0.5) / 1000.0, percentile(new[command], 0.5) / 1000.0,
+            old_p90, new_p90, ratio, mark))
+    return slower
+
+
+def show_diff(kept_old, data_new, names=("recorded", "replayed"), limit=12):
+    old = kept_old.decode(errors="replace").splitlines()
+    new = data_new[:len(kept_old) or len(data_new)].decode(errors="replace").splitlines()
+    for n, text in enumerate(difflib.unified_diff(old, new, names[0], names[1], lineterm="", n=1)):
+        if n >= limit:
+            print("      ...")
+            break
+        print("      " + text)
+
+
+class Connection:
+    """TCP client of the console server"""
+
+    def __init__(self, host, port):
+        self.sock = socket.create_connection((host, port))
+        # Welcome banner is not a response of any line
+        self.read(0, 1.0, 0.3)
+
+    def send(self, line):
+        self.sock.sendall(line.encode() + b"\n")
+
+    def read(self, expected, timeout, quiet):
+        """Reads until expected bytes came and line is quiet, or until timeout. Returns bytes and
+        time of last byte since call"""
+        data = b""
+        start = time.monotonic()
+        last = start
+        while True:
+            now = time.monotonic()
+            wait = quiet - (now - last) if len(data) >= expected else start + timeout - now
+            if wait <= 0:
+                break
+            ready, _, _ = select.select([self.sock], [], [], wait)
+            if not ready:
+                continue
+            chunk = self.sock.recv(65536)
+            if not chunk:
+                break
+            data += chunk
+            last = time.monotonic()
+        return data, last - start
+
+    def take(self, n, timeout):
+        data = b""
+        deadline = time.monotonic() + timeout
+        while len(data) < n:
+            ready, _, _ = select.select([self.sock], [], [], max(0, deadline - time.monotonic()))
+            if not ready:
+                raise TimeoutError("log download stalled")
+            chunk = self.sock.recv(65536)
+            if not chunk:
+                raise EOFError("connection closed during log download")
+            data += chunk
+        return data
+
+    def download(self, timeout=10.0):
+        """Sends 'record dump' and returns the log"""
+        self.send("record dump")
+        data = b""
+        while HEADER not in data or len(data) < data.find(HEADER) + 15:
+            data += self.take(1, timeout)
+        start = data.find(HEADER)
+        (length,) = struct.unpack_from("<I", data, start + 11)
+        missing = start + 15 + length - len(data)
+        if missing > 0:
+            data += self.take(missing, timeout)
+        return data[start:start + 15 + length]
+
+    def command(self, line):
+        self.send(line)
+        return self.read(1, 2.0, 0.1)[0].decode(errors="replace").strip()
+
+    def close(self):
+        self.sock.close()
+
+
+def replay_session(host, port, entries, t0, speed, args, results):
+    conn = Connection(host, port)
+    try:
+        for entry in entries:
+            if speed > 0:
+                delay = t0 + entry.time_us / 1e6 / speed - time.monotonic()
+                if delay > 0:
+                    time.sleep(delay)
+            sent = time.monotonic()
+            conn.send(entry.line)
+            data, rtt = conn.read(entry.response_len, args.timeout, args.quiet)
+            results.append((entry, data, rtt if data else time.monotonic() - sent))
+    finally:
+        conn.close()
+
+
+def replay(args):
+    _header, entries = parse_log(open(args.log, "rb").read())
+    if not entries:
+        print("log has no lines", file=sys.stderr)
+        return 1
+    sessions = {}
+    for entry in entries:
+        if entry.transport != "buffer":
+            sessions.setdefault(entry.session, []).append(entry)
+
+    control = None
+    if args.record:
+        control = Connection(args.host, args.port)
+        print(control.command("record start %d" % args.record_kb), file=sys.stderr)
+
+    results = []
+    t0 = time.monotonic() + 0.2
+    threads = [threading.Thread(target=replay_session, args=(args.host, args.port, lines, t0, args.speed, args, results))
+               for lines in sessions.values()]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    elapsed = time.monotonic() - t0
+
+    ignore = re.compile(args.ignore) if args.ignore else None
+    differ = 0
+    print("replayed %d lines of %d sessions in %.2f s, speed %s" % (len(results), len(sessions), elapsed,
+                                                                   "max" if args.speed <= 0 else "x%g" % args.speed))
+    for entry, data, _rtt in sorted(results, key=lambda r: r[0].time_us):
+        if ignore and ignore.search(entry.line):
+            continue
+        if len(data) == entry.response_len and fnv1a(data) == entry.response_hash:
+            continue
+        differ += 1
+        print("  session %d at %.3f s '%s': %d -> %d bytes" % (entry.session, entry.time_us / 1e6, entry.line,
+                                                                entry.response_len, len(data)))
+        show_diff(entry.kept, data)
+    print("responses: %d match, %d differ" % (len(results) - differ, differ))
+    print()
+    print_distribution("round trip ms", by_command((r[0].command, r[2] * 1e6) for r in results))
+
+    slower = []
+    if control:
+        control.command("record stop")
+        data = control.download()
+        control.close()
+        if args.record != "-":
+            open(args.record, "wb").write(data)
+        _header, replayed = parse_log(data)
+        print()
+        slower = compare_distributions(by_command((e.command, e.exec_us) for e in entries),
+                                       by_command((e.command, e.exec_us) for e in replayed), args.threshold)
+    return 1 if differ or slower else 0
+
+
+def diff(args):
+    _h, old = parse_log(open(args.old, "rb").read())
+    _h, new = parse_log(open(args.new, "rb").read())
+    ignore = re.compile(args.ignore) if args.ignore else None
+
+    # Sessions are paired in order of their first line, lines in order within a session
+    def sessions(entries):
+        groups = {}
+        for entry in entries:
+            groups.setdefault(entry.session, []).append(entry)
+        return list(groups.values())
+
+    differ = 0
+    compared = 0
+    for old_lines, new_lines in zip(sessions(old), sessions(new)):
+        for a, b in zip(old_lines, new_lines):
+            if a.line != b.line:
+                print("  session %d: line '%s' is '%s' in new log, rest of session is skipped" % (a.session, a.line, b.line))
+                break
+            if ignore and ignore.search(a.line):
+                continue
+            compared += 1
+            if a.response_len == b.response_len and a.response_hash == b.response_hash:
+                continue
+            differ += 1
+            print("  session %d at %.3f s '%s': %d -> %d bytes" % (a.session, a.time_us / 1e6, a.line,
+                                                                    a.response_len, b.response_len))
+            show_diff(a.kept, b.kept, (args.old, args.new))
+    print("responses: %d match, %d differ" % (compared - differ, differ))
+    print()
+    slower = compare_distributions(by_command((e.command, e.exec_us) for e in old),
+                                   by_command((e.command, e.exec_us) for e in new), args.threshold)
+    return 1 if differ or slower else 0
+
+
+def show(args):
+    header, entries = parse_log(open(args.log, "rb").read())
+    for entry in entries if args.lines else []:
+        print("%10.6f  s%-3d %-5s %8.3f ms  %5d B  %s" % (entry.time_us / 1e6, entry.session, entry.transport,
+                                                         entry.exec_us / 1000.0, entry.response_len, entry.line))
+    span = entries[-1].time_us / 1e6 if entries else 0
+    print("%d lines, %d dropped, %d sessions, %.3f s" % (header["lines"], header["dropped"],
+                                                        len({e.session for e in entries}), span))
+    if entries:
+        print_distribution("exec ms", by_command((e.command, e.exec_us) for e in entries))
+    return 0
+
+
+def dump(args):
+    conn = Connection(args.host, args.port)
+    data = conn.download()
+    conn.close()
+    open(args.output, "wb").write(data)
+    header, entries = parse_log(data)
+    print("%d lines, %d dropped, %d bytes" % (header["lines"], header["dropped"], len(data)), file=sys.stderr)
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Download, replay and compare 'record' logs")
+    sub = parser.add_subparsers(dest="action", required=True)
+
+    p = sub.add_parser("dump", help="download log of the board")
+    p.add_argument("--host", required=True)
+    p.add_argument("--port", type=int, default=3333)
+    p.add_argument("-o", "--output", required=True)
+    p.set_defaults(func=dump)
+
+    p = sub.add_parser("show", help="print summary and execution time distribution of a log")
+    p.add_argument("log")
+    p.add_argument("-l", "--lines", action="store_true", help="print every line")
+    p.set_defaults(func=show)
+
+    p = sub.add_parser("replay", help="drive recorded traffic against a server and diff responses")
+    p.add_argument("log")
+    p.add_argument("--host", required=True)
+    p.add_argument("--port", type=int, default=3333)
+    p.add_argument("--speed", type=float, default=1.0, help="time scale, 0 sends lines as fast as responses come")
+    p.add_argument("--timeout", type=float, default=5.0, help="longest wait for a response in seconds")
+    p.add_argument("--quiet", type=float, default=0.02, help="silence which ends a response in seconds")
+    p.add_argument("--record", help="record replay on the board and save its log, '-' compares without saving")
+    p.add_argument("--record-kb", type=int, default=64)
+    p.add_argument("--ignore", help="regex of lines whose responses change by nature, e.g. '^(top|session)'")
+    p.add_argument("--threshold", type=float, default=1.25, help="p90 ratio which counts as slower")
+    p.set_defaults(func=replay)
+
+    p = sub.add_parser("diff", help="compare responses and execution times of two logs")
+    p.add_argument("old")
+    p.add_argument("new")
+    p.add_argument("--ignore", help="regex of lines whose responses change by nature")
+    p.add_argument("--threshold", type=float, default=1.25, help="p90 ratio which counts as slower")
+    p.set_defaults(func=diff)
+
+    args = parser.parse_args()
+    return args.func(args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
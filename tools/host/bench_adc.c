@@ -0,0 +1,89 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : tools/host/bench_adc.c
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "esp_timer.h"
+
+#include "CLIAdc.h"
+#include "host.h"
+
+/* Runs adc_stream with the synthetic source and reports records, dropped records and throughput of
+ * the stream. A per chunk delay makes the session slow like a congested peer, so dropping of whole
+ * blocks can be checked. The stream can be saved for tools/adc2csv.py. */
+
+// Size of End block
+#define BENCH_ADC_END_SIZE (11)
+
+// Stream waits for blocks without the command lock, a single task has nothing to release
+int cliCommandUnlock(void){
+    return 0;
+}
+
+void cliCommandLock(int depth){
+}
+
+static uint32_t benchGet32(const uint8_t *data){
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+int main(int argc, char **argv){
+    cliAdcConfig_t config = {
+        .mask = (1ULL << 32) | (1ULL << 33),
+        .rate = 100000,
+        .decimation = 10,
+        .fields = CLI_ADC_FIELD_MEAN | CLI_ADC_FIELD_MIN | CLI_ADC_FIELD_MAX,
+        .records = 20000,
+        .source = CLI_ADC_SOURCE_SYNTHETIC
+    };
+    uint32_t delayUs = 0;
+    const char *path = NULL;
+    int option;
+    while((option = getopt(argc, argv, "c:r:d:f:n:s:o:")) != -1){
+        switch(option){
+            case 'c': config.mask = strtoull(optarg, NULL, 0); break;
+            case 'r': config.rate = strtoul(optarg, NULL, 0); break;
+            case 'd': config.decimation = strtoul(optarg, NULL, 0); break;
+            case 'f': config.fields = strtoul(optarg, NULL, 0); break;
+            case 'n': config.records = strtoul(optarg, NULL, 0); break;
+            case 's': delayUs = strtoul(optarg, NULL, 0); break;
+            case 'o': path = optarg; break;
+            default:
+                fprintf(stderr, "Usage: bench_adc [-c pin mask] [-r rate] [-d decimation] [-f fields] "
+                                "[-n records] [-s us per chunk] [-o stream file]\n");
+                return 1;
+        }
+    }
+    // Stream is kept in a file, its End block tells records and drops
+    FILE *file = path != NULL ? fopen(path, "w+b") : tmpfile();
+    if(file == NULL){
+        perror("stream file");
+        return 1;
+    }
+    hostSinkOpen(file, delayUs);
+
+    int64_t start = esp_timer_get_time();
+    cliAdcStatus_t status = cliAdcStream(&config);
+    hostSinkFlush();
+    int64_t elapsed = esp_timer_get_time() - start;
+
+    uint8_t end[BENCH_ADC_END_SIZE];
+    if(status >= CLI_ADC_STATUS_BUSY || fseek(file, -BENCH_ADC_END_SIZE, SEEK_END) != 0 ||
+       fread(end, 1, sizeof(end), file) != sizeof(end) || end[0] != 'A' || end[1] != 'E'){
+        fprintf(stderr, "Stream did not end, status %d\n", status);
+        return 1;
+    }
+    fclose(file);
+    uint32_t records = benchGet32(end + 2);
+    uint32_t dropped = benchGet32(end + 6);
+    printf("status %u, %u records, %u dropped, %llu bytes in %lld ms\n", end[10], records, dropped,
+           (unsigned long long)hostSinkBytes(), (long long)(elapsed / 1000));
+    if(elapsed > 0)
+        printf("%.0f records/s, %.0f kB/s\n", (double)records * 1000000 / elapsed,
+               (double)hostSinkBytes() * 1000 / elapsed);
+    return 0;
+}
@@ -0,0 +1,126 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : tools/host/bench_bus.c
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_timer.h"
+
+#include "CLISession.h"
+#include "CLIJson.h"
+#include "CLIGpio.h"
+#include "CLIBus.h"
+#include "host.h"
+
+/* Runs i2c and spi transaction lists against the mock driver. Checks compare result and text response
+ * of lists, then lists are timed from parsing to encoded response in text, JSON and binary format. */
+
+// Lists which are run in a timing loop
+#define BENCH_BUS_LISTS (100000)
+
+// A list with its expected result and, for successful lists, its text response
+typedef struct{
+    cliBusType_t bus;
+    const char *list;
+    cliBusResult_t result;
+    const char *response;
+}benchBusCheck_t;
+
+// Checks run in order on one register file, later reads see earlier writes
+static const benchBusCheck_t s_checks[] = {
+    { CLI_BUS_I2C, "a50,w1011223344,b10:4",         CLI_BUS_OK,             "11223344\n" },
+    { CLI_BUS_I2C, "a50,w2055,d100,w20,r1,b11:2",   CLI_BUS_OK,             "55 2233\n" },
+    { CLI_BUS_I2C, "a50,w30aa",                     CLI_BUS_OK,             "OK\n" },
+    { CLI_BUS_I2C, "a51,w00",                       CLI_BUS_FAIL,           NULL },
+    { CLI_BUS_I2C, "w00",                           CLI_BUS_NO_ADDRESS,     NULL },
+    { CLI_BUS_I2C, "a50,x00",                       CLI_BUS_WRONG_BUS,      NULL },
+    { CLI_BUS_I2C, "a50,q1",                        CLI_BUS_SYNTAX,         NULL },
+    { CLI_BUS_I2C, "a50,w0",                        CLI_BUS_SYNTAX,         NULL },
+    { CLI_BUS_I2C, "a50,d1000000,d1000000,d1",      CLI_BUS_DELAY_TOO_LONG, NULL },
+    { CLI_BUS_SPI, "x0102030405",                   CLI_BUS_OK,             "0102030405\n" },
+    { CLI_BUS_SPI, "x00aa*3",                       CLI_BUS_OK,             "00aa00aa00aa\n" },
+    { CLI_BUS_SPI, "a50",                           CLI_BUS_WRONG_BUS,      NULL },
+    { CLI_BUS_SPI, "w00*5000",                      CLI_BUS_TOO_LONG,       NULL },
+};
+
+// Pins of mock buses are not driven, every claim succeeds
+bool cliGpioClaim(int pin, cliGpioOwner_t owner){
+    return true;
+}
+
+void cliGpioRelease(int pin, cliGpioOwner_t owner){
+}
+
+void cliGpioEnableInput(int pin){
+}
+
+// Returns number of failed checks
+static int benchCheck(void){
+    cliSession_t *session = hostSession();
+    int failed = 0;
+    session->format = CLI_SESSION_FORMAT_TEXT;
+    for(size_t i = 0; i < sizeof(s_checks) / sizeof(s_checks[0]); i++){
+        const benchBusCheck_t *check = &s_checks[i];
+        cliBusReport_t report;
+        hostSinkReset();
+        cliBusResult_t result = cliBusRun(check->bus, check->list, &report);
+        if(result == CLI_BUS_OK)
+            cliBusWriteResponse(result, &report, false);
+        bool ok = result == check->result && (check->response == NULL ||
+                  (session->txLen == strlen(check->response) && memcmp(session->txBuffer, check->response, session->txLen) == 0));
+        if(!ok){
+            printf("FAIL %s %s: result %d, expected %d\n", cliBusName(check->bus), check->list, result, check->result);
+            failed++;
+        }
+    }
+    hostSinkReset();
+    printf("%d of %d checks passed\n", (int)(sizeof(s_checks) / sizeof(s_checks[0])) - failed,
+           (int)(sizeof(s_checks) / sizeof(s_checks[0])));
+    return failed;
+}
+
+// Times a list from parsing to its response, JSON format is set on the session
+static void benchTime(cliBusType_t bus, const char *name, const char *list, cliSessionFormat_t format, bool binary,
+                      int count){
+    cliSession_t *session = hostSession();
+    session->format = format;
+    hostSinkReset();
+    int64_t start = esp_timer_get_time();
+    for(int i = 0; i < count; i++){
+        cliBusReport_t report;
+        if(format == CLI_SESSION_FORMAT_JSON)
+            session->jsonState = CLI_SESSION_JSON_PENDING;
+        cliBusResult_t result = cliBusRun(bus, list, &report);
+        cliBusWriteResponse(result, &report, binary);
+        cliJsonFinishResponse(session, ESP_OK, 0);
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    printf("%-10s %-6s %9.2f us %7llu B\n", name, binary ? "binary" : format == CLI_SESSION_FORMAT_JSON ? "json" : "text",
+           (double)elapsed / count, (unsigned long long)(hostSinkBytes() / count));
+}
+
+int main(int argc, char **argv){
+    int count = argc > 1 ? atoi(argv[1]) : BENCH_BUS_LISTS;
+    if(count <= 0){
+        fprintf(stderr, "Usage: bench_bus [lists]\n");
+        return 1;
+    }
+    cliBusConfig_t config = { .pins = { -1, -1, -1, -1 } };
+    cliBusOpen(CLI_BUS_I2C, cliBusMockDriver(), &config);
+    cliBusOpen(CLI_BUS_SPI, cliBusMockDriver(), &config);
+    if(benchCheck() != 0)
+        return 1;
+
+    // Seven items: address, write, two register bursts, a delay which splits segments, write and read
+    const char *i2c = "a50,w00112233445566778899aabbccddeeff,b00:16,d10,b08:8,w20,r32";
+    // 2 KB write and 2 KB read, both are large enough for DMA
+    const char *spi = "w00ff*1024,r2048";
+    for(int format = 0; format < 3; format++){
+        cliSessionFormat_t sessionFormat = format == 1 ? CLI_SESSION_FORMAT_JSON : CLI_SESSION_FORMAT_TEXT;
+        benchTime(CLI_BUS_I2C, "i2c 7", i2c, sessionFormat, format == 2, count);
+        benchTime(CLI_BUS_SPI, "spi 4k", spi, sessionFormat, format == 2, count / 10);
+    }
+    return 0;
+}
@@ -0,0 +1,193 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : tools/host/bench_json.c
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_timer.h"
+
+#include "CLISession.h"
+#include "CLIJson.h"
+#include "host.h"
+
+/* Compares bytes per response and formatting cost of JSON and text format. Responses are written the
+ * way their commands write them, output goes through the chunk buffer of a TCP session. */
+
+// Pin masks of the default board (ESP-WROOM-32), two pins are driven by pwm
+#define BENCH_VALID_PINS (0x9F0EEFFFFFULL)
+#define BENCH_INPUT_ONLY (0xFC00000000ULL)
+#define BENCH_STRAPPING (0x0000009025ULL)
+#define BENCH_FLASH (0x0000000FC0ULL)
+#define BENCH_ADC (0xFF0E00F015ULL)
+#define BENCH_PWM_PINS ((1ULL << 18) | (1ULL << 19))
+#define BENCH_LEVELS (0x00A5C3F00FULL)
+// Number of responses of a case
+#define BENCH_RESPONSES (100000)
+
+// Text of a command which has no JSON writer, it is wrapped into "output"
+static const char s_help[] =
+    "read_gpio  [-a] [-p <gpio>] [-w <us>]\n  Get GPIO Pin Status\n"
+    "  -a, --allpins  All Pins Status\n  -p, --pin=<gpio>  Pin number\n"
+    "  -w, --window=<us>  Snapshot window, readers in it share one read\n\n"
+    "write_gpio  -p <gpio> -l <0|1>\n  Set GPIO Pin Level\n"
+    "  -p, --pin=<gpio>  Pin number\n  -l, --level=<0|1>  \"0\" for LOW, \"1\" for HIGH\n";
+
+// Text of read_gpio -a, like cliGpioFormat()
+static void benchGpioText(void){
+    char text[1024];
+    size_t len = snprintf(text, sizeof(text), "\n------------------\n"
+                                              "|GPIO_PIN | STATUS|"
+                                              "\n------------------\n");
+    for(int i = 0; i < 40; i++){
+        if(!(BENCH_VALID_PINS & (1ULL << i)))
+            continue;
+        const char *level = (BENCH_LEVELS & (1ULL << i)) ? "HIGH" : "LOW";
+        if(BENCH_PWM_PINS & (1ULL << i))
+            len += snprintf(text + len, sizeof(text) - len, "Pin-%d :  %s (%s)\n", i, level, "pwm");
+        else
+            len += snprintf(text + len, sizeof(text) - len, "Pin-%d :  %s\n", i, level);
+    }
+    len += snprintf(text + len, sizeof(text) - len, "----------------------\n");
+    cliSessionWrite(text, len);
+}
+
+// JSON of read_gpio -a, like read_gpio_json()
+static void benchGpioJson(void){
+    cliJson_t json;
+    cliJsonBegin(&json, cliSessionGetCurrent());
+    cliJsonArray(&json, "pins");
+    for(int i = 0; i < 40; i++){
+        if(!(BENCH_VALID_PINS & (1ULL << i)))
+            continue;
+        cliJsonObject(&json, NULL);
+        cliJsonInt(&json, "gpio", i);
+        cliJsonInt(&json, "level", (BENCH_LEVELS >> i) & 1);
+        if(BENCH_PWM_PINS & (1ULL << i))
+            cliJsonString(&json, "owner", "pwm");
+        cliJsonClose(&json);
+    }
+    cliJsonClose(&json);
+    cliJsonEnd(&json);
+}
+
+// Text of version, like get_version()
+static void benchVersionText(void){
+    cliSessionPrintf("IDF Version:%s\r\n", "v4.4.4");
+    cliSessionPrintf("Chip info:\r\n");
+    cliSessionPrintf("\tmodel:%s\r\n", "ESP32");
+    cliSessionPrintf("\tcores:%d\r\n", 2);
+    cliSessionPrintf("\tfeature:%s%s%s%s%d%s\r\n", "/802.11bgn", "/BLE", "/BT", "/External-Flash:", 4, " MB");
+    cliSessionPrintf("\trevision number:%d\r\n", 3);
+    cliSessionPrintf("Board: %s\r\n", "ESP-WROOM-32");
+    cliSessionPrintf("\tvalid:0x%010llx\r\n\tinput only:0x%010llx\r\n\tstrapping:0x%010llx\r\n"
+                     "\tflash:0x%010llx\r\n\tadc:0x%010llx\r\n",
+                     BENCH_VALID_PINS, BENCH_INPUT_ONLY, BENCH_STRAPPING, BENCH_FLASH, BENCH_ADC);
+}
+
+// JSON of version, like get_version()
+static void benchVersionJson(void){
+    cliJson_t json;
+    cliJsonBegin(&json, cliSessionGetCurrent());
+    cliJsonString(&json, "idf", "v4.4.4");
+    cliJsonString(&json, "model", "ESP32");
+    cliJsonInt(&json, "cores", 2);
+    cliJsonArray(&json, "features");
+    cliJsonString(&json, NULL, "802.11bgn");
+    cliJsonString(&json, NULL, "BLE");
+    cliJsonString(&json, NULL, "BT");
+    cliJsonClose(&json);
+    cliJsonObject(&json, "flash");
+    cliJsonBool(&json, "embedded", false);
+    cliJsonUint(&json, "size_mb", 4);
+    cliJsonClose(&json);
+    cliJsonInt(&json, "revision", 3);
+    cliJsonObject(&json, "board");
+    cliJsonString(&json, "name", "ESP-WROOM-32");
+    cliJsonUint(&json, "valid", BENCH_VALID_PINS);
+    cliJsonUint(&json, "input_only", BENCH_INPUT_ONLY);
+    cliJsonUint(&json, "strapping", BENCH_STRAPPING);
+    cliJsonUint(&json, "flash", BENCH_FLASH);
+    cliJsonUint(&json, "adc", BENCH_ADC);
+    cliJsonClose(&json);
+    cliJsonEnd(&json);
+}
+
+// Unknown command, like cliCommandControl()
+static void benchErrorText(void){
+    cliSessionPrintf("Unrecognized command\n");
+}
+
+static void benchErrorJson(void){
+    cliJsonFinishResponse(cliSessionGetCurrent(), ESP_ERR_NOT_FOUND, 0);
+}
+
+// Command without a JSON writer
+static void benchHelpText(void){
+    cliSessionWrite(s_help, sizeof(s_help) - 1);
+}
+
+static void benchHelpJson(void){
+    cliSessionWrite(s_help, sizeof(s_help) - 1);
+    cliJsonFinishResponse(cliSessionGetCurrent(), ESP_OK, 0);
+}
+
+// Runs responses of one format, returns nanoseconds per response and sets bytes per response
+static double benchRun(void (*write)(void), cliSessionFormat_t format, int count, double *bytes){
+    cliSession_t *session = hostSession();
+    session->format = format;
+    hostSinkReset();
+    int64_t start = esp_timer_get_time();
+    for(int i = 0; i < count; i++){
+        // cliRunCommand() starts every JSON response as pending
+        if(format == CLI_SESSION_FORMAT_JSON)
+            session->jsonState = CLI_SESSION_JSON_PENDING;
+        write();
+        cliJsonFinishResponse(session, ESP_OK, 0);
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    *bytes = (double)hostSinkBytes() / count;
+    return (double)elapsed * 1000 / count;
+}
+
+static void benchCase(const char *name, void (*text)(void), void (*json)(void), int count){
+    double textBytes, jsonBytes;
+    double textNs = benchRun(text, CLI_SESSION_FORMAT_TEXT, count, &textBytes);
+    double jsonNs = benchRun(json, CLI_SESSION_FORMAT_JSON, count, &jsonBytes);
+    printf("%-14s %8.0f %8.0f %7.2f %9.0f %9.0f %7.2f\n", name, textBytes, jsonBytes, jsonBytes / textBytes,
+           textNs, jsonNs, jsonNs / textNs);
+}
+
+// Prints one response of every case in JSON format, so output of the writer can be checked
+static void benchDump(void){
+    void (*cases[])(void) = { benchGpioJson, benchVersionJson, benchErrorJson, benchHelpJson };
+    cliSession_t *session = hostSession();
+    session->format = CLI_SESSION_FORMAT_JSON;
+    hostSinkOpen(stdout, 0);
+    for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++){
+        session->jsonState = CLI_SESSION_JSON_PENDING;
+        cases[i]();
+        cliJsonFinishResponse(session, ESP_OK, 0);
+    }
+    hostSinkFlush();
+    hostSinkOpen(NULL, 0);
+}
+
+int main(int argc, char **argv){
+    int count = argc > 1 ? atoi(argv[1]) : BENCH_RESPONSES;
+    if(argc > 1 && strcmp(argv[1], "dump") == 0){
+        benchDump();
+        return 0;
+    }
+    if(count <= 0){
+        fprintf(stderr, "Usage: bench_json [responses|dump]\n");
+        return 1;
+    }
+    printf("%-14s %8s %8s %7s %9s %9s %7s\n", "response", "text B", "json B", "ratio", "text ns", "json ns", "ratio");
+    benchCase("read_gpio -a", benchGpioText, benchGpioJson, count);
+    benchCase("version", benchVersionText, benchVersionJson, count);
+    benchCase("unknown cmd", benchErrorText, benchErrorJson, count);
+    benchCase("wrapped text", benchHelpText, benchHelpJson, count);
+    return 0;
+}
@@ -0,0 +1,276 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : tools/host/host.c
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+
+#include "CLISession.h"
+#include "CLIJson.h"
+#include "host.h"
+
+// Queue on a pthread mutex and condition, items are copied like in FreeRTOS
+typedef struct{
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    UBaseType_t head;
+    UBaseType_t count;
+    uint8_t *items;
+}hostQueue_t;
+
+// Entry of a created task
+typedef struct{
+    TaskFunction_t function;
+    void *arg;
+}hostTask_t;
+
+static cliSession_t s_session;
+static FILE *s_sink_file;
+static uint32_t s_sink_delay_us;
+static uint64_t s_sink_bytes;
+static volatile bool s_input;
+
+int64_t esp_timer_get_time(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+const char *esp_err_to_name(esp_err_t err){
+    switch(err){
+        case ESP_OK:                return "ESP_OK";
+        case ESP_FAIL:              return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:        return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:   return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_NOT_FOUND:     return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_TIMEOUT:       return "ESP_ERR_TIMEOUT";
+        default:                    return "UNKNOWN ERROR";
+    }
+}
+
+static void *hostTaskEntry(void *arg){
+    hostTask_t task = *(hostTask_t *)arg;
+    free(arg);
+    task.function(task.arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack, void *arg, UBaseType_t priority,
+                       TaskHandle_t *handle){
+    hostTask_t *task = malloc(sizeof(hostTask_t));
+    pthread_t thread;
+    if(task == NULL)
+        return pdFAIL;
+    task->function = function;
+    task->arg = arg;
+    if(pthread_create(&thread, NULL, hostTaskEntry, task) != 0){
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(thread);
+    if(handle != NULL)
+        *handle = (TaskHandle_t)thread;
+    return pdPASS;
+}
+
+// Only a task can delete itself
+void vTaskDelete(TaskHandle_t task){
+    pthread_exit(NULL);
+}
+
+void vTaskDelay(TickType_t ticks){
+    usleep((useconds_t)ticks * 1000 * portTICK_PERIOD_MS);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void){
+    return (TaskHandle_t)pthread_self();
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize){
+    hostQueue_t *queue = calloc(1, sizeof(hostQueue_t));
+    if(queue == NULL)
+        return NULL;
+    queue->items = malloc(length * itemSize);
+    if(queue->items == NULL){
+        free(queue);
+        return NULL;
+    }
+    pthread_mutex_init(&queue->mutex, NULL);
+    pthread_cond_init(&queue->changed, NULL);
+    queue->length = length;
+    queue->itemSize = itemSize;
+    return queue;
+}
+
+// Waits until condition of queue holds or ticks pass, mutex of queue must be held
+static bool hostQueueWait(hostQueue_t *queue, bool forSpace, TickType_t ticks){
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += ticks / 1000;
+    until.tv_nsec += (long)(ticks % 1000) * 1000000;
+    if(until.tv_nsec >= 1000000000){
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000;
+    }
+    while(forSpace ? queue->count == queue->length : queue->count == 0){
+        if(ticks == 0)
+            return false;
+        if(ticks == portMAX_DELAY)
+            pthread_cond_wait(&queue->changed, &queue->mutex);
+        else if(pthread_cond_timedwait(&queue->changed, &queue->mutex, &until) != 0)
+            return forSpace ? queue->count < queue->length : queue->count > 0;
+    }
+    return true;
+}
+
+BaseType_t xQueueSend(QueueHandle_t handle, const void *item, TickType_t ticks){
+    hostQueue_t *queue = handle;
+    pthread_mutex_lock(&queue->mutex);
+    if(!hostQueueWait(queue, true, ticks)){
+        pthread_mutex_unlock(&queue->mutex);
+        return pdFALSE;
+    }
+    UBaseType_t tail = (queue->head + queue->count) % queue->length;
+    memcpy(queue->items + tail * queue->itemSize, item, queue->itemSize);
+    queue->count++;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->mutex);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t handle, void *item, TickType_t ticks){
+    hostQueue_t *queue = handle;
+    pthread_mutex_lock(&queue->mutex);
+    if(!hostQueueWait(queue, false, ticks)){
+        pthread_mutex_unlock(&queue->mutex);
+        return pdFALSE;
+    }
+    memcpy(item, queue->items + queue->head * queue->itemSize, queue->itemSize);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->mutex);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t handle){
+    hostQueue_t *queue = handle;
+    pthread_mutex_lock(&queue->mutex);
+    queue->head = 0;
+    queue->count = 0;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->mutex);
+    return pdPASS;
+}
+
+// Returns the session of benchmarks, it is a TCP session which coalesces into full chunks
+cliSession_t *hostSession(void){
+    if(!s_session.used){
+        s_session.used = true;
+        s_session.id = 1;
+        s_session.transport = CLI_SESSION_TCP;
+        s_session.txLimit = sizeof(s_session.txBuffer);
+    }
+    return &s_session;
+}
+
+// Sets where sent chunks go, a NULL file drops them. Delay is slept for every chunk
+void hostSinkOpen(FILE *file, uint32_t delayUs){
+    s_sink_file = file;
+    s_sink_delay_us = delayUs;
+}
+
+// Sends pending chunk of the session
+void hostSinkFlush(void){
+    if(s_session.txLen == 0)
+        return;
+    if(s_sink_file != NULL)
+        fwrite(s_session.txBuffer, 1, s_session.txLen, s_sink_file);
+    if(s_sink_delay_us > 0)
+        usleep(s_sink_delay_us);
+    s_sink_bytes += s_session.txLen;
+    s_session.txLen = 0;
+}
+
+// Returns bytes which are written to the session, sent or pending
+uint64_t hostSinkBytes(void){
+    return s_sink_bytes + s_session.txLen;
+}
+
+void hostSinkReset(void){
+    s_session.txLen = 0;
+    s_sink_bytes = 0;
+}
+
+// Sets whether client has input which is not read yet, a stream stops on it
+void hostSetInput(bool input){
+    s_input = input;
+}
+
+cliSession_t *cliSessionGetCurrent(void){
+    return hostSession();
+}
+
+// Benchmarks run a command on one task, lock of the session is not needed
+void cliSessionLock(cliSession_t *session){
+}
+
+void cliSessionUnlock(cliSession_t *session){
+}
+
+bool cliSessionHasInput(const cliSession_t *session){
+    return s_input;
+}
+
+// Copies output into the chunk buffer like the TCP transport and sends full chunks
+void cliSessionWriteRaw(cliSession_t *session, const char *data, size_t len){
+    session->stats.outBytes += len;
+    while(len > 0){
+        size_t space = session->txLimit - session->txLen;
+        if(space == 0){
+            hostSinkFlush();
+            continue;
+        }
+        size_t chunk = len < space ? len : space;
+        memcpy(session->txBuffer + session->txLen, data, chunk);
+        session->txLen += chunk;
+        data += chunk;
+        len -= chunk;
+    }
+}
+
+// Text of a JSON session is wrapped until the command writes a structured response
+void cliSessionWriteTo(cliSession_t *session, const char *data, size_t len){
+    if(session->jsonState == CLI_SESSION_JSON_PENDING || session->jsonState == CLI_SESSION_JSON_STRING){
+        cliJsonWrapText(session, data, len);
+        return;
+    }
+    cliSessionWriteRaw(session, data, len);
+}
+
+void cliSessionWrite(const char *data, size_t len){
+    cliSessionWriteTo(cliSessionGetCurrent(), data, len);
+}
+
+void cliSessionPrintf(const char *fmt, ...){
+    char text[CLI_SESSION_MSS];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(text, sizeof(text), fmt, args);
+    va_end(args);
+    if(len > 0)
+        cliSessionWrite(text, (size_t)len < sizeof(text) ? (size_t)len : sizeof(text) - 1);
+}
@@ -0,0 +1,25 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : tools/host/host.h
+*/
+#ifndef _HOST_H_
+#define _HOST_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "CLISession.h"
+
+/* Host harness of benchmarks. FreeRTOS tasks and queues run on pthreads, the current session is one
+ * TCP like session whose output goes through a CLI_SESSION_MSS chunk buffer into a sink. The sink
+ * counts bytes, writes them to a file when one is given and may sleep per chunk like a slow peer. */
+
+cliSession_t *hostSession(void);
+void hostSinkOpen(FILE*, uint32_t);
+void hostSinkFlush(void);
+uint64_t hostSinkBytes(void);
+void hostSinkReset(void);
+void hostSetInput(bool);
+
+#endif
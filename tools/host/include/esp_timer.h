@@ -0,0 +1,15 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : tools/host/include/esp_timer.h
+*/
+#ifndef _HOST_ESP_TIMER_H_
+#define _HOST_ESP_TIMER_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// Monotonic time in microseconds
+int64_t esp_timer_get_time(void);
+
+#endif
@@ -0,0 +1,28 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : tools/host/include/freertos/FreeRTOS.h
+*/
+#ifndef _HOST_FREERTOS_H_
+#define _HOST_FREERTOS_H_
+
+// Host build of FreeRTOS types which modules use, tasks and queues run on pthreads (host.c)
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE (1)
+#define pdFALSE (0)
+#define pdPASS (pdTRUE)
+#define pdFAIL (pdFALSE)
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFF)
+// One tick is one millisecond
+#define portTICK_PERIOD_MS (1)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define configMAX_PRIORITIES (25)
+
+#endif
@@ -0,0 +1,14 @@
+/*
+* Project: ESP32 Console Application Project - 2022
+* Author : Recep Said Dulger
+* File   : tools/host/include/freertos/semphr.h
+*/
+#ifndef _HOST_SEMPHR_H_
+#define _HOST_SEMPHR_H_
+
+#include "freertos/FreeRTOS.h"
+
+// Sessions only keep the handle, host benchmarks use one task per session
+typedef void *SemaphoreHandle_t;
+
+#endif
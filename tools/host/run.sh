@@ -0,0 +1,24 @@
+#!/bin/sh
+# Builds and runs host benchmarks of modules which have no hardware dependency.
+# Usage: tools/host/run.sh [bench] [args...]    bench: json (default), adc, bus
+# CC and CFLAGS are taken from environment, binaries are left in $BUILD (default /tmp/cli_host).
+set -e
+HOST=$(cd "$(dirname "$0")" && pwd)
+ROOT=$(cd "$HOST/../.." && pwd)
+BUILD=${BUILD:-/tmp/cli_host}
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:--O2 -Wall}
+BENCH=${1:-json}
+[ $# -gt 0 ] && shift
+
+case "$BENCH" in
+    json) SOURCES="" ;;
+    adc) SOURCES="$ROOT/CLIAdc.c $ROOT/CLIAdcSource.c" ;;
+    bus) SOURCES="$ROOT/CLIBus.c $ROOT/CLIBusDriver.c" ;;
+    *) echo "Unknown bench: $BENCH" >&2; exit 1 ;;
+esac
+
+mkdir -p "$BUILD"
+$CC $CFLAGS -I"$HOST/include" -I"$HOST" -I"$ROOT" -o "$BUILD/bench_$BENCH" "$HOST/bench_$BENCH.c" "$HOST/host.c" \
+    "$ROOT/CLIJson.c" $SOURCES -lpthread
+exec "$BUILD/bench_$BENCH" "$@"